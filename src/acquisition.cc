@@ -0,0 +1,107 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "acquisition.h"
+
+#include <pthread.h>
+
+#include <chrono>
+#include <cmath>
+
+MYNTEYE_BEGIN_NAMESPACE
+
+void MotionBatch::Assign(const std::vector<api::MotionData> &datas) {
+  imus_.clear();
+  for (auto &&data : datas) {
+    if (data.imu) {
+      imus_.push_back(data.imu);
+    }
+  }
+  std::size_t n = imus_.size();
+  times_.resize(n);
+  accel_.resize(n * 3);
+  gyro_.resize(n * 3);
+  for (std::size_t i = 0; i < n; ++i) {
+    const ImuData &imu = *imus_[i];
+    times_[i] = imu.timestamp;
+    for (int j = 0; j < 3; ++j) {
+      accel_[i * 3 + j] = imu.accel[j];
+      gyro_[i * 3 + j] = imu.gyro[j];
+    }
+  }
+}
+
+void MotionBatch::Unwrap(TimestampUnwrapper *unwrapper) {
+  for (auto &&time : times_) {
+    time = unwrapper->Unwrap(time);
+  }
+}
+
+void MotionBatch::Convert(double gravity) {
+  // contiguous, so the compiler vectorizes them
+  const double rad = M_PI / 180;
+  double *accel = accel_.data();
+  for (std::size_t i = 0, n = accel_.size(); i < n; ++i) {
+    accel[i] *= gravity;
+  }
+  double *gyro = gyro_.data();
+  for (std::size_t i = 0, n = gyro_.size(); i < n; ++i) {
+    gyro[i] *= rad;
+  }
+}
+
+PullThread::PullThread()
+    : stopping_(false), ticks_(0), samples_(0), max_samples_(0) {}
+
+PullThread::~PullThread() {
+  Stop();
+}
+
+void PullThread::Start(double period, tick_t tick) {
+  Stop();
+  stopping_ = false;
+  thread_ = std::thread(&PullThread::Run, this, period, std::move(tick));
+}
+
+void PullThread::Stop() {
+  stopping_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void PullThread::Run(double period, tick_t tick) {
+  pthread_setname_np(pthread_self(), "mynteye_pull");
+  using clock = std::chrono::steady_clock;
+  auto interval = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(period));
+  auto next = clock::now();
+  while (!stopping_) {
+    next += interval;
+    std::this_thread::sleep_until(next);
+    auto now = clock::now();
+    lateness_.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+        now - next).count());
+    if (now - next > interval) {
+      next = now;  // behind, skip the missed ticks
+    }
+    std::uint64_t samples = tick();
+    ++ticks_;
+    samples_ += samples;
+    std::uint64_t max = max_samples_.load();
+    while (samples > max && !max_samples_.compare_exchange_weak(max, samples)) {
+    }
+  }
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,117 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_ACQUISITION_H_
+#define MYNTEYE_WRAPPER_ACQUISITION_H_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+#include "mynteye/api/api.h"
+#include "pipeline_stats.h"
+#include "time_sync.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Motion samples drained from the SDK at once, see acquisition/mode. Their
+ * timestamps and units are converted column by column over the batch, in
+ * place of one conversion per callback.
+ */
+class MotionBatch {
+ public:
+  /** Take the samples with imu data, in the order of the SDK. */
+  void Assign(const std::vector<api::MotionData> &datas);
+
+  /** Unwrap the hardware timestamps, in 1us. */
+  void Unwrap(TimestampUnwrapper *unwrapper);
+
+  /** Accel from 1g to m/s^2, gyro from deg/s to rad/s. */
+  void Convert(double gravity);
+
+  std::size_t size() const {
+    return imus_.size();
+  }
+  const ImuData &imu(std::size_t i) const {
+    return *imus_[i];
+  }
+  std::uint64_t time(std::size_t i) const {
+    return times_[i];
+  }
+  /** x, y and z of the sample */
+  const double *accel(std::size_t i) const {
+    return &accel_[i * 3];
+  }
+  const double *gyro(std::size_t i) const {
+    return &gyro_[i * 3];
+  }
+
+ private:
+  std::vector<std::shared_ptr<ImuData>> imus_;
+  std::vector<std::uint64_t> times_;
+  std::vector<double> accel_;
+  std::vector<double> gyro_;
+};
+
+/**
+ * Thread of the pull mode, calls the tick every period to drain the SDK
+ * queues, so the SDK threads only queue and never wait on ROS. Late ticks
+ * are not caught up.
+ */
+class PullThread {
+ public:
+  /** Drains the queues, returns the motion samples drained. */
+  using tick_t = std::function<std::size_t()>;
+
+  PullThread();
+  ~PullThread();
+
+  /** @param period between two ticks, in 1s */
+  void Start(double period, tick_t tick);
+  void Stop();
+
+  std::uint64_t ticks() const {
+    return ticks_;
+  }
+  std::uint64_t samples() const {
+    return samples_;
+  }
+  /** Most samples of a tick since the last call. */
+  std::uint64_t TakeMaxSamples() {
+    return max_samples_.exchange(0);
+  }
+  /** From the schedule to the start of each tick */
+  LatencyHistogram &lateness() {
+    return lateness_;
+  }
+
+ private:
+  void Run(double period, tick_t tick);
+
+  std::thread thread_;
+  std::atomic<bool> stopping_;
+  std::atomic<std::uint64_t> ticks_;
+  std::atomic<std::uint64_t> samples_;
+  std::atomic<std::uint64_t> max_samples_;
+  LatencyHistogram lateness_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_ACQUISITION_H_
@@ -0,0 +1,170 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "alloc_stats.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+std::atomic<bool> enabled(false);
+
+// plain data, usable from operator new before any init
+thread_local std::uint64_t thread_allocations = 0;
+thread_local std::uint64_t thread_allocated_bytes = 0;
+thread_local std::uint64_t thread_copied_bytes = 0;
+
+#ifdef WITH_OPENCV3
+
+/**
+ * Counts the Mat buffers, e.g. the outputs of cvtColor and convertTo, then
+ * hands over to the standard allocator. Its buffers are freed by it too.
+ */
+class CountingMatAllocator : public cv::MatAllocator {
+ public:
+  CountingMatAllocator() : std_(cv::Mat::getStdAllocator()) {}
+
+  cv::UMatData *allocate(
+      int dims, const int *sizes, int type, void *data, size_t *step,
+      int flags, cv::UMatUsageFlags usage) const override {
+    if (data == nullptr) {
+      std::size_t bytes = CV_ELEM_SIZE(type);
+      for (int i = 0; i < dims; i++) {
+        bytes *= sizes[i];
+      }
+      alloc_stats::CountAllocation(bytes);
+    }
+    return std_->allocate(dims, sizes, type, data, step, flags, usage);
+  }
+
+  bool allocate(
+      cv::UMatData *data, int flags, cv::UMatUsageFlags usage) const override {
+    return std_->allocate(data, flags, usage);
+  }
+
+  void deallocate(cv::UMatData *data) const override {
+    std_->deallocate(data);
+  }
+
+ private:
+  cv::MatAllocator *std_;
+};
+
+#endif
+
+}  // namespace
+
+AllocCounts operator-(const AllocCounts &lhs, const AllocCounts &rhs) {
+  AllocCounts counts;
+  counts.allocations = lhs.allocations - rhs.allocations;
+  counts.allocated_bytes = lhs.allocated_bytes - rhs.allocated_bytes;
+  counts.copied_bytes = lhs.copied_bytes - rhs.copied_bytes;
+  return counts;
+}
+
+namespace alloc_stats {
+
+void Enable() {
+  if (enabled.exchange(true))
+    return;
+#ifdef WITH_OPENCV3
+  static CountingMatAllocator allocator;
+  cv::Mat::setDefaultAllocator(&allocator);
+#endif
+}
+
+bool Enabled() {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+bool HooksBuilt() {
+#ifdef MYNTEYE_ALLOC_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+AllocCounts ThreadCounts() {
+  AllocCounts counts;
+  counts.allocations = thread_allocations;
+  counts.allocated_bytes = thread_allocated_bytes;
+  counts.copied_bytes = thread_copied_bytes;
+  return counts;
+}
+
+void CountAllocation(std::size_t bytes) {
+  if (!Enabled())
+    return;
+  ++thread_allocations;
+  thread_allocated_bytes += bytes;
+}
+
+void CountCopy(std::size_t bytes) {
+  if (!Enabled())
+    return;
+  thread_copied_bytes += bytes;
+}
+
+}  // namespace alloc_stats
+
+MYNTEYE_END_NAMESPACE
+
+#ifdef MYNTEYE_ALLOC_STATS
+
+// replaces the global operator new of the process, build mode only
+
+void *operator new(std::size_t size) {
+  mynteye::alloc_stats::CountAllocation(size);
+  void *ptr = std::malloc(size > 0 ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  mynteye::alloc_stats::CountAllocation(size);
+  return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+#endif
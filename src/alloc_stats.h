@@ -0,0 +1,61 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_ALLOC_STATS_H_
+#define MYNTEYE_WRAPPER_ALLOC_STATS_H_
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mynteye/mynteye.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Heap allocations and copies of one thread.
+ *
+ * Once enabled, the cv::Mat buffers are counted by a counting allocator with
+ * OpenCV 3, the operator new ones if built with MYNTEYE_ALLOC_STATS, and the
+ * copies by the publish path as it makes them.
+ */
+struct AllocCounts {
+  std::uint64_t allocations = 0;
+  std::uint64_t allocated_bytes = 0;
+  std::uint64_t copied_bytes = 0;
+};
+
+AllocCounts operator-(const AllocCounts &lhs, const AllocCounts &rhs);
+
+namespace alloc_stats {
+
+/** Start counting, e.g. at init. Not undone. */
+void Enable();
+
+bool Enabled();
+
+/** Whether operator new is counted, see MYNTEYE_ALLOC_STATS */
+bool HooksBuilt();
+
+/** Counts of the calling thread since it started. */
+AllocCounts ThreadCounts();
+
+void CountAllocation(std::size_t bytes);
+
+void CountCopy(std::size_t bytes);
+
+}  // namespace alloc_stats
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_ALLOC_STATS_H_
@@ -0,0 +1,38 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <nodelet/loader.h>
+#include <ros/ros.h>
+
+#include "mynteye/logger.h"
+
+// The subscriber bench in its own process, so over tcpros. Its params are
+// ~bench/*, as in the wrapper process.
+
+int main(int argc, char *argv[]) {
+  glog_init _(argc, argv);
+
+  ros::init(argc, argv, "mynteye_bench_node");
+  ros::console::set_logger_level(
+      ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Info);
+
+  nodelet::Loader nodelet;
+  nodelet::M_string remap(ros::names::getRemappings());
+  nodelet::V_string nargv;
+  nodelet.load(ros::this_node::getName() + "/bench",
+      "mynteye/SubscriberBenchNodelet", remap, nargv);
+
+  ros::spin();
+
+  return 0;
+}
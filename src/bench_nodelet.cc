@@ -0,0 +1,154 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <nodelet/nodelet.h>
+#include <ros/ros.h>
+
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+#include "delivery_stats.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Subscribes to wrapper topics and reports what they deliver, fps, jitter,
+ * stamp to receipt latency and bytes, as json.
+ *
+ * In the process of the wrapper the messages are passed by pointer, see
+ * bench/enable, else over tcpros, see mynteye_bench_node.
+ */
+class SubscriberBenchNodelet : public nodelet::Nodelet {
+ public:
+  void onInit() override {
+    auto &&private_nh = getPrivateNodeHandle();
+    // topics relative to the namespace of the process, e.g. /mynteye
+    nh_ = ros::NodeHandle(ros::this_node::getNamespace());
+
+    std::vector<std::string> image_topics{"left/image_raw"};
+    std::vector<std::string> points_topics;
+    std::vector<std::string> imu_topics{"imu/data_raw"};
+    int queue_size = 10;
+    bool tcp_nodelay = true;
+    private_nh.getParam("image_topics", image_topics);
+    private_nh.getParam("points_topics", points_topics);
+    private_nh.getParam("imu_topics", imu_topics);
+    private_nh.getParam("queue_size", queue_size);
+    private_nh.getParam("tcp_nodelay", tcp_nodelay);
+    private_nh.getParam("duration", duration_);
+    private_nh.getParam("report", report_);
+    private_nh.getParam("shutdown", shutdown_);
+
+    ros::TransportHints hints;
+    if (tcp_nodelay) {
+      hints.tcpNoDelay();
+    }
+    subscribe<sensor_msgs::Image>(image_topics, queue_size, hints);
+    subscribe<sensor_msgs::PointCloud2>(points_topics, queue_size, hints);
+    subscribe<sensor_msgs::Imu>(imu_topics, queue_size, hints);
+
+    // the run starts at the first message, the device may take a while
+    timer_ = nh_.createWallTimer(
+        ros::WallDuration(0.1), &SubscriberBenchNodelet::check, this);
+    NODELET_INFO_STREAM("Bench of " << stats_.size() << " topics for "
+        << duration_ << " s");
+  }
+
+ private:
+  template <typename M>
+  void subscribe(
+      const std::vector<std::string> &topics, int queue_size,
+      const ros::TransportHints &hints) {
+    for (auto &&topic : topics) {
+      stats_.emplace_back(new DeliveryStats(nh_.resolveName(topic)));
+      DeliveryStats *stats = stats_.back().get();
+      subscribers_.push_back(nh_.subscribe<M>(topic, queue_size,
+          [stats](const boost::shared_ptr<const M> &msg) {
+            stats->Receive(msg->header.seq,
+                (ros::Time::now() - msg->header.stamp).toNSec() / 1000,
+                ros::serialization::serializationLength(*msg));
+          },
+          ros::VoidConstPtr(), hints));
+    }
+  }
+
+  void check(const ros::WallTimerEvent &) {
+    ros::WallTime now = ros::WallTime::now();
+    if (begin_.isZero()) {
+      for (auto &&stats : stats_) {
+        if (stats->messages() > 0) {
+          begin_ = now;
+          break;
+        }
+      }
+      return;
+    }
+    if ((now - begin_).toSec() >= duration_) {
+      finish();
+    }
+  }
+
+  void finish() {
+    timer_.stop();
+    for (auto &&subscriber : subscribers_) {
+      subscriber.shutdown();
+    }
+    std::vector<DeliveryStats::Report> reports;
+    for (auto &&stats : stats_) {
+      auto &&report = stats->Take();
+      NODELET_INFO_STREAM(report.topic << ": " << report.fps << " fps, "
+          << report.mb_per_second << " MB/s, jitter "
+          << report.interval_jitter << " ms, latency p50 "
+          << report.latency.p50 << " ms, p99 " << report.latency.p99
+          << " ms, missed " << report.missed);
+      reports.push_back(report);
+    }
+    std::string json = ToJson(reports);
+    if (report_.empty()) {
+      NODELET_INFO_STREAM("Bench report:\n" << json);
+    } else {
+      std::ofstream out(report_);
+      out << json << std::endl;
+      if (out) {
+        NODELET_INFO_STREAM("Bench report written to " << report_);
+      } else {
+        NODELET_ERROR_STREAM("Write bench report " << report_ << " failed");
+      }
+    }
+    if (shutdown_) {
+      ros::requestShutdown();
+    }
+  }
+
+  ros::NodeHandle nh_;
+  std::vector<ros::Subscriber> subscribers_;
+  std::vector<std::unique_ptr<DeliveryStats>> stats_;
+  ros::WallTimer timer_;
+  ros::WallTime begin_;
+
+  double duration_ = 10;
+  std::string report_;
+  bool shutdown_ = false;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#include <pluginlib/class_list_macros.h>  // NOLINT
+PLUGINLIB_EXPORT_CLASS(mynteye::SubscriberBenchNodelet, nodelet::Nodelet);
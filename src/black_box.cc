@@ -0,0 +1,292 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "black_box.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+using record::align_up;
+
+namespace {
+
+const std::uint64_t NO_DUMP = std::numeric_limits<std::uint64_t>::max();
+
+// wait for the disk or a record being written
+const std::chrono::milliseconds DUMP_RETRY(1);
+// the disk did not take one record for so long, give the dump up
+const std::chrono::seconds DUMP_STALL(10);
+
+}  // namespace
+
+BlackBox::BlackBox()
+    : buffer_(nullptr),
+      capacity_(0),
+      head_(0),
+      seq_(0),
+      dump_next_(NO_DUMP),
+      dump_end_(NO_DUMP),
+      dumping_(false),
+      records_(0),
+      dropped_(0),
+      dumps_(0) {}
+
+BlackBox::~BlackBox() {
+  Close();
+}
+
+bool BlackBox::Open(const Options &options) {
+  Close();
+  options_ = options;
+  capacity_ = align_up(
+      std::max<std::size_t>(options_.budget, record::BLOCK_SIZE),
+      record::BLOCK_SIZE);
+  void *buffer = nullptr;
+  if (posix_memalign(&buffer, record::BLOCK_SIZE, capacity_) != 0) {
+    LOG(ERROR) << "Allocate black box of " << (capacity_ >> 20)
+               << " MB failed";
+    capacity_ = 0;
+    return false;
+  }
+  // touch every page now, not on the callback threads
+  std::memset(buffer, 0, capacity_);
+  buffer_ = static_cast<std::uint8_t *>(buffer);
+  return true;
+}
+
+void BlackBox::Close() {
+  // an incident right before shutdown is still dumped
+  if (dump_thread_.joinable()) {
+    dump_thread_.join();
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  entries_.clear();
+  head_ = 0;
+  std::free(buffer_);
+  buffer_ = nullptr;
+  capacity_ = 0;
+}
+
+bool BlackBox::WriteImage(
+    const record::RecordHeader &header, const std::uint8_t *data,
+    std::size_t row_bytes, std::size_t rows, std::size_t step) {
+  record::RecordHeader head = header;
+  head.type = record::RECORD_IMAGE;
+  head.size = row_bytes * rows;
+  head.step = row_bytes;
+
+  std::uint64_t seq;
+  std::uint8_t *dst = Reserve(head, &seq);
+  if (dst == nullptr)
+    return false;
+  if (step == row_bytes) {
+    std::memcpy(dst, data, head.size);
+  } else {
+    for (std::size_t i = 0; i < rows; i++) {
+      std::memcpy(dst + i * row_bytes, data + i * step, row_bytes);
+    }
+  }
+  Commit(seq);
+  return true;
+}
+
+bool BlackBox::WriteImu(
+    std::uint64_t timestamp, const record::ImuRecord &imu) {
+  record::RecordHeader head{};
+  head.type = record::RECORD_IMU;
+  head.size = sizeof(imu);
+  head.frame_id = static_cast<std::uint16_t>(imu.frame_id);
+  head.timestamp = timestamp;
+  head.is_ets = imu.is_ets;
+
+  std::uint64_t seq;
+  std::uint8_t *dst = Reserve(head, &seq);
+  if (dst == nullptr)
+    return false;
+  std::memcpy(dst, &imu, sizeof(imu));
+  Commit(seq);
+  return true;
+}
+
+std::uint8_t *BlackBox::Reserve(
+    const record::RecordHeader &header, std::uint64_t *seq) {
+  std::size_t bytes =
+      sizeof(header) + align_up(header.size, record::RECORD_ALIGN);
+  std::lock_guard<std::mutex> _(mutex_);
+  if (buffer_ == nullptr || bytes > capacity_) {
+    ++dropped_;
+    return nullptr;
+  }
+  if (entries_.empty()) {
+    head_ = 0;
+  }
+  std::size_t pos = head_;
+  if (pos + bytes > capacity_) {
+    // the end is left unused, the records there are the oldest
+    while (!entries_.empty() && entries_.front().offset >= head_) {
+      if (!Evict()) {
+        ++dropped_;
+        return nullptr;
+      }
+    }
+    pos = 0;
+  }
+  while (!entries_.empty() && entries_.front().offset >= pos &&
+         entries_.front().offset < pos + bytes) {
+    if (!Evict()) {
+      ++dropped_;
+      return nullptr;
+    }
+  }
+
+  *seq = seq_++;
+  entries_.push_back({pos, bytes, *seq, clock::now(), false});
+  head_ = pos + bytes;
+  std::uint8_t *dst = buffer_ + pos;
+  std::memcpy(dst, &header, sizeof(header));
+  ++records_;
+  return dst + sizeof(header);
+}
+
+void BlackBox::Commit(std::uint64_t seq) {
+  std::lock_guard<std::mutex> _(mutex_);
+  // not evicted before committed
+  entries_[seq - entries_.front().seq].committed = true;
+}
+
+bool BlackBox::Evict() {
+  auto &&entry = entries_.front();
+  // still being written, or not dumped yet
+  if (!entry.committed || entry.seq >= dump_next_)
+    return false;
+  entries_.pop_front();
+  return true;
+}
+
+bool BlackBox::Dump(const std::string &path, double seconds) {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (dumping_ || buffer_ == nullptr)
+      return false;
+  }
+  if (dump_thread_.joinable()) {
+    dump_thread_.join();
+  }
+  if (!dump_recorder_.Open(path, options_.record))
+    return false;
+
+  std::lock_guard<std::mutex> _(mutex_);
+  dump_end_ = seq_;
+  dump_next_ = seq_;
+  auto since = clock::now() - std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(seconds));
+  for (auto &&it = entries_.rbegin(); it != entries_.rend(); ++it) {
+    if (seconds > 0 && it->time < since)
+      break;
+    dump_next_ = it->seq;
+  }
+  dumping_ = true;
+  ++dumps_;
+  LOG(INFO) << "Black box dumping " << (dump_end_ - dump_next_)
+            << " records to " << path;
+  dump_thread_ = std::thread(&BlackBox::RunDump, this, path);
+  return true;
+}
+
+bool BlackBox::IsDumping() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return dumping_;
+}
+
+double BlackBox::Span() {
+  std::lock_guard<std::mutex> _(mutex_);
+  if (entries_.empty())
+    return 0;
+  return std::chrono::duration<double>(
+      entries_.back().time - entries_.front().time).count();
+}
+
+void BlackBox::RunDump(std::string path) {
+  bool failed = false;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (dump_next_ < dump_end_) {
+    const Entry &entry = entries_[dump_next_ - entries_.front().seq];
+    if (!entry.committed) {
+      lock.unlock();
+      std::this_thread::sleep_for(DUMP_RETRY);
+      lock.lock();
+      continue;
+    }
+    // kept until dump_next_ moves past it, so read without the lock
+    const std::uint8_t *src = buffer_ + entry.offset;
+    lock.unlock();
+
+    record::RecordHeader header;
+    std::memcpy(&header, src, sizeof(header));
+    const std::uint8_t *data = src + sizeof(header);
+    bool written = false;
+    auto stall_end = std::chrono::steady_clock::now() + DUMP_STALL;
+    while (!written) {
+      if (header.type == record::RECORD_IMU) {
+        record::ImuRecord imu;
+        std::memcpy(&imu, data, sizeof(imu));
+        written = dump_recorder_.WriteImu(header.timestamp, imu);
+      } else {
+        written = dump_recorder_.WriteImage(
+            header, data, header.step, header.height, header.step);
+      }
+      if (written)
+        break;
+      if (dump_recorder_.failed() ||
+          std::chrono::steady_clock::now() > stall_end) {
+        break;
+      }
+      // the chunk buffers are waiting for the disk
+      std::this_thread::sleep_for(DUMP_RETRY);
+    }
+
+    lock.lock();
+    if (!written) {
+      failed = true;
+      break;
+    }
+    ++dump_next_;
+  }
+  lock.unlock();
+
+  dump_recorder_.Close();
+  if (failed || dump_recorder_.failed()) {
+    LOG(ERROR) << "Black box dump to " << path << " failed after "
+               << dump_recorder_.records() << " records, "
+               << (dump_recorder_.failed() ? "the write failed"
+                                           : "the disk stalled");
+  } else {
+    LOG(INFO) << "Black box dumped " << dump_recorder_.records()
+              << " records, " << (dump_recorder_.written_bytes() >> 20)
+              << " MB to " << path;
+  }
+
+  lock.lock();
+  dump_next_ = NO_DUMP;
+  dump_end_ = NO_DUMP;
+  dumping_ = false;
+}
+
+MYNTEYE_END_NAMESPACE
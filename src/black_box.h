@@ -0,0 +1,131 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_BLACK_BOX_H_
+#define MYNTEYE_WRAPPER_BLACK_BOX_H_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "recorder.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Keeps the latest images and imu samples in a fixed memory budget, and
+ * dumps them to a native recording on demand.
+ *
+ * The budget is allocated and touched once at open. Records are laid out
+ * back to back in a ring as in a chunk, a write evicts the oldest records
+ * it overlaps and costs one copy. A dump runs on its own thread, the records
+ * it has not written yet are kept, new records are dropped if they would
+ * evict them.
+ */
+class BlackBox {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  struct Options {
+    /** Bytes of the ring */
+    std::size_t budget = 1024 << 20;
+    /** Options of the dumped recordings */
+    Recorder::Options record;
+  };
+
+  BlackBox();
+  ~BlackBox();
+
+  bool Open(const Options &options);
+  /** Wait for a running dump, then free the ring. */
+  void Close();
+
+  bool IsOpened() const {
+    return buffer_ != nullptr;
+  }
+
+  /** Same as Recorder::WriteImage(). */
+  bool WriteImage(
+      const record::RecordHeader &header, const std::uint8_t *data,
+      std::size_t row_bytes, std::size_t rows, std::size_t step);
+
+  bool WriteImu(std::uint64_t timestamp, const record::ImuRecord &imu);
+
+  /**
+   * Start dumping the records written in the last seconds.
+   * @param seconds 0 for all records in the ring
+   * @return false if a dump is running or the file could not be opened
+   */
+  bool Dump(const std::string &path, double seconds);
+
+  bool IsDumping();
+
+  std::uint64_t records() const {
+    return records_;
+  }
+  std::uint64_t dropped() const {
+    return dropped_;
+  }
+  std::uint64_t dumps() const {
+    return dumps_;
+  }
+  std::size_t capacity() const {
+    return capacity_;
+  }
+  /** Seconds between the oldest and the latest record in the ring */
+  double Span();
+
+ private:
+  struct Entry {
+    std::size_t offset;
+    std::size_t bytes;
+    std::uint64_t seq;
+    clock::time_point time;
+    bool committed;
+  };
+
+  std::uint8_t *Reserve(const record::RecordHeader &header, std::uint64_t *seq);
+  void Commit(std::uint64_t seq);
+  bool Evict();
+  void RunDump(std::string path);
+
+  Options options_;
+  std::uint8_t *buffer_;
+  std::size_t capacity_;
+
+  std::mutex mutex_;
+  /** Records in the ring, oldest first, seq increases by one */
+  std::deque<Entry> entries_;
+  std::size_t head_;
+  std::uint64_t seq_;
+
+  // records [dump_next_, dump_end_) are kept until dumped
+  std::uint64_t dump_next_;
+  std::uint64_t dump_end_;
+  bool dumping_;
+  Recorder dump_recorder_;
+  std::thread dump_thread_;
+
+  std::atomic<std::uint64_t> records_;
+  std::atomic<std::uint64_t> dropped_;
+  std::atomic<std::uint64_t> dumps_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_BLACK_BOX_H_
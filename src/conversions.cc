@@ -0,0 +1,128 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "conversions.h"
+
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstdint>
+
+MYNTEYE_BEGIN_NAMESPACE
+
+cv::Mat WrapImageMsg(
+    sensor_msgs::Image *msg, const std::string &encoding, int rows, int cols,
+    int type) {
+  msg->encoding = encoding;
+  msg->height = rows;
+  msg->width = cols;
+  msg->is_bigendian = false;
+  msg->step = cols * CV_ELEM_SIZE(type);
+  msg->data.resize(msg->step * rows);
+  return cv::Mat(rows, cols, type, msg->data.data(), msg->step);
+}
+
+void FillMonoMsg(const cv::Mat &img, sensor_msgs::Image *msg) {
+  cv::Mat mono = WrapImageMsg(
+      msg, sensor_msgs::image_encodings::MONO8, img.rows, img.cols, CV_8UC1);
+  cv::cvtColor(img, mono, CV_RGB2GRAY);
+}
+
+void FillDisparityMsg(
+    const cv::Mat &disparity, const std::string &encoding,
+    sensor_msgs::Image *msg) {
+  cv::Mat dst = WrapImageMsg(
+      msg, encoding, disparity.rows, disparity.cols, CV_8UC1);
+  disparity.convertTo(dst, CV_8UC1);
+}
+
+void FillPointCloudMsg(const cv::Mat &points, sensor_msgs::PointCloud2 *msg) {
+  msg->width = points.cols;
+  msg->height = points.rows;
+  msg->is_dense = true;
+
+  sensor_msgs::PointCloud2Modifier modifier(*msg);
+
+  modifier.setPointCloud2Fields(
+      4, "x", 1, sensor_msgs::PointField::FLOAT32, "y", 1,
+      sensor_msgs::PointField::FLOAT32, "z", 1,
+      sensor_msgs::PointField::FLOAT32, "rgb", 1,
+      sensor_msgs::PointField::FLOAT32);
+
+  modifier.setPointCloud2FieldsByString(2, "xyz", "rgb");
+
+  sensor_msgs::PointCloud2Iterator<float> iter_x(*msg, "x");
+  sensor_msgs::PointCloud2Iterator<float> iter_y(*msg, "y");
+  sensor_msgs::PointCloud2Iterator<float> iter_z(*msg, "z");
+
+  sensor_msgs::PointCloud2Iterator<uint8_t> iter_r(*msg, "r");
+  sensor_msgs::PointCloud2Iterator<uint8_t> iter_g(*msg, "g");
+  sensor_msgs::PointCloud2Iterator<uint8_t> iter_b(*msg, "b");
+
+  for (int y = 0; y < points.rows; ++y) {
+    for (int x = 0; x < points.cols; ++x) {
+      auto &&point = points.at<cv::Vec3f>(y, x);
+
+      *iter_x = point[2] * 0.001;
+      *iter_y = 0.f - point[0] * 0.001;
+      *iter_z = 0.f - point[1] * 0.001;
+
+      *iter_r = static_cast<uint8_t>(255);
+      *iter_g = static_cast<uint8_t>(255);
+      *iter_b = static_cast<uint8_t>(255);
+
+      ++iter_x;
+      ++iter_y;
+      ++iter_z;
+      ++iter_r;
+      ++iter_g;
+      ++iter_b;
+    }
+  }
+}
+
+void NormalizeDisparity(const cv::Mat &disparity, cv::Mat *normalized) {
+  cv::normalize(disparity, *normalized, 0, 255, cv::NORM_MINMAX, CV_8UC1);
+}
+
+void DisparityToDepth(
+    const cv::Mat &disparity, const cv::Mat &q, cv::Mat *depth) {
+  CV_Assert(disparity.type() == CV_32FC1 && q.rows == 4 && q.cols == 4);
+  cv::Mat_<double> q64 = q;
+  // z = f / w, w = d * (-1 / tx) + (cx - cx') / tx
+  double f = q64(2, 3);
+  double a = q64(3, 2);
+  double b = q64(3, 3);
+  depth->create(disparity.size(), CV_16UC1);
+  for (int y = 0; y < disparity.rows; ++y) {
+    const float *d = disparity.ptr<float>(y);
+    std::uint16_t *z = depth->ptr<std::uint16_t>(y);
+    for (int x = 0; x < disparity.cols; ++x) {
+      double w = d[x] * a + b;
+      double value = (d[x] > 0 && w != 0) ? f / w : 0;
+      z[x] = value > 0 ? cv::saturate_cast<std::uint16_t>(value) : 0;
+    }
+  }
+}
+
+void DisparityToPoints(
+    const cv::Mat &disparity, const cv::Mat &q, cv::Mat *points) {
+  CV_Assert(q.rows == 4 && q.cols == 4);
+  // missing at a large z, as the points of the SDK
+  cv::reprojectImageTo3D(disparity, *points, q, true);
+}
+
+MYNTEYE_END_NAMESPACE
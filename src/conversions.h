@@ -0,0 +1,74 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_CONVERSIONS_H_
+#define MYNTEYE_WRAPPER_CONVERSIONS_H_
+#pragma once
+
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+#include "mynteye/mynteye.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Conversions of frames into messages, written into the message data without
+ * intermediate images. The messages are sized once and then reused by the
+ * MessagePool.
+ */
+
+/**
+ * Size the message for the image, return a Mat header over its data.
+ */
+cv::Mat WrapImageMsg(
+    sensor_msgs::Image *msg, const std::string &encoding, int rows, int cols,
+    int type);
+
+/** Color frame to mono8. */
+void FillMonoMsg(const cv::Mat &img, sensor_msgs::Image *msg);
+
+/** 32FC1 disparity to 8UC1, in the given encoding. */
+void FillDisparityMsg(
+    const cv::Mat &disparity, const std::string &encoding,
+    sensor_msgs::Image *msg);
+
+/**
+ * 32FC3 points in 1mm of the camera frame to a white xyzrgb cloud in 1m of
+ * the ros frame, x forward, y left, z up. Sets all but the header.
+ */
+void FillPointCloudMsg(const cv::Mat &points, sensor_msgs::PointCloud2 *msg);
+
+/**
+ * Streams of the 32FC1 disparity in the wrapper, see StreamGraph. q is the
+ * reprojection matrix of stereoRectify, in 1mm as the extrinsics.
+ */
+
+/** To 8UC1, stretched from its min to its max, as DISPARITY_NORMALIZED. */
+void NormalizeDisparity(const cv::Mat &disparity, cv::Mat *normalized);
+
+/** From 32FC1 to 16UC1 depth in 1mm, 0 where unknown, as DEPTH. */
+void DisparityToDepth(
+    const cv::Mat &disparity, const cv::Mat &q, cv::Mat *depth);
+
+/** To 32FC3 points in 1mm of the camera frame, as POINTS. */
+void DisparityToPoints(
+    const cv::Mat &disparity, const cv::Mat &q, cv::Mat *points);
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_CONVERSIONS_H_
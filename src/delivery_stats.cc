@@ -0,0 +1,113 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "delivery_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+// implemented by info_json.cc
+#include "configuru.hpp"
+using namespace configuru;  // NOLINT
+
+MYNTEYE_BEGIN_NAMESPACE
+
+DeliveryStats::DeliveryStats(const std::string &topic)
+    : topic_(topic),
+      messages_(0),
+      bytes_(0),
+      missed_(0),
+      interval_mean_(0),
+      interval_m2_(0),
+      interval_max_(0) {}
+
+void DeliveryStats::Receive(
+    std::uint32_t seq, std::int64_t latency, std::size_t bytes) {
+  auto now = clock::now();
+  std::lock_guard<std::mutex> _(mutex_);
+  if (messages_ == 0) {
+    first_ = now;
+  } else {
+    double interval =
+        std::chrono::duration<double, std::milli>(now - last_).count();
+    // welford, messages_ intervals with this one
+    double delta = interval - interval_mean_;
+    interval_mean_ += delta / messages_;
+    interval_m2_ += delta * (interval - interval_mean_);
+    interval_max_ = std::max(interval_max_, interval);
+  }
+  last_ = now;
+  ++messages_;
+  bytes_ += bytes;
+  missed_ += seq_gap_.Next(seq);
+  latency_.Record(latency);
+}
+
+std::uint64_t DeliveryStats::messages() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return messages_;
+}
+
+DeliveryStats::Report DeliveryStats::Take() {
+  std::lock_guard<std::mutex> _(mutex_);
+  Report report;
+  report.topic = topic_;
+  report.messages = messages_;
+  report.missed = missed_;
+  report.bytes = bytes_;
+  report.latency = latency_.TakeSummary();
+  if (messages_ > 1) {
+    report.seconds = std::chrono::duration<double>(last_ - first_).count();
+    report.fps = (messages_ - 1) / report.seconds;
+    report.mb_per_second = bytes_ / report.seconds / (1 << 20);
+    report.interval_mean = interval_mean_;
+    report.interval_jitter = std::sqrt(interval_m2_ / (messages_ - 1));
+    report.interval_max = interval_max_;
+  }
+  messages_ = 0;
+  bytes_ = 0;
+  missed_ = 0;
+  seq_gap_ = SequenceGap<std::uint32_t>();
+  interval_mean_ = 0;
+  interval_m2_ = 0;
+  interval_max_ = 0;
+  return report;
+}
+
+std::string ToJson(const std::vector<DeliveryStats::Report> &reports) {
+  Config topics = Config::object();
+  for (auto &&report : reports) {
+    topics[report.topic] = {
+      {"messages", report.messages},
+      {"missed", report.missed},
+      {"bytes", report.bytes},
+      {"seconds", report.seconds},
+      {"fps", report.fps},
+      {"mb_per_second", report.mb_per_second},
+      {"interval_ms", {
+        {"mean", report.interval_mean},
+        {"jitter", report.interval_jitter},
+        {"max", report.interval_max}
+      }},
+      {"latency_ms", {
+        {"p50", report.latency.p50},
+        {"p90", report.latency.p90},
+        {"p99", report.latency.p99},
+        {"max", report.latency.max}
+      }}
+    };
+  }
+  return dump_string(topics, JSON);
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,86 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_DELIVERY_STATS_H_
+#define MYNTEYE_WRAPPER_DELIVERY_STATS_H_
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+#include "pipeline_stats.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Messages of one topic as a subscriber receives them, see
+ * SubscriberBenchNodelet.
+ */
+class DeliveryStats {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  struct Report {
+    std::string topic;
+    std::uint64_t messages = 0;
+    /** Gaps in the header seq, lost on the way or never published */
+    std::uint64_t missed = 0;
+    std::uint64_t bytes = 0;
+    /** First to last receipt */
+    double seconds = 0;
+    double fps = 0;
+    double mb_per_second = 0;
+    /** Between receipts in 1ms, the jitter is their standard deviation */
+    double interval_mean = 0;
+    double interval_jitter = 0;
+    double interval_max = 0;
+    /** Header stamp to receipt */
+    LatencyHistogram::Summary latency;
+  };
+
+  explicit DeliveryStats(const std::string &topic);
+
+  /** From the subscriber callback, latency in 1us. */
+  void Receive(std::uint32_t seq, std::int64_t latency, std::size_t bytes);
+
+  std::uint64_t messages();
+
+  /** Report of all messages received, which are then cleared. */
+  Report Take();
+
+ private:
+  std::mutex mutex_;
+  std::string topic_;
+  std::uint64_t messages_;
+  std::uint64_t bytes_;
+  SequenceGap<std::uint32_t> seq_gap_;
+  std::uint64_t missed_;
+  clock::time_point first_;
+  clock::time_point last_;
+  // running mean and squared deviations of the intervals in 1ms
+  double interval_mean_;
+  double interval_m2_;
+  double interval_max_;
+  LatencyHistogram latency_;
+};
+
+/** The reports as one json object, with the topics as keys. */
+std::string ToJson(const std::vector<DeliveryStats::Report> &reports);
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_DELIVERY_STATS_H_
@@ -0,0 +1,110 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_FRAME_CACHE_H_
+#define MYNTEYE_WRAPPER_FRAME_CACHE_H_
+#pragma once
+
+#include <ros/time.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "mynteye/mynteye.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Recent published messages of a stream, ordered by header stamp.
+ *
+ * The cache shares the published messages, it holds references and copies
+ * nothing. An evicted message goes back to its MessagePool once subscribers
+ * released it too.
+ */
+template <typename M>
+class FrameCache {
+ public:
+  using ConstPtr = boost::shared_ptr<const M>;
+
+  /**
+   * @param seconds the stamps kept, from the latest
+   * @param capacity the messages kept at most
+   */
+  FrameCache(double seconds, std::size_t capacity)
+      : duration_(std::max(seconds, 0.0)),
+        capacity_(std::max<std::size_t>(capacity, 1)) {}
+
+  MYNTEYE_DISABLE_COPY(FrameCache)
+
+  void Put(const ConstPtr &msg) {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (!frames_.empty() && msg->header.stamp < frames_.back()->header.stamp) {
+      // e.g. time reset by a playback loop
+      frames_.insert(UpperBound(msg->header.stamp), msg);
+    } else {
+      frames_.push_back(msg);
+    }
+    const ros::Time &latest = frames_.back()->header.stamp;
+    while (frames_.size() > capacity_ ||
+           latest - frames_.front()->header.stamp > duration_) {
+      frames_.pop_front();
+    }
+  }
+
+  /** The message with the stamp nearest to the given one, null if empty. */
+  ConstPtr Nearest(const ros::Time &stamp) {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (frames_.empty())
+      return nullptr;
+    auto &&it = UpperBound(stamp);
+    if (it == frames_.end())
+      return frames_.back();
+    if (it == frames_.begin())
+      return frames_.front();
+    auto &&prev = it - 1;
+    return stamp - (*prev)->header.stamp < (*it)->header.stamp - stamp ?
+        *prev : *it;
+  }
+
+  std::size_t size() {
+    std::lock_guard<std::mutex> _(mutex_);
+    return frames_.size();
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> _(mutex_);
+    frames_.clear();
+  }
+
+ private:
+  typename std::deque<ConstPtr>::iterator UpperBound(const ros::Time &stamp) {
+    return std::upper_bound(frames_.begin(), frames_.end(), stamp,
+        [](const ros::Time &stamp, const ConstPtr &msg) {
+          return stamp < msg->header.stamp;
+        });
+  }
+
+  ros::Duration duration_;
+  std::size_t capacity_;
+
+  std::mutex mutex_;
+  std::deque<ConstPtr> frames_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_FRAME_CACHE_H_
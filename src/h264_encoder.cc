@@ -0,0 +1,242 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "h264_encoder.h"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+extern "C" {
+#include <stdint.h>
+#include <x264.h>
+}
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+H264Encoder::H264Encoder()
+    : encoder_(nullptr), width_(0), height_(0), force_keyframe_(false) {}
+
+H264Encoder::~H264Encoder() {
+  Close();
+}
+
+bool H264Encoder::Open(int width, int height, const Options &options) {
+  Close();
+  if (width <= 0 || height <= 0 || width % 2 != 0 || height % 2 != 0) {
+    LOG(ERROR) << "H264 size must be even: " << width << "x" << height;
+    return false;
+  }
+
+  x264_param_t param;
+  if (x264_param_default_preset(
+          &param, options.preset.c_str(), options.tune.c_str()) < 0) {
+    LOG(ERROR) << "H264 invalid preset " << options.preset << " or tune "
+               << options.tune;
+    return false;
+  }
+  param.i_width = width;
+  param.i_height = height;
+  param.i_csp = X264_CSP_I420;
+  param.i_fps_num = options.fps > 0 ? options.fps : 30;
+  param.i_fps_den = 1;
+  param.i_keyint_max = options.keyint;
+  param.b_repeat_headers = 1;  // sps/pps with every keyframe
+  param.b_annexb = 1;
+  param.i_log_level = X264_LOG_WARNING;
+  param.rc.i_rc_method = X264_RC_ABR;
+  param.rc.i_bitrate = options.bitrate;
+  param.rc.i_vbv_max_bitrate = options.bitrate;
+  param.rc.i_vbv_buffer_size = options.bitrate;
+  x264_param_apply_profile(&param, "baseline");
+
+  encoder_ = x264_encoder_open(&param);
+  if (encoder_ == nullptr) {
+    LOG(ERROR) << "H264 encoder open failed";
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  force_keyframe_ = false;
+  return true;
+}
+
+void H264Encoder::Close() {
+  if (encoder_) {
+    x264_encoder_close(encoder_);
+    encoder_ = nullptr;
+  }
+}
+
+bool H264Encoder::Encode(
+    const std::uint8_t *i420, std::int64_t pts,
+    std::vector<std::uint8_t> *out, bool *keyframe) {
+  if (encoder_ == nullptr)
+    return false;
+
+  // planes reference the input, x264 does not write them
+  std::uint8_t *y = const_cast<std::uint8_t *>(i420);
+  std::size_t y_n = width_ * height_;
+  x264_picture_t pic_in;
+  x264_picture_init(&pic_in);
+  pic_in.img.i_csp = X264_CSP_I420;
+  pic_in.img.i_plane = 3;
+  pic_in.img.plane[0] = y;
+  pic_in.img.plane[1] = y + y_n;
+  pic_in.img.plane[2] = y + y_n + y_n / 4;
+  pic_in.img.i_stride[0] = width_;
+  pic_in.img.i_stride[1] = width_ / 2;
+  pic_in.img.i_stride[2] = width_ / 2;
+  pic_in.i_pts = pts;
+  pic_in.i_type = force_keyframe_ ? X264_TYPE_IDR : X264_TYPE_AUTO;
+  force_keyframe_ = false;
+
+  x264_nal_t *nals = nullptr;
+  int nals_n = 0;
+  x264_picture_t pic_out;
+  int size = x264_encoder_encode(encoder_, &nals, &nals_n, &pic_in, &pic_out);
+  if (size < 0) {
+    LOG(WARNING) << "H264 encode failed";
+    return false;
+  }
+  out->clear();
+  if (size > 0) {
+    // the payloads of all nals are sequential in memory
+    out->assign(nals[0].p_payload, nals[0].p_payload + size);
+  }
+  if (keyframe) {
+    *keyframe = size > 0 && pic_out.b_keyframe;
+  }
+  return true;
+}
+
+H264EncodeWorker::H264EncodeWorker(
+    const H264Encoder::Options &options, publish_t publish)
+    : options_(options),
+      publish_(std::move(publish)),
+      running_(true),
+      pending_(false),
+      force_keyframe_(false),
+      stamp_(0),
+      encoded_count_(0),
+      dropped_count_(0),
+      encode_time_ns_(0) {
+  thread_ = std::thread(&H264EncodeWorker::Run, this);
+}
+
+H264EncodeWorker::~H264EncodeWorker() {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    running_ = false;
+  }
+  cond_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void H264EncodeWorker::Push(
+    const cv::Mat &frame, const std::shared_ptr<void> &holder,
+    std::uint64_t stamp) {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (pending_) {
+      ++dropped_count_;
+    }
+    frame_ = frame;
+    holder_ = holder;
+    stamp_ = stamp;
+    pending_ = true;
+  }
+  cond_.notify_one();
+}
+
+void H264EncodeWorker::ForceKeyframe() {
+  std::lock_guard<std::mutex> _(mutex_);
+  force_keyframe_ = true;
+}
+
+void H264EncodeWorker::ToI420(const cv::Mat &frame) {
+  int width = frame.cols, height = frame.rows;
+  std::size_t y_n = width * height;
+  i420_.resize(y_n * 3 / 2);
+  if (frame.channels() == 3) {
+    // output matches, so cvtColor writes into the recycled buffer
+    cv::Mat i420(height * 3 / 2, width, CV_8UC1, i420_.data());
+    cv::cvtColor(frame, i420, cv::COLOR_BGR2YUV_I420);
+  } else {
+    cv::Mat y(height, width, CV_8UC1, i420_.data());
+    frame.copyTo(y);
+    std::memset(i420_.data() + y_n, 128, y_n / 2);
+  }
+}
+
+void H264EncodeWorker::Run() {
+  std::vector<std::uint8_t> out;
+  std::int64_t pts = 0;
+  while (true) {
+    cv::Mat frame;
+    std::shared_ptr<void> holder;
+    std::uint64_t stamp;
+    bool force_keyframe;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return !running_ || pending_; });
+      if (!running_)
+        break;
+      frame = frame_;
+      holder = holder_;
+      frame_.release();
+      holder_.reset();
+      pending_ = false;
+      stamp = stamp_;
+      force_keyframe = force_keyframe_;
+      force_keyframe_ = false;
+    }
+    if (frame.empty() ||
+        (frame.type() != CV_8UC3 && frame.type() != CV_8UC1)) {
+      continue;
+    }
+
+    // 4:2:0 needs even sizes
+    frame = frame(cv::Rect(0, 0, frame.cols & ~1, frame.rows & ~1));
+    if (!encoder_.IsOpened() || encoder_.width() != frame.cols ||
+        encoder_.height() != frame.rows) {
+      if (!encoder_.Open(frame.cols, frame.rows, options_))
+        continue;
+    }
+    if (force_keyframe) {
+      encoder_.ForceKeyframe();
+    }
+
+    auto time_beg = std::chrono::steady_clock::now();
+    ToI420(frame);
+    frame.release();
+    holder.reset();
+    bool keyframe = false;
+    bool ok = encoder_.Encode(i420_.data(), pts++, &out, &keyframe);
+    encode_time_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - time_beg).count();
+    if (ok && !out.empty()) {
+      ++encoded_count_;
+      publish_(out, keyframe, stamp);
+    }
+  }
+  encoder_.Close();
+}
+
+MYNTEYE_END_NAMESPACE
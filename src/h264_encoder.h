@@ -0,0 +1,152 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_H264_ENCODER_H_
+#define MYNTEYE_WRAPPER_H264_ENCODER_H_
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "mynteye/mynteye.h"
+
+struct x264_t;
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Software h264 encoder of libx264, outputs Annex-B access units.
+ */
+class H264Encoder {
+ public:
+  struct Options {
+    /** Average bitrate in kbit/s */
+    int bitrate = 2000;
+    /** Max frames between two keyframes */
+    int keyint = 30;
+    int fps = 30;
+    std::string preset = "ultrafast";
+    std::string tune = "zerolatency";
+  };
+
+  H264Encoder();
+  ~H264Encoder();
+
+  /** Open the encoder, width and height must be even. */
+  bool Open(int width, int height, const Options &options);
+  void Close();
+
+  bool IsOpened() const {
+    return encoder_ != nullptr;
+  }
+  int width() const {
+    return width_;
+  }
+  int height() const {
+    return height_;
+  }
+
+  /**
+   * Encode one I420 image, planes are packed without padding.
+   * @param out the access unit, may be empty if the encoder buffered it
+   */
+  bool Encode(
+      const std::uint8_t *i420, std::int64_t pts,
+      std::vector<std::uint8_t> *out, bool *keyframe);
+
+  /** The next encoded frame will be a keyframe. */
+  void ForceKeyframe() {
+    force_keyframe_ = true;
+  }
+
+ private:
+  x264_t *encoder_;
+  int width_;
+  int height_;
+  bool force_keyframe_;
+};
+
+/**
+ * Converts and encodes the latest frame on its own thread.
+ *
+ * Push never blocks, a frame not taken yet is replaced by the newer one.
+ */
+class H264EncodeWorker {
+ public:
+  using publish_t = std::function<void(
+      const std::vector<std::uint8_t> &data, bool keyframe,
+      std::uint64_t stamp)>;
+
+  H264EncodeWorker(const H264Encoder::Options &options, publish_t publish);
+  ~H264EncodeWorker();
+
+  /**
+   * Push the frame to encode without copy, GRAY or BGR.
+   * @param holder keeps the memory of the frame alive, e.g. the raw frame
+   */
+  void Push(
+      const cv::Mat &frame, const std::shared_ptr<void> &holder,
+      std::uint64_t stamp);
+
+  void ForceKeyframe();
+
+  std::size_t encoded_count() const {
+    return encoded_count_;
+  }
+  std::size_t dropped_count() const {
+    return dropped_count_;
+  }
+  /** Total encode time in seconds */
+  double encode_time() const {
+    return encode_time_ns_ * 1e-9;
+  }
+
+ private:
+  void Run();
+  void ToI420(const cv::Mat &frame);
+
+  H264Encoder::Options options_;
+  publish_t publish_;
+  H264Encoder encoder_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool running_;
+  bool pending_;
+  bool force_keyframe_;
+  cv::Mat frame_;
+  std::shared_ptr<void> holder_;
+  std::uint64_t stamp_;
+
+  std::vector<std::uint8_t> i420_;
+
+  // written by the encode thread or Push(), read from any
+  std::atomic<std::size_t> encoded_count_;
+  std::atomic<std::size_t> dropped_count_;
+  std::atomic<std::uint64_t> encode_time_ns_;
+
+  std::thread thread_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_H264_ENCODER_H_
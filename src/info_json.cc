@@ -0,0 +1,129 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "info_json.h"
+
+#define CONFIGURU_IMPLEMENTATION 1
+#include "configuru.hpp"
+using namespace configuru;  // NOLINT
+
+MYNTEYE_BEGIN_NAMESPACE
+
+std::string ToJson(
+    const IntrinsicsPinhole &intri_left, const IntrinsicsPinhole &intri_right) {
+  Config intrinsics{
+    {"calib_model", "pinhole"},
+    {"left", {
+      {"width", intri_left.width},
+      {"height", intri_left.height},
+      {"fx", intri_left.fx},
+      {"fy", intri_left.fy},
+      {"cx", intri_left.cx},
+      {"cy", intri_left.cy},
+      {"model", intri_left.model},
+      {"coeffs", Config::array(
+          {intri_left.coeffs[0],
+           intri_left.coeffs[1],
+           intri_left.coeffs[2],
+           intri_left.coeffs[3],
+           intri_left.coeffs[4]})}
+    }},
+    {"right", {
+      {"width", intri_right.width},
+      {"height", intri_right.height},
+      {"fx", intri_right.fx},
+      {"fy", intri_right.fy},
+      {"cx", intri_right.cx},
+      {"cy", intri_right.cy},
+      {"model", intri_right.model},
+      {"coeffs", Config::array(
+          {intri_right.coeffs[0],
+           intri_right.coeffs[1],
+           intri_right.coeffs[2],
+           intri_right.coeffs[3],
+           intri_right.coeffs[4]})}
+    }}
+  };
+  return dump_string(intrinsics, JSON);
+}
+
+std::string ToJson(
+    const IntrinsicsEquidistant &intri_left,
+    const IntrinsicsEquidistant &intri_right) {
+  Config intrinsics{
+    {"calib_model", "kannala_brandt"},
+    {"left", {
+      {"width", intri_left.width},
+      {"height", intri_left.height},
+      {"coeffs", Config::array(
+          {intri_left.coeffs[0],
+           intri_left.coeffs[1],
+           intri_left.coeffs[2],
+           intri_left.coeffs[3],
+           intri_left.coeffs[4],
+           intri_left.coeffs[5],
+           intri_left.coeffs[6],
+           intri_left.coeffs[7]})
+      }
+    }},
+    {"right", {
+      {"width", intri_right.width},
+      {"height", intri_right.height},
+      {"coeffs", Config::array(
+          {intri_right.coeffs[0],
+           intri_right.coeffs[1],
+           intri_right.coeffs[2],
+           intri_right.coeffs[3],
+           intri_right.coeffs[4],
+           intri_right.coeffs[5],
+           intri_right.coeffs[6],
+           intri_right.coeffs[7]})
+      }
+    }}
+  };
+  return dump_string(intrinsics, JSON);
+}
+
+std::string ToJson(const Extrinsics &extri) {
+  Config extrinsics{
+    {"rotation",     Config::array({extri.rotation[0][0], extri.rotation[0][1], extri.rotation[0][2],   // NOLINT
+                                    extri.rotation[1][0], extri.rotation[1][1], extri.rotation[1][2],   // NOLINT
+                                    extri.rotation[2][0], extri.rotation[2][1], extri.rotation[2][2]})},// NOLINT
+    {"translation",  Config::array({extri.translation[0], extri.translation[1], extri.translation[2]})} // NOLINT
+  };
+  return dump_string(extrinsics, JSON);
+}
+
+std::string ToJson(const MotionIntrinsics &intri) {
+  Config intrinsics {
+    {"accel", {
+      {"scale",     Config::array({ intri.accel.scale[0][0], intri.accel.scale[0][1],  intri.accel.scale[0][2],   // NOLINT
+                                    intri.accel.scale[1][0], intri.accel.scale[1][1],  intri.accel.scale[1][2],   // NOLINT
+                                    intri.accel.scale[2][0], intri.accel.scale[2][1],  intri.accel.scale[2][2]})},// NOLINT
+      {"drift",     Config::array({ intri.accel.drift[0],    intri.accel.drift[1],     intri.accel.drift[2]})}, // NOLINT
+      {"noise",     Config::array({ intri.accel.noise[0],    intri.accel.noise[1],     intri.accel.noise[2]})}, // NOLINT
+      {"bias",      Config::array({ intri.accel.bias[0],     intri.accel.bias[1],      intri.accel.bias[2]})} // NOLINT
+    }},
+    {"gyro", {
+      {"scale",     Config::array({ intri.gyro.scale[0][0], intri.gyro.scale[0][1],  intri.gyro.scale[0][2],   // NOLINT
+                                    intri.gyro.scale[1][0], intri.gyro.scale[1][1],  intri.gyro.scale[1][2],   // NOLINT
+                                    intri.gyro.scale[2][0], intri.gyro.scale[2][1],  intri.gyro.scale[2][2]})},// NOLINT
+      {"drift",     Config::array({ intri.gyro.drift[0],    intri.gyro.drift[1],     intri.gyro.drift[2]})}, // NOLINT
+      {"noise",     Config::array({ intri.gyro.noise[0],    intri.gyro.noise[1],     intri.gyro.noise[2]})}, // NOLINT
+      {"bias",      Config::array({ intri.gyro.bias[0],     intri.gyro.bias[1],      intri.gyro.bias[2]})} // NOLINT
+    }}
+  };
+  return dump_string(intrinsics, JSON);
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,42 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_INFO_JSON_H_
+#define MYNTEYE_WRAPPER_INFO_JSON_H_
+#pragma once
+
+#include <string>
+
+#include "mynteye/mynteye.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * JSON values of the GetInfo service, for the calibration keys.
+ */
+
+/** IMG_INTRINSICS of a pinhole device */
+std::string ToJson(
+    const IntrinsicsPinhole &left, const IntrinsicsPinhole &right);
+/** IMG_INTRINSICS of a kannala brandt device */
+std::string ToJson(
+    const IntrinsicsEquidistant &left, const IntrinsicsEquidistant &right);
+/** IMG_EXTRINSICS_RTOL and IMU_EXTRINSICS */
+std::string ToJson(const Extrinsics &extri);
+/** IMU_INTRINSICS */
+std::string ToJson(const MotionIntrinsics &intri);
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_INFO_JSON_H_
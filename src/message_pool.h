@@ -0,0 +1,129 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_MESSAGE_POOL_H_
+#define MYNTEYE_WRAPPER_MESSAGE_POOL_H_
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Pool of recyclable messages.
+ *
+ * Acquire returns a message whose deleter puts it back to the pool, once
+ * publish and all subscribers have released it. The buffers of a recycled
+ * message keep their capacity, so filling it again does not allocate.
+ */
+template <typename M>
+class MessagePool {
+ public:
+  using Ptr = boost::shared_ptr<M>;
+
+  explicit MessagePool(std::size_t capacity = 4)
+      : state_(std::make_shared<State>()) {
+    state_->capacity = capacity;
+  }
+
+  ~MessagePool() {
+    std::lock_guard<std::mutex> _(state_->mutex);
+    for (auto &&msg : state_->free) {
+      delete msg;
+    }
+    state_->free.clear();
+    state_->closed = true;
+  }
+
+  MYNTEYE_DISABLE_COPY(MessagePool)
+
+  Ptr Acquire() {
+    M *msg = nullptr;
+    {
+      std::lock_guard<std::mutex> _(state_->mutex);
+      if (!state_->free.empty()) {
+        msg = state_->free.back();
+        state_->free.pop_back();
+      }
+    }
+    if (msg == nullptr) {
+      msg = new M();
+      ++state_->allocations;
+    }
+    ++state_->acquisitions;
+    std::shared_ptr<State> state = state_;
+    return Ptr(msg, [state](M *msg) { Recycle(state, msg); });
+  }
+
+  /**
+   * Allocate the messages up to the capacity, each sized by fill, so their
+   * buffers are mapped before the first frame. Not counted as allocations.
+   */
+  template <typename Fill>
+  void Prefill(Fill fill) {
+    std::lock_guard<std::mutex> _(state_->mutex);
+    while (state_->free.size() < state_->capacity) {
+      M *msg = new M();
+      fill(msg);
+      state_->free.push_back(msg);
+    }
+  }
+
+  /** Count an allocation made while filling a message, e.g. buffer growth */
+  void CountAllocation() {
+    ++state_->allocations;
+  }
+
+  /** Messages and buffers allocated */
+  std::uint64_t allocations() const {
+    return state_->allocations;
+  }
+  std::uint64_t acquisitions() const {
+    return state_->acquisitions;
+  }
+
+ private:
+  struct State {
+    std::mutex mutex;
+    std::vector<M *> free;
+    std::size_t capacity = 0;
+    bool closed = false;
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::uint64_t> acquisitions{0};
+  };
+
+  static void Recycle(const std::shared_ptr<State> &state, M *msg) {
+    {
+      std::lock_guard<std::mutex> _(state->mutex);
+      if (!state->closed && state->free.size() < state->capacity) {
+        state->free.push_back(msg);
+        return;
+      }
+    }
+    delete msg;
+  }
+
+  std::shared_ptr<State> state_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_MESSAGE_POOL_H_
@@ -0,0 +1,240 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "metrics_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+// powers of two of the histogram buckets, in 1us
+const int LE_FIRST = 4;
+const int LE_LAST = 26;
+
+// the close is seen within this time
+const int POLL_MS = 200;
+
+std::string Number(double value) {
+  if (std::isinf(value))
+    return value > 0 ? "+Inf" : "-Inf";
+  if (std::isnan(value))
+    return "NaN";
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.15g", value);
+  return buf;
+}
+
+void AppendLabels(std::ostringstream *out, const MetricsText::labels_t &labels,
+    const char *le = nullptr) {
+  if (labels.empty() && le == nullptr)
+    return;
+  *out << '{';
+  bool first = true;
+  for (auto &&label : labels) {
+    *out << (first ? "" : ",") << label.first << "=\"";
+    for (char c : label.second) {
+      if (c == '\\' || c == '"') {
+        *out << '\\' << c;
+      } else if (c == '\n') {
+        *out << "\\n";
+      } else {
+        *out << c;
+      }
+    }
+    *out << '"';
+    first = false;
+  }
+  if (le != nullptr) {
+    *out << (first ? "" : ",") << "le=\"" << le << '"';
+  }
+  *out << '}';
+}
+
+bool SendAll(int fd, const std::string &data) {
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+}  // namespace
+
+void MetricsText::Family(
+    const std::string &name, const std::string &type,
+    const std::string &help) {
+  out_ << "# HELP " << name << ' ' << help << '\n'
+       << "# TYPE " << name << ' ' << type << '\n';
+}
+
+void MetricsText::Sample(
+    const std::string &name, const labels_t &labels, double value) {
+  out_ << name;
+  AppendLabels(&out_, labels);
+  out_ << ' ' << Number(value) << '\n';
+}
+
+void MetricsText::Histogram(
+    const std::string &name, const labels_t &labels,
+    const LatencyHistogram &histogram) {
+  std::uint64_t counts[LatencyHistogram::BUCKETS];
+  std::uint64_t sum = 0;
+  histogram.Totals(counts, &sum);
+  // the buckets below the one of 2^k hold the durations under 2^k
+  std::uint64_t below = 0;
+  int bucket = 0;
+  for (int k = LE_FIRST; k <= LE_LAST; k++) {
+    int end = LatencyHistogram::BucketOf(1ULL << k);
+    for (; bucket < end; bucket++) {
+      below += counts[bucket];
+    }
+    std::string le = Number((1ULL << k) / 1e6);
+    out_ << name << "_bucket";
+    AppendLabels(&out_, labels, le.c_str());
+    out_ << ' ' << below << '\n';
+  }
+  std::uint64_t count = below;
+  for (; bucket < LatencyHistogram::BUCKETS; bucket++) {
+    count += counts[bucket];
+  }
+  out_ << name << "_bucket";
+  AppendLabels(&out_, labels, "+Inf");
+  out_ << ' ' << count << '\n';
+  out_ << name << "_sum";
+  AppendLabels(&out_, labels);
+  out_ << ' ' << Number(sum / 1e6) << '\n';
+  out_ << name << "_count";
+  AppendLabels(&out_, labels);
+  out_ << ' ' << count << '\n';
+}
+
+MetricsServer::MetricsServer() : fd_(-1), running_(false), scrapes_(0) {}
+
+MetricsServer::~MetricsServer() {
+  Close();
+}
+
+bool MetricsServer::Open(std::uint16_t port, render_t render) {
+  Close();
+  fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd_ < 0) {
+    LOG(ERROR) << "Metrics socket failed: " << std::strerror(errno);
+    return false;
+  }
+  int reuse = 1;
+  setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // never off the host
+  auto sock_addr = reinterpret_cast<struct sockaddr *>(&addr);
+  if (bind(fd_, sock_addr, sizeof(addr)) < 0 || listen(fd_, 4) < 0) {
+    LOG(ERROR) << "Metrics listen on 127.0.0.1:" << port
+               << " failed: " << std::strerror(errno);
+    Close();
+    return false;
+  }
+  render_ = render;
+  running_ = true;
+  thread_ = std::thread(&MetricsServer::Run, this);
+  VLOG(2) << "Metrics served on 127.0.0.1:" << port;
+  return true;
+}
+
+void MetricsServer::Close() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+void MetricsServer::Run() {
+  while (running_) {
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    int n = poll(&pfd, 1, POLL_MS);
+    if (n <= 0)
+      continue;  // timeout or signal
+    int fd = accept(fd_, nullptr, nullptr);
+    if (fd < 0)
+      continue;
+    Serve(fd);
+    close(fd);
+  }
+}
+
+void MetricsServer::Serve(int fd) {
+  // a stalled client does not hold the thread
+  struct timeval timeout = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  std::string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+      request.size() < 8192) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    request.append(buf, n);
+  }
+  std::istringstream line(request.substr(0, request.find("\r\n")));
+  std::string method, target;
+  line >> method >> target;
+
+  std::string status = "200 OK", body;
+  if (method != "GET") {
+    status = "405 Method Not Allowed";
+  } else if (target != "/metrics" && target.compare(0, 9, "/metrics?") != 0) {
+    status = "404 Not Found";
+  } else {
+    body = render_();
+    ++scrapes_;
+  }
+  std::ostringstream head;
+  head << "HTTP/1.0 " << status << "\r\n"
+       << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+       << "Content-Length: " << body.size() << "\r\n"
+       << "Connection: close\r\n\r\n";
+  if (SendAll(fd, head.str())) {
+    SendAll(fd, body);
+  }
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,101 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_METRICS_SERVER_H_
+#define MYNTEYE_WRAPPER_METRICS_SERVER_H_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+#include "pipeline_stats.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Metrics in the Prometheus text exposition format, version 0.0.4.
+ */
+class MetricsText {
+ public:
+  using labels_t = std::vector<std::pair<std::string, std::string>>;
+
+  /** Help and type, e.g. counter, once before the samples of the name. */
+  void Family(
+      const std::string &name, const std::string &type,
+      const std::string &help);
+
+  void Sample(
+      const std::string &name, const labels_t &labels, double value);
+
+  /**
+   * Durations of the histogram in seconds, cumulative buckets at the powers
+   * of two from 16us to 67s.
+   */
+  void Histogram(
+      const std::string &name, const labels_t &labels,
+      const LatencyHistogram &histogram);
+
+  std::string str() const {
+    return out_.str();
+  }
+
+ private:
+  std::ostringstream out_;
+};
+
+/**
+ * Serves GET /metrics over http on localhost, from its own thread.
+ *
+ * One scrape is served at a time, the render callback runs on the server
+ * thread and should only read counters, e.g. the atomics of StreamStats.
+ */
+class MetricsServer {
+ public:
+  using render_t = std::function<std::string()>;
+
+  MetricsServer();
+  ~MetricsServer();
+
+  /** Listen on 127.0.0.1:port and start the thread. */
+  bool Open(std::uint16_t port, render_t render);
+  void Close();
+
+  bool IsOpened() const {
+    return fd_ >= 0;
+  }
+
+  std::uint64_t scrapes() const {
+    return scrapes_;
+  }
+
+ private:
+  void Run();
+  void Serve(int fd);
+
+  int fd_;
+  render_t render_;
+  std::atomic<bool> running_;
+  std::atomic<std::uint64_t> scrapes_;
+  std::thread thread_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_METRICS_SERVER_H_
@@ -0,0 +1,221 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pipeline_stats.h"
+
+#include <algorithm>
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+// 4 buckets per power of two
+const int SUB_BITS = 2;
+const int SUB_COUNT = 1 << SUB_BITS;
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram() : sum_(0), max_(0) {
+  for (int i = 0; i < BUCKETS; i++) {
+    buckets_[i] = 0;
+    taken_[i] = 0;
+  }
+}
+
+int LatencyHistogram::BucketOf(std::uint64_t us) {
+  if (us < SUB_COUNT)
+    return static_cast<int>(us);
+  int msb = 63 - __builtin_clzll(us);
+  int sub = static_cast<int>(us >> (msb - SUB_BITS)) & (SUB_COUNT - 1);
+  return std::min((msb - SUB_BITS + 1) * SUB_COUNT + sub, BUCKETS - 1);
+}
+
+double LatencyHistogram::ValueOf(int bucket) {
+  if (bucket < SUB_COUNT)
+    return bucket;
+  int msb = bucket / SUB_COUNT + SUB_BITS - 1;
+  int sub = bucket % SUB_COUNT;
+  double width = static_cast<double>(1ULL << (msb - SUB_BITS));
+  return (SUB_COUNT + sub) * width + width / 2;
+}
+
+LatencyHistogram::Summary LatencyHistogram::TakeSummary() {
+  std::uint64_t counts[BUCKETS];
+  Summary summary;
+  for (int i = 0; i < BUCKETS; i++) {
+    std::uint64_t total = buckets_[i].load(std::memory_order_relaxed);
+    counts[i] = total - taken_[i];
+    taken_[i] = total;
+    summary.count += counts[i];
+  }
+  std::uint64_t max = max_.exchange(0, std::memory_order_relaxed);
+  if (summary.count == 0)
+    return summary;
+
+  const double ranks[] = {0.5, 0.9, 0.99};
+  double *values[] = {&summary.p50, &summary.p90, &summary.p99};
+  std::uint64_t seen = 0;
+  int r = 0;
+  for (int i = 0; i < BUCKETS && r < 3; i++) {
+    seen += counts[i];
+    while (r < 3 && seen >= ranks[r] * summary.count) {
+      // never above the max recorded
+      *values[r++] = std::min(ValueOf(i), static_cast<double>(max)) / 1000;
+    }
+  }
+  summary.max = max / 1000.0;
+  return summary;
+}
+
+void LatencyHistogram::Totals(
+    std::uint64_t counts[BUCKETS], std::uint64_t *sum) const {
+  for (int i = 0; i < BUCKETS; i++) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  *sum = sum_.load(std::memory_order_relaxed);
+}
+
+FrameIdHistory::FrameIdHistory() {
+  for (auto &&id : ids_) {
+    id = 0;
+  }
+}
+
+StreamStats::StreamStats() : frames_(0), bytes_(0), clock_offset_(0) {
+  for (auto &&drops : drops_) {
+    drops = 0;
+  }
+  for (auto &&allocs : allocs_) {
+    allocs.allocations = 0;
+    allocs.allocated_bytes = 0;
+    allocs.copied_bytes = 0;
+  }
+}
+
+void StreamStats::Arrive() {
+  callback_time = clock::now();
+  ++frames_;
+}
+
+void StreamStats::Arrive(
+    std::uint16_t frame_id, const FrameIdHistory *received) {
+  Arrive();
+  std::uint16_t gap = frame_gap_.Next(frame_id);
+  if (gap == 0)
+    return;
+  if (received == nullptr || gap > FrameIdHistory::SIZE) {
+    Drop(LOSS_DEVICE, gap);
+    return;
+  }
+  std::uint64_t sdk = 0;
+  for (std::uint16_t i = 1; i <= gap; i++) {
+    if (received->Contains(frame_id - i)) {
+      ++sdk;
+    }
+  }
+  Drop(LOSS_SDK, sdk);
+  Drop(LOSS_DEVICE, gap - sdk);
+}
+
+std::uint64_t StreamStats::drops() const {
+  std::uint64_t sum = 0;
+  for (auto &&drops : drops_) {
+    sum += drops;
+  }
+  return sum;
+}
+
+void StreamStats::Account(AllocPath path, const AllocCounts &counts) {
+  auto &&allocs = allocs_[path];
+  allocs.allocations += counts.allocations;
+  allocs.allocated_bytes += counts.allocated_bytes;
+  allocs.copied_bytes += counts.copied_bytes;
+}
+
+AllocCounts StreamStats::TakeAllocs(AllocPath path) {
+  auto &&allocs = allocs_[path];
+  AllocCounts counts;
+  counts.allocations = allocs.allocations.exchange(0);
+  counts.allocated_bytes = allocs.allocated_bytes.exchange(0);
+  counts.copied_bytes = allocs.copied_bytes.exchange(0);
+  return counts;
+}
+
+const char *StreamStats::StageName(Stage stage) {
+  switch (stage) {
+    case STAGE_ARRIVAL:
+      return "arrival";
+    case STAGE_QUEUE:
+      return "queue";
+    case STAGE_CONVERT:
+      return "convert";
+    case STAGE_PUBLISH:
+      return "publish";
+    case STAGE_GLASS:
+      return "glass";
+    default:
+      return "unknown";
+  }
+}
+
+const char *StreamStats::LossName(Loss loss) {
+  switch (loss) {
+    case LOSS_DEVICE:
+      return "device";
+    case LOSS_SDK:
+      return "sdk";
+    case LOSS_PUBLISH:
+      return "publish";
+    default:
+      return "unknown";
+  }
+}
+
+const char *StreamStats::AllocPathName(AllocPath path) {
+  switch (path) {
+    case ALLOC_SDK:
+      return "sdk";
+    case ALLOC_PUBLISH:
+      return "publish";
+    default:
+      return "unknown";
+  }
+}
+
+namespace {
+
+// counts of the thread at the end of its last scope, if any
+thread_local AllocCounts scope_end;
+thread_local bool has_scope_end = false;
+
+}  // namespace
+
+AllocScope::AllocScope(StreamStats *stats)
+    : stats_(alloc_stats::Enabled() ? stats : nullptr) {
+  if (stats_ == nullptr)
+    return;
+  begin_ = alloc_stats::ThreadCounts();
+  if (has_scope_end) {
+    stats_->Account(StreamStats::ALLOC_SDK, begin_ - scope_end);
+  }
+}
+
+AllocScope::~AllocScope() {
+  if (stats_ == nullptr)
+    return;
+  scope_end = alloc_stats::ThreadCounts();
+  has_scope_end = true;
+  stats_->Account(StreamStats::ALLOC_PUBLISH, scope_end - begin_);
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,289 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_PIPELINE_STATS_H_
+#define MYNTEYE_WRAPPER_PIPELINE_STATS_H_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "mynteye/mynteye.h"
+#include "alloc_stats.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Histogram of durations in 1us, safe to record from any thread without
+ * locks.
+ *
+ * Buckets are log-linear, 4 per power of two, so a percentile is off by
+ * 12.5% at most. Durations of 2^33us and more fall in the last bucket.
+ */
+class LatencyHistogram {
+ public:
+  static const int BUCKETS = 128;
+
+  struct Summary {
+    std::uint64_t count = 0;
+    /** In 1ms */
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+  };
+
+  LatencyHistogram();
+
+  void Record(std::int64_t us) {
+    std::uint64_t value = us > 0 ? us : 0;
+    buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    std::uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(
+        max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   * Summary of the durations since the last call. Called from one thread
+   * only, e.g. the diagnostics.
+   */
+  Summary TakeSummary();
+
+  /**
+   * Counts of each bucket and sum in 1us since the start, never cleared, so
+   * any thread may read them besides TakeSummary.
+   */
+  void Totals(std::uint64_t counts[BUCKETS], std::uint64_t *sum) const;
+
+  static int BucketOf(std::uint64_t us);
+  /** Middle of the bucket in 1us */
+  static double ValueOf(int bucket);
+
+ private:
+  std::atomic<std::uint64_t> buckets_[BUCKETS];
+  std::atomic<std::uint64_t> sum_;
+  std::atomic<std::uint64_t> max_;
+  // bucket counts at the last summary, of its thread
+  std::uint64_t taken_[BUCKETS];
+};
+
+/**
+ * Ids missed between consecutive ids of a wrapping counter, e.g. the frame
+ * id of the device.
+ */
+template <typename T>
+class SequenceGap {
+ public:
+  SequenceGap() : has_last_(false), last_(0) {}
+
+  /** The ids missed before this one, 0 for a repeat or a step back. */
+  T Next(T id) {
+    T gap = 0;
+    if (has_last_) {
+      T step = static_cast<T>(id - last_);
+      // wraps around, a step back is a restart not a drop
+      if (step != 0 && step <= HALF) {
+        gap = step - 1;
+      }
+    }
+    has_last_ = true;
+    last_ = id;
+    return gap;
+  }
+
+ private:
+  static const T HALF = static_cast<T>(~T(0)) / 2;
+
+  bool has_last_;
+  T last_;
+};
+
+/**
+ * Frame ids recently received by the raw streams, lock free.
+ *
+ * A frame missed by a processed stream, e.g. the disparity, but received
+ * raw was lost in the sdk processing, otherwise the device never delivered
+ * it.
+ */
+class FrameIdHistory {
+ public:
+  /** Ids remembered, 34s at 30fps */
+  static const int SIZE = 1024;
+
+  FrameIdHistory();
+
+  void Add(std::uint16_t frame_id) {
+    ids_[frame_id % SIZE].store(VALID | frame_id, std::memory_order_relaxed);
+  }
+
+  bool Contains(std::uint16_t frame_id) const {
+    return ids_[frame_id % SIZE].load(std::memory_order_relaxed) ==
+        (VALID | frame_id);
+  }
+
+ private:
+  static const std::uint32_t VALID = 0x10000;
+
+  std::atomic<std::uint32_t> ids_[SIZE];
+};
+
+/**
+ * Counters and latencies of one stream, from the callback to the publish.
+ */
+class StreamStats {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  enum Stage {
+    /** Hardware timestamp, as ros time, to the callback */
+    STAGE_ARRIVAL,
+    /** Wait for the conversion lock shared by streams */
+    STAGE_QUEUE,
+    /** Callback to the message filled, queue wait included */
+    STAGE_CONVERT,
+    /** Publish call */
+    STAGE_PUBLISH,
+    /** Mid exposure, as ros time, to the publish returned */
+    STAGE_GLASS,
+    STAGE_LAST
+  };
+
+  /** Where a frame was lost */
+  enum Loss {
+    /** Never delivered to the sdk, e.g. by the usb */
+    LOSS_DEVICE,
+    /** Received by the sdk, lost before the callback */
+    LOSS_SDK,
+    /** Received by the callback, lost before a sink took it */
+    LOSS_PUBLISH,
+    LOSS_LAST
+  };
+
+  /** Where a frame was allocated or copied, on the callback thread */
+  enum AllocPath {
+    /** Since the previous callback on the thread, e.g. the sdk frame */
+    ALLOC_SDK,
+    /** In the callback, conversions, messages and sinks */
+    ALLOC_PUBLISH,
+    ALLOC_LAST
+  };
+
+  StreamStats();
+
+  /**
+   * Count a frame at the callback, a gap in frame ids counts as drops.
+   * Called from the callback thread of the stream only.
+   * @param received the raw frames, the gap is all device drops if null
+   */
+  void Arrive(std::uint16_t frame_id,
+      const FrameIdHistory *received = nullptr);
+  /** Count a sample without frame id. */
+  void Arrive();
+
+  /** Bytes of a frame, as received */
+  void Receive(std::size_t bytes) {
+    bytes_ += bytes;
+  }
+
+  void Drop(Loss loss, std::uint64_t count = 1) {
+    drops_[loss] += count;
+  }
+
+  /** Record the arrival latency, the last one is the clock_offset() */
+  void RecordArrival(std::int64_t us) {
+    clock_offset_.store(us, std::memory_order_relaxed);
+    Record(STAGE_ARRIVAL, us);
+  }
+
+  void Record(Stage stage, std::int64_t us) {
+    latencies_[stage].Record(us);
+  }
+  void Record(Stage stage, const clock::time_point &beg,
+      const clock::time_point &end) {
+    Record(stage, std::chrono::duration_cast<std::chrono::microseconds>(
+        end - beg).count());
+  }
+
+  LatencyHistogram &latency(Stage stage) {
+    return latencies_[stage];
+  }
+
+  std::uint64_t frames() const {
+    return frames_;
+  }
+  std::uint64_t bytes() const {
+    return bytes_;
+  }
+  std::uint64_t drops(Loss loss) const {
+    return drops_[loss];
+  }
+  /**
+   * Host time at the last callback minus the frame stamp, in 1us. The delay
+   * of the transport, its trend is the drift of the device clock.
+   */
+  std::int64_t clock_offset() const {
+    return clock_offset_;
+  }
+  /** Drops of all losses */
+  std::uint64_t drops() const;
+
+  void Account(AllocPath path, const AllocCounts &counts);
+  /** Counts since the last call, which are then cleared. */
+  AllocCounts TakeAllocs(AllocPath path);
+
+  /** Set at the callback, read by the later stages on the same thread */
+  clock::time_point callback_time;
+
+  static const char *StageName(Stage stage);
+  static const char *LossName(Loss loss);
+  static const char *AllocPathName(AllocPath path);
+
+ private:
+  struct AtomicAllocCounts {
+    std::atomic<std::uint64_t> allocations;
+    std::atomic<std::uint64_t> allocated_bytes;
+    std::atomic<std::uint64_t> copied_bytes;
+  };
+
+  LatencyHistogram latencies_[STAGE_LAST];
+  std::atomic<std::uint64_t> frames_;
+  std::atomic<std::uint64_t> bytes_;
+  std::atomic<std::uint64_t> drops_[LOSS_LAST];
+  std::atomic<std::int64_t> clock_offset_;
+  SequenceGap<std::uint16_t> frame_gap_;
+  AtomicAllocCounts allocs_[ALLOC_LAST];
+};
+
+/**
+ * Accounts the allocations and copies of the thread to a stream, the ones
+ * in its scope to the publish path and the ones since the previous scope on
+ * the thread to the sdk path. Does nothing unless alloc_stats is enabled.
+ */
+class AllocScope {
+ public:
+  explicit AllocScope(StreamStats *stats);
+  ~AllocScope();
+
+  MYNTEYE_DISABLE_COPY(AllocScope)
+
+ private:
+  StreamStats *stats_;
+  AllocCounts begin_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_PIPELINE_STATS_H_
@@ -0,0 +1,237 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "playback_device.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+// records probed for the streams and the frame rate
+const std::size_t PROBE_RECORDS = 4096;
+
+// longer gaps are not waited for, e.g. a pause of the recording
+const std::uint64_t MAX_DELAY_US = 1000000;
+
+}  // namespace
+
+PlaybackDevice::PlaybackDevice()
+    : VirtualDevice("playback"),
+      model_(Model::STANDARD2),
+      request_(0, 0, Format::BGR888, 30),
+      played_frames_(0),
+      played_imus_(0) {}
+
+PlaybackDevice::~PlaybackDevice() {
+  Join();
+}
+
+bool PlaybackDevice::Open(const std::string &path, const Options &options) {
+  if (!reader_.Open(path))
+    return false;
+  options_ = options;
+  options_.rate = std::max(options_.rate, 0.0);
+  if (!Probe()) {
+    LOG(ERROR) << "Playback " << path << " has no left frames";
+    reader_.Close();
+    return false;
+  }
+  LOG(INFO) << "Playback " << path << ", " << request_.width << "x"
+            << request_.height << " at " << request_.fps << " fps, rate: "
+            << options_.rate << (options_.loop ? ", loop" : "");
+  return true;
+}
+
+bool PlaybackDevice::Probe() {
+  streams_.clear();
+  bool left_found = false, fps_found = false;
+  std::uint64_t left_timestamp = 0;
+  RecordReader::Record record;
+  reader_.Rewind();
+  for (std::size_t i = 0; i < PROBE_RECORDS && reader_.Next(&record); i++) {
+    auto &&header = *record.header;
+    if (header.type != record::RECORD_IMAGE)
+      continue;
+    Stream stream = static_cast<Stream>(header.stream);
+    streams_.insert(stream);
+    if (stream != Stream::LEFT)
+      continue;
+    if (!left_found) {
+      request_.width = header.width;
+      request_.height = header.height;
+      if (header.format != 0) {
+        request_.format = static_cast<Format>(header.format);
+      } else {
+        request_.format =
+            header.cv_type == CV_8UC1 ? Format::GREY : Format::BGR888;
+      }
+      left_timestamp = header.timestamp;
+      left_found = true;
+    } else if (!fps_found && header.timestamp > left_timestamp) {
+      // from the first two frames, may be off by a dropped frame
+      request_.fps = static_cast<std::uint16_t>(std::max<std::uint64_t>(
+          1, 1000000 / (header.timestamp - left_timestamp)));
+      fps_found = true;
+    }
+  }
+  reader_.Rewind();
+  // grey frames come from the first generation only
+  model_ = request_.format == Format::GREY ? Model::STANDARD
+                                           : Model::STANDARD2;
+  return left_found;
+}
+
+void PlaybackDevice::Run() {
+  const std::uint64_t frame_interval = 1000000 / std::max<int>(
+      request_.fps, 1);
+  const std::uint64_t wrap = std::max<std::uint64_t>(
+      options_.timestamp_wrap, 1);
+  std::uint64_t offset = 0;
+  // largest timestamp paced so far, records of the streams interleave out
+  // of timestamp order
+  std::uint64_t timestamp_high = 0;
+  bool started = false;
+  clock::time_point time_next;
+  do {
+    reader_.Rewind();
+    RecordReader::Record record;
+    bool pass_started = false;
+    while (!IsStopping() && reader_.Next(&record)) {
+      std::uint64_t timestamp = record.header->timestamp;
+      if (options_.rate > 0) {
+        auto now = clock::now();
+        if (!started) {
+          time_next = now;
+          started = true;
+        } else {
+          std::uint64_t delay = 0;
+          if (!pass_started) {
+            delay = frame_interval;  // the pass starts over
+          } else if (timestamp > timestamp_high) {
+            delay = timestamp - timestamp_high;
+          } else if (timestamp_high - timestamp > wrap / 2) {
+            delay = timestamp + wrap - timestamp_high;  // the counter wrapped
+          }
+          delay = std::min(delay, MAX_DELAY_US);
+          time_next += std::chrono::duration_cast<clock::duration>(
+              std::chrono::duration<double, std::micro>(
+                  delay / options_.rate));
+          if (time_next < now - std::chrono::milliseconds(100)) {
+            time_next = now;  // fell behind, do not catch up in a burst
+          }
+          if (!WaitUntil(time_next))
+            break;
+        }
+        if (!pass_started || timestamp > timestamp_high ||
+            timestamp_high - timestamp > wrap / 2) {
+          timestamp_high = timestamp;
+        }
+        pass_started = true;
+      }
+      Play(record, (timestamp + offset) % wrap);
+    }
+    auto &&index = reader_.index();
+    if (!index.empty()) {
+      std::uint64_t first = index.front().first_timestamp;
+      std::uint64_t last = index.back().last_timestamp;
+      // the recording may span a wrap of the counter
+      std::uint64_t duration = last >= first ? last - first
+                                             : last + wrap - first;
+      offset = (offset + duration + frame_interval) % wrap;
+    }
+  } while (options_.loop && !IsStopping());
+  LOG(INFO) << "Playback finished, frames: " << played_frames_
+            << ", imus: " << played_imus_;
+}
+
+void PlaybackDevice::Play(
+    const RecordReader::Record &record, std::uint64_t timestamp) {
+  auto &&header = *record.header;
+  if (header.type == record::RECORD_IMU) {
+    if (header.size < sizeof(record::ImuRecord) || !HasMotionCallback())
+      return;
+    record::ImuRecord sample;
+    std::memcpy(&sample, record.data, sizeof(sample));
+    api::MotionData data;
+    data.imu = std::make_shared<ImuData>();
+    data.imu->frame_id = sample.frame_id;
+    data.imu->flag = sample.flag;
+    data.imu->is_ets = sample.is_ets;
+    data.imu->timestamp = timestamp;
+    for (int i = 0; i < 3; i++) {
+      data.imu->accel[i] = sample.accel[i];
+      data.imu->gyro[i] = sample.gyro[i];
+    }
+    data.imu->temperature = sample.temperature;
+    DispatchMotion(data);
+    ++played_imus_;
+    return;
+  }
+
+  Stream stream = static_cast<Stream>(header.stream);
+  if (header.type != record::RECORD_IMAGE || !HasStreamCallback(stream))
+    return;
+  api::StreamData data;
+  data.img = std::make_shared<ImgData>();
+  data.img->frame_id = header.frame_id;
+  data.img->timestamp = timestamp;
+  data.img->exposure_time = header.exposure_time;
+  data.img->is_ets = header.is_ets;
+  data.frame_id = header.frame_id;
+  int width = header.width, height = header.height;
+  if (header.format != 0) {
+    // rebuild the raw frame, then convert it as the device does
+    auto format = static_cast<Format>(header.format);
+    if (header.size < width * height * bytes_per_pixel(format))
+      return;
+    data.frame_raw =
+        std::make_shared<device::Frame>(width, height, format, record.data);
+    std::uint8_t *raw = data.frame_raw->data();
+    switch (format) {
+      case Format::GREY:
+        data.frame = cv::Mat(height, width, CV_8UC1, raw);
+        break;
+      case Format::YUYV:
+        cv::cvtColor(cv::Mat(height, width, CV_8UC2, raw), data.frame,
+            cv::COLOR_YUV2BGR_YUYV);
+        break;
+      case Format::BGR888:
+        data.frame = cv::Mat(height, width, CV_8UC3, raw);
+        break;
+      case Format::RGB888:
+        cv::cvtColor(cv::Mat(height, width, CV_8UC3, raw), data.frame,
+            cv::COLOR_RGB2BGR);
+        break;
+      default:
+        return;
+    }
+  } else {
+    cv::Mat frame(height, width, header.cv_type,
+        const_cast<std::uint8_t *>(record.data), header.step);
+    if (header.size < frame.step * height)
+      return;
+    data.frame = frame.clone();
+  }
+  DispatchStream(stream, data);
+  ++played_frames_;
+}
+
+MYNTEYE_END_NAMESPACE
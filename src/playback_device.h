@@ -0,0 +1,87 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_PLAYBACK_DEVICE_H_
+#define MYNTEYE_WRAPPER_PLAYBACK_DEVICE_H_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <string>
+
+#include "recorder.h"
+#include "virtual_device.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Replays a native recording, see Recorder, as a virtual device.
+ *
+ * Records are paced by their hardware timestamps, scaled by the rate. Rate 0
+ * replays as fast as the callbacks return, to measure the throughput of the
+ * whole publish pipeline.
+ */
+class PlaybackDevice : public VirtualDevice {
+ public:
+  struct Options {
+    /** Speed relative to real time, 0 for as fast as possible */
+    double rate = 1.0;
+    /** Start over at the end, timestamps keep increasing */
+    bool loop = false;
+    /** Period of the hardware timestamp in 1us, looped ones wrap at it */
+    std::uint64_t timestamp_wrap = 0xffffffffULL * 10;
+  };
+
+  PlaybackDevice();
+  ~PlaybackDevice() override;
+
+  bool Open(const std::string &path, const Options &options);
+
+  Model GetModel() const override {
+    return model_;
+  }
+  StreamRequest GetStreamRequest() const override {
+    return request_;
+  }
+  bool Supports(const Stream &stream) const override {
+    return streams_.find(stream) != streams_.end();
+  }
+
+  std::uint64_t played_frames() const {
+    return played_frames_;
+  }
+  std::uint64_t played_imus() const {
+    return played_imus_;
+  }
+
+ protected:
+  void Run() override;
+
+ private:
+  bool Probe();
+  void Play(const RecordReader::Record &record, std::uint64_t timestamp);
+
+  RecordReader reader_;
+  Options options_;
+  Model model_;
+  StreamRequest request_;
+  std::set<Stream> streams_;
+
+  std::atomic<std::uint64_t> played_frames_;
+  std::atomic<std::uint64_t> played_imus_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_PLAYBACK_DEVICE_H_
@@ -0,0 +1,111 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "process_stats.h"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+/** Name and user plus system ticks of /proc/self/task/<tid>/stat */
+bool ReadThreadStat(int tid, std::string *name, std::uint64_t *ticks) {
+  char path[64];
+  std::snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+  std::FILE *file = std::fopen(path, "r");
+  if (file == nullptr)
+    return false;
+  char line[1024];
+  bool ok = std::fgets(line, sizeof(line), file) != nullptr;
+  std::fclose(file);
+  if (!ok)
+    return false;
+  // the name is in parentheses and may hold spaces and parentheses
+  char *name_beg = std::strchr(line, '(');
+  char *name_end = std::strrchr(line, ')');
+  if (name_beg == nullptr || name_end == nullptr || name_end < name_beg)
+    return false;
+  name->assign(name_beg + 1, name_end);
+  // fields after the name: state(3) ... utime(14) stime(15)
+  unsigned long long utime = 0, stime = 0;  // NOLINT
+  if (std::sscanf(name_end + 2,
+          "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+          &utime, &stime) != 2)
+    return false;
+  *ticks = utime + stime;
+  return true;
+}
+
+}  // namespace
+
+ProcessStats::ProcessStats()
+    : ticks_per_second_(sysconf(_SC_CLK_TCK)), last_time_(clock::now()) {}
+
+bool ProcessStats::Take(Sample *sample) {
+  auto now = clock::now();
+  double elapsed = std::chrono::duration<double>(now - last_time_).count();
+  bool first = last_ticks_.empty();
+  last_time_ = now;
+
+  DIR *dir = opendir("/proc/self/task");
+  if (dir == nullptr)
+    return false;
+  std::map<int, std::uint64_t> ticks;
+  sample->threads.clear();
+  sample->cpu = 0;
+  while (struct dirent *entry = readdir(dir)) {
+    int tid = std::atoi(entry->d_name);
+    if (tid <= 0)
+      continue;
+    Thread thread{tid, "", 0};
+    std::uint64_t thread_ticks = 0;
+    if (!ReadThreadStat(tid, &thread.name, &thread_ticks))
+      continue;  // exited meanwhile
+    ticks[tid] = thread_ticks;
+    auto &&last = last_ticks_.find(tid);
+    if (!first && elapsed > 0) {
+      std::uint64_t begin = last == last_ticks_.end() ? 0 : last->second;
+      thread.cpu = static_cast<double>(thread_ticks - begin) /
+          ticks_per_second_ / elapsed;
+    }
+    sample->cpu += thread.cpu;
+    sample->threads.push_back(thread);
+  }
+  closedir(dir);
+  last_ticks_.swap(ticks);
+  std::sort(sample->threads.begin(), sample->threads.end(),
+      [](const Thread &lhs, const Thread &rhs) {
+        return lhs.cpu > rhs.cpu;
+      });
+
+  // resident pages are the second field
+  sample->rss_bytes = 0;
+  std::FILE *file = std::fopen("/proc/self/statm", "r");
+  if (file != nullptr) {
+    unsigned long size = 0, resident = 0;  // NOLINT
+    if (std::fscanf(file, "%lu %lu", &size, &resident) == 2) {
+      sample->rss_bytes = resident * sysconf(_SC_PAGESIZE);
+    }
+    std::fclose(file);
+  }
+  return true;
+}
+
+MYNTEYE_END_NAMESPACE
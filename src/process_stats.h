@@ -0,0 +1,67 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_PROCESS_STATS_H_
+#define MYNTEYE_WRAPPER_PROCESS_STATS_H_
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * CPU time of each thread and memory of this process, sampled from /proc.
+ */
+class ProcessStats {
+ public:
+  struct Thread {
+    int tid;
+    std::string name;
+    /** Of one core since the previous sample, 1 is saturated */
+    double cpu;
+  };
+
+  struct Sample {
+    /** Sorted by cpu, busiest first */
+    std::vector<Thread> threads;
+    /** Of one core, all threads */
+    double cpu = 0;
+    std::size_t rss_bytes = 0;
+  };
+
+  ProcessStats();
+
+  /**
+   * Usage since the previous call, the first call only starts the period.
+   * @return false if /proc could not be read
+   */
+  bool Take(Sample *sample);
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  long ticks_per_second_;  // NOLINT
+  clock::time_point last_time_;
+  // user and system ticks of each thread at the previous sample
+  std::map<int, std::uint64_t> last_ticks_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_PROCESS_STATS_H_
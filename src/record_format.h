@@ -0,0 +1,144 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_RECORD_FORMAT_H_
+#define MYNTEYE_WRAPPER_RECORD_FORMAT_H_
+#pragma once
+
+#include <cstdint>
+
+#include "mynteye/mynteye.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace record {
+
+/**
+ * File format of the native recording, in host byte order.
+ *
+ * FileHeader, padded to BLOCK_SIZE
+ * chunk 0: ChunkHeader + payload, padded to BLOCK_SIZE
+ * chunk 1: ...
+ * IndexEntry[index_count]
+ * Footer
+ *
+ * The uncompressed chunk payload is a sequence of records, each one a
+ * RecordHeader followed by its data padded to RECORD_ALIGN. The index and
+ * footer are written on close; a file without them is recovered by scanning
+ * the chunk headers.
+ */
+
+const std::uint64_t FILE_MAGIC = 0x31434552544e594dULL;  // "MYNTREC1"
+const std::uint64_t FOOTER_MAGIC = 0x31584449544e594dULL;  // "MYNTIDX1"
+const std::uint32_t CHUNK_MAGIC = 0x4b4e4843;  // "CHNK"
+const std::uint32_t VERSION = 1;
+
+/** Alignment of chunks in the file, allows O_DIRECT writes */
+const std::size_t BLOCK_SIZE = 4096;
+const std::size_t RECORD_ALIGN = 8;
+
+enum Compression : std::uint32_t {
+  COMPRESSION_NONE = 0,
+  COMPRESSION_LZ4 = 1,
+};
+
+enum RecordType : std::uint8_t {
+  RECORD_IMAGE = 0,
+  RECORD_IMU = 1,
+};
+
+struct FileHeader {
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t reserved;
+  /** Wall clock when recording started, in 1ns */
+  std::uint64_t created;
+};
+
+struct ChunkHeader {
+  std::uint32_t magic;
+  /** Compression of the payload */
+  std::uint32_t compression;
+  /** Payload bytes in the file */
+  std::uint64_t stored_size;
+  /** Payload bytes after decompression */
+  std::uint64_t raw_size;
+  std::uint32_t records;
+  std::uint32_t reserved;
+  /** Hardware timestamps of the first and last record, in 1us */
+  std::uint64_t first_timestamp;
+  std::uint64_t last_timestamp;
+};
+
+struct RecordHeader {
+  /** Data bytes, without padding */
+  std::uint32_t size;
+  /** RecordType */
+  std::uint8_t type;
+  /** Stream value for images, 0 for imu */
+  std::uint8_t stream;
+  std::uint16_t frame_id;
+  /** Hardware timestamp in 1us */
+  std::uint64_t timestamp;
+  /** Format of the raw frame, 0 if the data is a cv::Mat of cv_type */
+  std::uint32_t format;
+  std::int32_t cv_type;
+  std::uint16_t width;
+  std::uint16_t height;
+  /** Bytes per row, rows are packed */
+  std::uint32_t step;
+  std::uint16_t exposure_time;
+  std::uint8_t is_ets;
+  std::uint8_t reserved[5];
+};
+
+/** Data of an imu record */
+struct ImuRecord {
+  std::uint32_t frame_id;
+  std::uint8_t flag;
+  std::uint8_t is_ets;
+  std::uint8_t reserved[2];
+  double accel[3];
+  double gyro[3];
+  double temperature;
+};
+
+struct IndexEntry {
+  /** Offset of the ChunkHeader in the file */
+  std::uint64_t offset;
+  std::uint64_t first_timestamp;
+  std::uint64_t last_timestamp;
+  std::uint32_t records;
+  std::uint32_t reserved;
+};
+
+struct Footer {
+  std::uint64_t index_offset;
+  std::uint64_t index_count;
+  std::uint64_t records;
+  std::uint64_t magic;
+};
+
+static_assert(sizeof(FileHeader) <= BLOCK_SIZE, "FileHeader too large");
+static_assert(sizeof(ChunkHeader) % RECORD_ALIGN == 0, "ChunkHeader align");
+static_assert(sizeof(RecordHeader) % RECORD_ALIGN == 0, "RecordHeader align");
+
+inline std::size_t align_up(std::size_t n, std::size_t align) {
+  return (n + align - 1) / align * align;
+}
+
+}  // namespace record
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_RECORD_FORMAT_H_
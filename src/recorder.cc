@@ -0,0 +1,596 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "recorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#ifdef WITH_LZ4
+#include <lz4.h>
+#endif
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+using record::align_up;
+
+Recorder::Recorder()
+    : fd_(-1),
+      offset_(0),
+      running_(false),
+      compress_buffer_(nullptr),
+      compress_capacity_(0),
+      failed_(false),
+      records_(0),
+      dropped_(0),
+      raw_bytes_(0),
+      written_bytes_(0),
+      queued_chunks_(0),
+      write_time_(0) {}
+
+Recorder::~Recorder() {
+  Close();
+}
+
+bool Recorder::Open(const std::string &path, const Options &options) {
+  Close();
+  options_ = options;
+  options_.chunk_count = std::max<std::size_t>(options_.chunk_count, 2);
+#ifndef WITH_LZ4
+  if (options_.lz4) {
+    LOG(WARNING) << "Record built without lz4, chunks are not compressed";
+    options_.lz4 = false;
+  }
+#endif
+
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  if (options_.direct) {
+    fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    if (fd_ < 0 && errno == EINVAL) {
+      LOG(WARNING) << "O_DIRECT not supported for " << path
+                   << ", using buffered writes";
+      options_.direct = false;
+    }
+  }
+  if (fd_ < 0) {
+    fd_ = ::open(path.c_str(), flags, 0644);
+  }
+  if (fd_ < 0) {
+    LOG(ERROR) << "Open record " << path << " failed: " << strerror(errno);
+    return false;
+  }
+
+  std::size_t capacity =
+      align_up(sizeof(record::ChunkHeader) + options_.chunk_size,
+          record::BLOCK_SIZE);
+  for (std::size_t i = 0; i < options_.chunk_count; i++) {
+    Chunk chunk;
+    if (!Allocate(&chunk, capacity)) {
+      Close();
+      return false;
+    }
+    free_.push_back(chunk);
+  }
+  current_ = free_.back();
+  free_.pop_back();
+
+  // the file header fills the first block, so chunks stay aligned
+  Chunk head;
+  if (!Allocate(&head, record::BLOCK_SIZE)) {
+    Close();
+    return false;
+  }
+  std::memset(head.buffer, 0, record::BLOCK_SIZE);
+  auto file_header = reinterpret_cast<record::FileHeader *>(head.buffer);
+  file_header->magic = record::FILE_MAGIC;
+  file_header->version = record::VERSION;
+  file_header->created = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  bool ok = WriteAll(head.buffer, record::BLOCK_SIZE);
+  Free(&head);
+  if (!ok) {
+    Close();
+    return false;
+  }
+  offset_ = record::BLOCK_SIZE;
+
+  failed_ = false;
+  records_ = 0;
+  dropped_ = 0;
+  raw_bytes_ = 0;
+  written_bytes_ = 0;
+  queued_chunks_ = 0;
+  write_time_ = 0;
+  running_ = true;
+  thread_ = std::thread(&Recorder::Run, this);
+  return true;
+}
+
+void Recorder::Close() {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (current_.records > 0) {
+      full_.push_back(current_);
+      queued_chunks_ = full_.size();
+      current_ = Chunk();
+    }
+    running_ = false;
+  }
+  cond_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  if (fd_ >= 0 && offset_ > 0 && !failed_) {
+    // index and footer are not block sized, leave direct mode for them
+    int flags = fcntl(fd_, F_GETFL);
+    if (flags >= 0 && (flags & O_DIRECT)) {
+      fcntl(fd_, F_SETFL, flags & ~O_DIRECT);
+    }
+    record::Footer footer;
+    footer.index_offset = offset_;
+    footer.index_count = index_.size();
+    footer.records = records_;
+    footer.magic = record::FOOTER_MAGIC;
+    if (!WriteAll(reinterpret_cast<const std::uint8_t *>(index_.data()),
+            index_.size() * sizeof(record::IndexEntry)) ||
+        !WriteAll(reinterpret_cast<const std::uint8_t *>(&footer),
+            sizeof(footer))) {
+      LOG(ERROR) << "Write record index failed";
+    }
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+  Free(&current_);
+  for (auto &&chunk : free_) {
+    Free(&chunk);
+  }
+  free_.clear();
+  for (auto &&chunk : full_) {
+    Free(&chunk);
+  }
+  full_.clear();
+  std::free(compress_buffer_);
+  compress_buffer_ = nullptr;
+  compress_capacity_ = 0;
+  index_.clear();
+  offset_ = 0;
+}
+
+bool Recorder::WriteImage(
+    const record::RecordHeader &header, const std::uint8_t *data,
+    std::size_t row_bytes, std::size_t rows, std::size_t step) {
+  record::RecordHeader head = header;
+  head.type = record::RECORD_IMAGE;
+  head.size = row_bytes * rows;
+  head.step = row_bytes;
+
+  std::lock_guard<std::mutex> _(mutex_);
+  std::uint8_t *dst = Append(head, head.timestamp);
+  if (dst == nullptr)
+    return false;
+  if (step == row_bytes) {
+    std::memcpy(dst, data, head.size);
+  } else {
+    for (std::size_t i = 0; i < rows; i++) {
+      std::memcpy(dst + i * row_bytes, data + i * step, row_bytes);
+    }
+  }
+  return true;
+}
+
+bool Recorder::WriteImu(
+    std::uint64_t timestamp, const record::ImuRecord &imu) {
+  record::RecordHeader head{};
+  head.type = record::RECORD_IMU;
+  head.size = sizeof(imu);
+  head.frame_id = static_cast<std::uint16_t>(imu.frame_id);
+  head.timestamp = timestamp;
+  head.is_ets = imu.is_ets;
+
+  std::lock_guard<std::mutex> _(mutex_);
+  std::uint8_t *dst = Append(head, timestamp);
+  if (dst == nullptr)
+    return false;
+  std::memcpy(dst, &imu, sizeof(imu));
+  return true;
+}
+
+std::uint8_t *Recorder::Append(
+    const record::RecordHeader &header, std::uint64_t timestamp) {
+  if (fd_ < 0)
+    return nullptr;
+  std::size_t bytes =
+      sizeof(header) + align_up(header.size, record::RECORD_ALIGN);
+  if (!Reserve(bytes)) {
+    ++dropped_;
+    return nullptr;
+  }
+  std::uint8_t *dst =
+      current_.buffer + sizeof(record::ChunkHeader) + current_.size;
+  std::memcpy(dst, &header, sizeof(header));
+  // zero the padding, it is compressed and written
+  std::memset(dst + sizeof(header) + header.size, 0,
+      bytes - sizeof(header) - header.size);
+  if (current_.records == 0) {
+    current_.first_timestamp = timestamp;
+  }
+  current_.last_timestamp = timestamp;
+  current_.size += bytes;
+  ++current_.records;
+  ++records_;
+  raw_bytes_ += bytes;
+  return dst + sizeof(header);
+}
+
+bool Recorder::Reserve(std::size_t bytes) {
+  std::size_t need = sizeof(record::ChunkHeader) + bytes;
+  if (current_.buffer && current_.size + need <= current_.capacity) {
+    return true;
+  }
+  if (current_.records > 0) {
+    Submit();
+  }
+  if (current_.buffer == nullptr) {
+    if (free_.empty())
+      return false;  // the disk falls behind
+    current_ = free_.back();
+    free_.pop_back();
+  }
+  if (need > current_.capacity) {
+    // larger than a chunk, grow this buffer
+    Free(&current_);
+    if (!Allocate(&current_, align_up(need, record::BLOCK_SIZE)))
+      return false;
+  }
+  return true;
+}
+
+void Recorder::Submit() {
+  full_.push_back(current_);
+  queued_chunks_ = full_.size();
+  current_ = Chunk();
+  if (!free_.empty()) {
+    current_ = free_.back();
+    free_.pop_back();
+  }
+  cond_.notify_one();
+}
+
+void Recorder::Run() {
+  while (true) {
+    Chunk chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return !running_ || !full_.empty(); });
+      if (full_.empty())
+        break;  // stopped and drained
+      chunk = full_.front();
+      full_.pop_front();
+      queued_chunks_ = full_.size();
+    }
+    if (!failed_ && !WriteChunk(&chunk)) {
+      failed_ = true;
+      LOG(ERROR) << "Write record failed, recording stopped: "
+                 << strerror(errno);
+    }
+    if (failed_) {
+      records_ -= chunk.records;
+      dropped_ += chunk.records;
+    }
+    chunk.size = 0;
+    chunk.records = 0;
+    {
+      std::lock_guard<std::mutex> _(mutex_);
+      if (current_.buffer == nullptr) {
+        current_ = chunk;
+      } else {
+        free_.push_back(chunk);
+      }
+    }
+  }
+}
+
+bool Recorder::WriteChunk(Chunk *chunk) {
+  auto time_beg = std::chrono::steady_clock::now();
+  const std::size_t head_n = sizeof(record::ChunkHeader);
+
+  record::ChunkHeader header{};
+  header.magic = record::CHUNK_MAGIC;
+  header.compression = record::COMPRESSION_NONE;
+  header.stored_size = chunk->size;
+  header.raw_size = chunk->size;
+  header.records = chunk->records;
+  header.first_timestamp = chunk->first_timestamp;
+  header.last_timestamp = chunk->last_timestamp;
+
+  std::uint8_t *out = chunk->buffer;
+#ifdef WITH_LZ4
+  if (options_.lz4) {
+    int bound = LZ4_compressBound(static_cast<int>(chunk->size));
+    std::size_t capacity =
+        align_up(head_n + bound, record::BLOCK_SIZE);
+    if (compress_capacity_ < capacity) {
+      std::free(compress_buffer_);
+      compress_buffer_ = nullptr;
+      compress_capacity_ = 0;
+      if (posix_memalign(reinterpret_cast<void **>(&compress_buffer_),
+              record::BLOCK_SIZE, capacity) == 0) {
+        compress_capacity_ = capacity;
+      }
+    }
+    if (compress_buffer_) {
+      int n = LZ4_compress_default(
+          reinterpret_cast<const char *>(chunk->buffer + head_n),
+          reinterpret_cast<char *>(compress_buffer_ + head_n),
+          static_cast<int>(chunk->size), bound);
+      // keep it raw if it does not shrink, e.g. noisy images
+      if (n > 0 && static_cast<std::size_t>(n) < chunk->size) {
+        header.compression = record::COMPRESSION_LZ4;
+        header.stored_size = n;
+        out = compress_buffer_;
+      }
+    }
+  }
+#endif
+
+  std::memcpy(out, &header, head_n);
+  std::size_t used = head_n + header.stored_size;
+  std::size_t n = align_up(used, record::BLOCK_SIZE);
+  std::memset(out + used, 0, n - used);
+  if (!WriteAll(out, n))
+    return false;
+
+  record::IndexEntry entry{};
+  entry.offset = offset_;
+  entry.first_timestamp = header.first_timestamp;
+  entry.last_timestamp = header.last_timestamp;
+  entry.records = header.records;
+  index_.push_back(entry);
+  offset_ += n;
+
+  write_time_ += std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - time_beg).count();
+  return true;
+}
+
+bool Recorder::WriteAll(const std::uint8_t *data, std::size_t n) {
+  while (n > 0) {
+    ssize_t ret = ::write(fd_, data, n);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += ret;
+    n -= ret;
+    written_bytes_ += ret;
+  }
+  return true;
+}
+
+bool Recorder::Allocate(Chunk *chunk, std::size_t capacity) {
+  // O_DIRECT needs block aligned memory
+  void *buffer = nullptr;
+  if (posix_memalign(&buffer, record::BLOCK_SIZE, capacity) != 0) {
+    LOG(ERROR) << "Allocate record chunk of " << capacity << " failed";
+    return false;
+  }
+  *chunk = Chunk();
+  chunk->buffer = static_cast<std::uint8_t *>(buffer);
+  chunk->capacity = capacity;
+  return true;
+}
+
+void Recorder::Free(Chunk *chunk) {
+  std::free(chunk->buffer);
+  *chunk = Chunk();
+}
+
+RecordReader::RecordReader()
+    : map_(nullptr),
+      map_size_(0),
+      recovered_(false),
+      chunk_(0),
+      payload_(nullptr),
+      payload_size_(0),
+      payload_offset_(0) {}
+
+RecordReader::~RecordReader() {
+  Close();
+}
+
+bool RecordReader::Open(const std::string &path) {
+  Close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Open record " << path << " failed: " << strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<std::size_t>(st.st_size) < record::BLOCK_SIZE) {
+    LOG(ERROR) << "Record " << path << " is too small";
+    ::close(fd);
+    return false;
+  }
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    LOG(ERROR) << "Map record " << path << " failed: " << strerror(errno);
+    return false;
+  }
+  map_ = static_cast<std::uint8_t *>(map);
+  map_size_ = st.st_size;
+  madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+  auto file_header = reinterpret_cast<const record::FileHeader *>(map_);
+  if (file_header->magic != record::FILE_MAGIC ||
+      file_header->version != record::VERSION) {
+    LOG(ERROR) << "Record " << path << " has unknown format";
+    Close();
+    return false;
+  }
+  if (!BuildIndex()) {
+    LOG(ERROR) << "Record " << path << " has no valid chunk";
+    Close();
+    return false;
+  }
+  if (recovered_) {
+    LOG(WARNING) << "Record " << path << " was not closed, recovered "
+                 << index_.size() << " chunks";
+  }
+  Rewind();
+  return true;
+}
+
+void RecordReader::Close() {
+  if (map_) {
+    munmap(map_, map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+  }
+  index_.clear();
+  recovered_ = false;
+  Rewind();
+}
+
+bool RecordReader::BuildIndex() {
+  index_.clear();
+  recovered_ = false;
+  if (map_size_ >= record::BLOCK_SIZE + sizeof(record::Footer)) {
+    record::Footer footer;
+    std::memcpy(&footer, map_ + map_size_ - sizeof(footer), sizeof(footer));
+    std::size_t index_n = footer.index_count * sizeof(record::IndexEntry);
+    if (footer.magic == record::FOOTER_MAGIC &&
+        footer.index_offset + index_n + sizeof(footer) == map_size_) {
+      index_.resize(footer.index_count);
+      std::memcpy(index_.data(), map_ + footer.index_offset, index_n);
+      return true;
+    }
+  }
+
+  // no footer, scan the chunks
+  recovered_ = true;
+  std::size_t offset = record::BLOCK_SIZE;
+  while (offset + sizeof(record::ChunkHeader) <= map_size_) {
+    auto header = reinterpret_cast<const record::ChunkHeader *>(map_ + offset);
+    std::size_t n = sizeof(record::ChunkHeader) + header->stored_size;
+    if (header->magic != record::CHUNK_MAGIC || offset + n > map_size_)
+      break;
+    record::IndexEntry entry{};
+    entry.offset = offset;
+    entry.first_timestamp = header->first_timestamp;
+    entry.last_timestamp = header->last_timestamp;
+    entry.records = header->records;
+    index_.push_back(entry);
+    offset += align_up(n, record::BLOCK_SIZE);
+  }
+  return !index_.empty();
+}
+
+void RecordReader::Rewind() {
+  chunk_ = 0;
+  payload_ = nullptr;
+  payload_size_ = 0;
+  payload_offset_ = 0;
+}
+
+bool RecordReader::Seek(std::uint64_t timestamp) {
+  for (std::size_t i = 0; i < index_.size(); i++) {
+    if (index_[i].last_timestamp >= timestamp) {
+      Rewind();
+      chunk_ = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RecordReader::Next(Record *record) {
+  while (payload_offset_ + sizeof(record::RecordHeader) > payload_size_) {
+    if (chunk_ >= index_.size())
+      return false;
+    if (!LoadChunk(chunk_++)) {
+      payload_size_ = 0;  // skip the broken chunk
+      payload_offset_ = 0;
+    }
+  }
+  auto header = reinterpret_cast<const record::RecordHeader *>(
+      payload_ + payload_offset_);
+  std::size_t n = sizeof(*header) + align_up(header->size,
+      record::RECORD_ALIGN);
+  if (payload_offset_ + n > payload_size_) {
+    LOG(WARNING) << "Record chunk " << (chunk_ - 1) << " is truncated";
+    payload_offset_ = payload_size_;
+    return Next(record);
+  }
+  record->header = header;
+  record->data = payload_ + payload_offset_ + sizeof(*header);
+  payload_offset_ += n;
+  return true;
+}
+
+bool RecordReader::LoadChunk(std::size_t i) {
+  const std::size_t offset = index_[i].offset;
+  if (offset + sizeof(record::ChunkHeader) > map_size_)
+    return false;
+  auto header = reinterpret_cast<const record::ChunkHeader *>(map_ + offset);
+  const std::uint8_t *stored = map_ + offset + sizeof(record::ChunkHeader);
+  if (header->magic != record::CHUNK_MAGIC ||
+      offset + sizeof(record::ChunkHeader) + header->stored_size > map_size_)
+    return false;
+
+  payload_offset_ = 0;
+  if (header->compression == record::COMPRESSION_NONE) {
+    payload_ = stored;
+    payload_size_ = header->stored_size;
+    return true;
+  }
+#ifdef WITH_LZ4
+  if (header->compression == record::COMPRESSION_LZ4) {
+    decompressed_.resize(header->raw_size);
+    int n = LZ4_decompress_safe(
+        reinterpret_cast<const char *>(stored),
+        reinterpret_cast<char *>(decompressed_.data()),
+        static_cast<int>(header->stored_size),
+        static_cast<int>(header->raw_size));
+    if (n < 0 || static_cast<std::size_t>(n) != header->raw_size) {
+      LOG(WARNING) << "Decompress record chunk " << i << " failed";
+      return false;
+    }
+    payload_ = decompressed_.data();
+    payload_size_ = header->raw_size;
+    return true;
+  }
+#endif
+  LOG(WARNING) << "Record chunk " << i << " has unsupported compression "
+               << header->compression;
+  return false;
+}
+
+MYNTEYE_END_NAMESPACE
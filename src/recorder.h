@@ -0,0 +1,205 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_RECORDER_H_
+#define MYNTEYE_WRAPPER_RECORDER_H_
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "record_format.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Records images and imu samples to the native chunked log, see
+ * record_format.h.
+ *
+ * Writes copy the data once into the current chunk buffer. Full chunks are
+ * compressed and written on a background thread with large sequential
+ * writes, so writes never block on the disk. If all chunk buffers are
+ * waiting for the disk, records are dropped and counted.
+ */
+class Recorder {
+ public:
+  struct Options {
+    /** Bytes of one chunk buffer, a larger record gets its own chunk */
+    std::size_t chunk_size = 16 << 20;
+    /** Chunk buffers, the backlog the disk may fall behind */
+    std::size_t chunk_count = 8;
+    /** Compress chunks with lz4, ignored if built without it */
+    bool lz4 = false;
+    /** Bypass the page cache with O_DIRECT */
+    bool direct = false;
+  };
+
+  Recorder();
+  ~Recorder();
+
+  bool Open(const std::string &path, const Options &options);
+  /** Flush all chunks, then write the index. */
+  void Close();
+
+  bool IsOpened() const {
+    return fd_ >= 0;
+  }
+
+  /**
+   * Record one image, rows may be padded by step.
+   * @param header the image fields, size and step are filled here
+   */
+  bool WriteImage(
+      const record::RecordHeader &header, const std::uint8_t *data,
+      std::size_t row_bytes, std::size_t rows, std::size_t step);
+
+  bool WriteImu(std::uint64_t timestamp, const record::ImuRecord &imu);
+
+  std::uint64_t records() const {
+    return records_;
+  }
+  std::uint64_t dropped() const {
+    return dropped_;
+  }
+  /** Record bytes before compression */
+  std::uint64_t raw_bytes() const {
+    return raw_bytes_;
+  }
+  /** Bytes written to the file */
+  std::uint64_t written_bytes() const {
+    return written_bytes_;
+  }
+  /** A write to the disk failed, the records since are dropped */
+  bool failed() const {
+    return failed_;
+  }
+  /** Full chunks waiting for the disk */
+  std::size_t queued_chunks() const {
+    return queued_chunks_;
+  }
+  /** Total time spent in write calls, in seconds */
+  double write_time() const {
+    return write_time_;
+  }
+
+ private:
+  struct Chunk {
+    std::uint8_t *buffer = nullptr;
+    std::size_t capacity = 0;
+    /** Bytes used after the ChunkHeader */
+    std::size_t size = 0;
+    std::uint32_t records = 0;
+    std::uint64_t first_timestamp = 0;
+    std::uint64_t last_timestamp = 0;
+  };
+
+  bool Reserve(std::size_t bytes);
+  std::uint8_t *Append(
+      const record::RecordHeader &header, std::uint64_t timestamp);
+  void Submit();
+  void Run();
+  bool WriteChunk(Chunk *chunk);
+  bool WriteAll(const std::uint8_t *data, std::size_t n);
+
+  static bool Allocate(Chunk *chunk, std::size_t capacity);
+  static void Free(Chunk *chunk);
+
+  int fd_;
+  Options options_;
+  std::uint64_t offset_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool running_;
+  Chunk current_;
+  std::vector<Chunk> free_;
+  std::deque<Chunk> full_;
+
+  // writer thread only
+  std::vector<record::IndexEntry> index_;
+  std::uint8_t *compress_buffer_;
+  std::size_t compress_capacity_;
+
+  std::atomic<bool> failed_;
+  std::atomic<std::uint64_t> records_;
+  std::atomic<std::uint64_t> dropped_;
+  std::atomic<std::uint64_t> raw_bytes_;
+  std::atomic<std::uint64_t> written_bytes_;
+  std::atomic<std::size_t> queued_chunks_;
+  double write_time_;
+
+  std::thread thread_;
+};
+
+/**
+ * Reads the native log, the file is memory mapped.
+ */
+class RecordReader {
+ public:
+  struct Record {
+    const record::RecordHeader *header;
+    /** Valid until the next chunk is read */
+    const std::uint8_t *data;
+  };
+
+  RecordReader();
+  ~RecordReader();
+
+  bool Open(const std::string &path);
+  void Close();
+
+  bool IsOpened() const {
+    return map_ != nullptr;
+  }
+
+  /** Chunks in file order, from the index or recovered by a scan */
+  const std::vector<record::IndexEntry> &index() const {
+    return index_;
+  }
+  /** True if the index was missing, e.g. the recording was not closed */
+  bool recovered() const {
+    return recovered_;
+  }
+
+  /** Go back to the first record. */
+  void Rewind();
+  /** Go to the first chunk ending at or after the timestamp. */
+  bool Seek(std::uint64_t timestamp);
+  /** Read the next record, false at the end. */
+  bool Next(Record *record);
+
+ private:
+  bool BuildIndex();
+  bool LoadChunk(std::size_t i);
+
+  std::uint8_t *map_;
+  std::size_t map_size_;
+  std::vector<record::IndexEntry> index_;
+  bool recovered_;
+
+  std::size_t chunk_;
+  const std::uint8_t *payload_;
+  std::size_t payload_size_;
+  std::size_t payload_offset_;
+  std::vector<std::uint8_t> decompressed_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_RECORDER_H_
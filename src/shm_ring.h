@@ -0,0 +1,412 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_SHM_RING_H_
+#define MYNTEYE_WRAPPER_SHM_RING_H_
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+/**
+ * Shared memory ring of fixed slots, one writer and any number of readers.
+ *
+ * Header only, readers need nothing but this file (link -lrt on old glibc).
+ * Every slot is guarded by a seqlock: odd while being written. Readers never
+ * block the writer, they get a view into the slot and check it is still
+ * valid after using it.
+ *
+ * Usage of reader:
+ *
+ *   mynteye::shm::RingReader reader;
+ *   reader.Open("/mynteye_left");
+ *   std::uint64_t seq = reader.LatestSeq();
+ *   mynteye::shm::RingReader::View view;
+ *   if (reader.Get(seq, &view)) {
+ *     // use view.meta and view.data ...
+ *     if (!reader.IsValid(view)) {
+ *       // overwritten meanwhile, discard
+ *     }
+ *   }
+ */
+
+namespace mynteye {
+namespace shm {
+
+const std::uint32_t MAGIC = 0x474e5252;  // "RRNG"
+const std::uint32_t VERSION = 1;
+const std::size_t ALIGN = 64;
+
+enum SlotType : std::uint8_t {
+  SLOT_IMAGE = 0,
+  SLOT_IMU = 1,
+};
+
+struct SlotMeta {
+  /** Sequence of the message in this slot */
+  std::uint64_t seq;
+  /** Hardware timestamp in 1us */
+  std::uint64_t timestamp;
+  /** Payload size in bytes */
+  std::uint32_t size;
+  /** SlotType */
+  std::uint8_t type;
+  /** Stream value of images */
+  std::uint8_t stream;
+  std::uint16_t frame_id;
+  std::uint16_t width;
+  std::uint16_t height;
+  /** OpenCV type, e.g. CV_8UC3 */
+  std::uint16_t cv_type;
+  std::uint16_t reserved;
+  /** Bytes per row, rows are packed */
+  std::uint32_t step;
+};
+
+struct ImuSample {
+  std::uint32_t frame_id;
+  std::uint8_t flag;
+  std::uint8_t reserved[3];
+  double accel[3];
+  double gyro[3];
+  double temperature;
+};
+
+struct alignas(ALIGN) RingHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t slot_count;
+  std::uint32_t slot_size;
+  /** Set when the writer recreates or removes the ring, reopen it */
+  std::atomic<std::uint32_t> closed;
+  /** Sequence of the next message to write */
+  alignas(ALIGN) std::atomic<std::uint64_t> write_seq;
+};
+
+struct alignas(ALIGN) SlotHeader {
+  std::atomic<std::uint64_t> lock;
+  SlotMeta meta;
+};
+
+static_assert(
+    sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t),
+    "atomic must be plain in shared memory");
+
+inline std::size_t slot_stride(std::size_t slot_size) {
+  std::size_t n = sizeof(SlotHeader) + slot_size;
+  return (n + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+inline std::size_t ring_bytes(std::size_t slot_count, std::size_t slot_size) {
+  return sizeof(RingHeader) + slot_count * slot_stride(slot_size);
+}
+
+/**
+ * Creates the ring and writes messages into it.
+ */
+class RingWriter {
+ public:
+  RingWriter() : header_(nullptr), bytes_(0) {}
+  ~RingWriter() {
+    Close();
+  }
+
+  RingWriter(const RingWriter &) = delete;
+  RingWriter &operator=(const RingWriter &) = delete;
+
+  /**
+   * Create the ring, replaces an existing one of the same name.
+   * @param name e.g. /mynteye_left
+   */
+  bool Create(
+      const std::string &name, std::size_t slot_count, std::size_t slot_size) {
+    Close();
+    if (slot_count == 0 || slot_size == 0)
+      return false;
+    MarkClosed(name);
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+      return false;
+    std::size_t bytes = ring_bytes(slot_count, slot_size);
+    if (ftruncate(fd, bytes) < 0) {
+      close(fd);
+      shm_unlink(name.c_str());
+      return false;
+    }
+    void *addr =
+        mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      shm_unlink(name.c_str());
+      return false;
+    }
+    // page in now, not on the first frames
+    std::memset(addr, 0, bytes);
+
+    header_ = new (addr) RingHeader();
+    header_->slot_count = static_cast<std::uint32_t>(slot_count);
+    header_->slot_size = static_cast<std::uint32_t>(slot_size);
+    header_->closed.store(0, std::memory_order_relaxed);
+    header_->write_seq.store(0, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < slot_count; i++) {
+      new (slot(i)) SlotHeader();
+      slot(i)->lock.store(0, std::memory_order_relaxed);
+    }
+    header_->version = VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = MAGIC;
+
+    name_ = name;
+    bytes_ = bytes;
+    return true;
+  }
+
+  /** Remove the ring, readers see it closed. */
+  void Close() {
+    if (header_ == nullptr)
+      return;
+    header_->closed.store(1, std::memory_order_release);
+    munmap(header_, bytes_);
+    shm_unlink(name_.c_str());
+    header_ = nullptr;
+    bytes_ = 0;
+  }
+
+  bool IsOpened() const {
+    return header_ != nullptr;
+  }
+  std::size_t slot_size() const {
+    return header_ ? header_->slot_size : 0;
+  }
+
+  /**
+   * Write one message, rows may be padded by step.
+   * @return false if it does not fit the slot
+   */
+  bool Write(
+      const SlotMeta &meta, const std::uint8_t *data, std::size_t row_bytes,
+      std::size_t rows, std::size_t step) {
+    if (header_ == nullptr || row_bytes * rows > header_->slot_size)
+      return false;
+    std::uint64_t seq = header_->write_seq.load(std::memory_order_relaxed);
+    SlotHeader *s = slot(seq % header_->slot_count);
+
+    std::uint64_t lock = s->lock.load(std::memory_order_relaxed);
+    s->lock.store(lock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s->meta = meta;
+    s->meta.seq = seq;
+    s->meta.size = static_cast<std::uint32_t>(row_bytes * rows);
+    s->meta.step = static_cast<std::uint32_t>(row_bytes);
+    std::uint8_t *dst = payload(s);
+    if (step == row_bytes) {
+      std::memcpy(dst, data, row_bytes * rows);
+    } else {
+      for (std::size_t y = 0; y < rows; y++) {
+        std::memcpy(dst + y * row_bytes, data + y * step, row_bytes);
+      }
+    }
+
+    s->lock.store(lock + 2, std::memory_order_release);
+    header_->write_seq.store(seq + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  static void MarkClosed(const std::string &name) {
+    // tell readers of a stale ring with the same name
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 &&
+        static_cast<std::size_t>(st.st_size) >= sizeof(RingHeader)) {
+      void *addr =
+          mmap(nullptr, sizeof(RingHeader), PROT_READ | PROT_WRITE,
+              MAP_SHARED, fd, 0);
+      if (addr != MAP_FAILED) {
+        static_cast<RingHeader *>(addr)->closed.store(
+            1, std::memory_order_release);
+        munmap(addr, sizeof(RingHeader));
+      }
+    }
+    close(fd);
+  }
+
+  SlotHeader *slot(std::size_t i) const {
+    return reinterpret_cast<SlotHeader *>(
+        reinterpret_cast<std::uint8_t *>(header_) + sizeof(RingHeader) +
+        i * slot_stride(header_->slot_size));
+  }
+
+  static std::uint8_t *payload(SlotHeader *s) {
+    return reinterpret_cast<std::uint8_t *>(s) + sizeof(SlotHeader);
+  }
+
+  std::string name_;
+  RingHeader *header_;
+  std::size_t bytes_;
+};
+
+/**
+ * Maps the ring read only, lock free and without copy.
+ */
+class RingReader {
+ public:
+  struct View {
+    SlotMeta meta;
+    const std::uint8_t *data = nullptr;
+    const SlotHeader *slot = nullptr;
+    std::uint64_t lock = 0;
+  };
+
+  RingReader() : header_(nullptr), bytes_(0) {}
+  ~RingReader() {
+    Close();
+  }
+
+  RingReader(const RingReader &) = delete;
+  RingReader &operator=(const RingReader &) = delete;
+
+  bool Open(const std::string &name) {
+    Close();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(RingHeader)) {
+      close(fd);
+      return false;
+    }
+    std::size_t bytes = st.st_size;
+    void *addr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+      return false;
+    const RingHeader *header = static_cast<const RingHeader *>(addr);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->magic != MAGIC || header->version != VERSION ||
+        ring_bytes(header->slot_count, header->slot_size) > bytes) {
+      munmap(addr, bytes);
+      return false;
+    }
+    header_ = header;
+    bytes_ = bytes;
+    return true;
+  }
+
+  void Close() {
+    if (header_ == nullptr)
+      return;
+    munmap(const_cast<RingHeader *>(header_), bytes_);
+    header_ = nullptr;
+    bytes_ = 0;
+  }
+
+  bool IsOpened() const {
+    return header_ != nullptr;
+  }
+
+  /** The writer has gone or recreated the ring, Open it again. */
+  bool IsClosed() const {
+    return header_ == nullptr ||
+           header_->closed.load(std::memory_order_acquire) != 0;
+  }
+
+  /** Sequence of the next message to write. */
+  std::uint64_t WriteSeq() const {
+    return header_ ? header_->write_seq.load(std::memory_order_acquire) : 0;
+  }
+
+  /** Sequence of the newest message, check Get() succeeds. */
+  std::uint64_t LatestSeq() const {
+    std::uint64_t seq = WriteSeq();
+    return seq > 0 ? seq - 1 : 0;
+  }
+
+  /** Oldest sequence that may still be in the ring, 0 if not opened. */
+  std::uint64_t OldestSeq() const {
+    if (header_ == nullptr)
+      return 0;
+    std::uint64_t seq = WriteSeq();
+    return seq > header_->slot_count ? seq - header_->slot_count : 0;
+  }
+
+  /**
+   * Get a view of the message, false if not written yet, being written or
+   * already overwritten.
+   */
+  bool Get(std::uint64_t seq, View *view) const {
+    if (header_ == nullptr || seq >= WriteSeq())
+      return false;
+    const SlotHeader *s = slot(seq % header_->slot_count);
+    std::uint64_t lock = s->lock.load(std::memory_order_acquire);
+    if (lock & 1)
+      return false;
+    view->meta = s->meta;
+    view->data =
+        reinterpret_cast<const std::uint8_t *>(s) + sizeof(SlotHeader);
+    view->slot = s;
+    view->lock = lock;
+    if (!IsValid(*view) || view->meta.seq != seq ||
+        view->meta.size > header_->slot_size)
+      return false;
+    return true;
+  }
+
+  /** Whether the data of the view is still intact, check after using it. */
+  bool IsValid(const View &view) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot != nullptr &&
+           view.slot->lock.load(std::memory_order_relaxed) == view.lock;
+  }
+
+  /** Copy the message out, false if overwritten while copying. */
+  bool Read(std::uint64_t seq, SlotMeta *meta, void *data,
+      std::size_t data_n) const {
+    View view;
+    if (!Get(seq, &view) || view.meta.size > data_n)
+      return false;
+    std::memcpy(data, view.data, view.meta.size);
+    if (!IsValid(view))
+      return false;
+    *meta = view.meta;
+    return true;
+  }
+
+ private:
+  const SlotHeader *slot(std::size_t i) const {
+    return reinterpret_cast<const SlotHeader *>(
+        reinterpret_cast<const std::uint8_t *>(header_) + sizeof(RingHeader) +
+        i * slot_stride(header_->slot_size));
+  }
+
+  const RingHeader *header_;
+  std::size_t bytes_;
+};
+
+}  // namespace shm
+}  // namespace mynteye
+
+#endif  // MYNTEYE_WRAPPER_SHM_RING_H_
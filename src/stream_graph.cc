@@ -0,0 +1,140 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "stream_graph.h"
+
+#include <sstream>
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+void AddWithAncestors(const Stream &stream, std::set<Stream> *streams) {
+  if (!streams->insert(stream).second)
+    return;
+  for (auto &&parent : StreamGraph::Parents(stream)) {
+    AddWithAncestors(parent, streams);
+  }
+}
+
+void PrintStreams(std::ostream &os, const std::set<Stream> &streams) {
+  os << "{";
+  bool first = true;
+  for (auto &&stream : streams) {
+    if (!first)
+      os << ", ";
+    os << stream;
+    first = false;
+  }
+  os << "}";
+}
+
+}  // namespace
+
+std::uint32_t StreamBits(const std::set<Stream> &streams) {
+  std::uint32_t bits = 0;
+  for (auto &&stream : streams) {
+    bits |= StreamBit(stream);
+  }
+  return bits;
+}
+
+const std::vector<Stream> &StreamGraph::Processed() {
+  static const std::vector<Stream> streams{
+      Stream::LEFT_RECTIFIED, Stream::RIGHT_RECTIFIED,
+      Stream::DISPARITY,      Stream::DISPARITY_NORMALIZED,
+      Stream::POINTS,         Stream::DEPTH};
+  return streams;
+}
+
+std::vector<Stream> StreamGraph::Parents(const Stream &stream) {
+  switch (stream) {
+    case Stream::LEFT_RECTIFIED:
+      return {Stream::LEFT};
+    case Stream::RIGHT_RECTIFIED:
+      return {Stream::RIGHT};
+    case Stream::DISPARITY:
+      return {Stream::LEFT_RECTIFIED, Stream::RIGHT_RECTIFIED};
+    case Stream::DISPARITY_NORMALIZED:
+    case Stream::DEPTH:
+    case Stream::POINTS:
+      return {Stream::DISPARITY};
+    default:
+      return {};
+  }
+}
+
+std::set<Stream> StreamGraph::Ancestors(const std::set<Stream> &streams) {
+  std::set<Stream> ancestors;
+  for (auto &&stream : streams) {
+    for (auto &&parent : Parents(stream)) {
+      AddWithAncestors(parent, &ancestors);
+    }
+  }
+  return ancestors;
+}
+
+bool StreamGraph::HasDescendant(
+    const Stream &stream, const std::set<Stream> &streams) {
+  for (auto &&other : streams) {
+    if (other == stream)
+      continue;
+    std::set<Stream> ancestors;
+    AddWithAncestors(other, &ancestors);
+    if (ancestors.find(stream) != ancestors.end())
+      return true;
+  }
+  return false;
+}
+
+bool StreamGraph::Derivable(const Stream &stream, bool reproject) {
+  return stream == Stream::DISPARITY_NORMALIZED ||
+      (reproject && (stream == Stream::DEPTH || stream == Stream::POINTS));
+}
+
+StreamGraph::Plan StreamGraph::Resolve(const std::set<Stream> &wanted,
+    const std::set<Stream> &enabled, bool derive, bool reproject,
+    const supports_t &supports) {
+  Plan plan;
+  derive = derive && supports(Stream::DISPARITY);
+  for (auto &&stream : wanted) {
+    if (derive && Derivable(stream, reproject)) {
+      plan.derived.insert(stream);
+      plan.sdk.insert(Stream::DISPARITY);
+    } else {
+      plan.sdk.insert(stream);
+      plan.published.insert(stream);
+    }
+  }
+  plan.sdk.insert(enabled.begin(), enabled.end());
+  return plan;
+}
+
+std::string StreamGraph::ToString(const Plan &plan) {
+  std::set<Stream> processors;
+  for (auto &&stream : plan.sdk) {
+    AddWithAncestors(stream, &processors);
+  }
+  processors.erase(Stream::LEFT);
+  processors.erase(Stream::RIGHT);
+  std::ostringstream os;
+  os << "sdk: ";
+  PrintStreams(os, processors);
+  os << ", published: ";
+  PrintStreams(os, plan.published);
+  os << ", derived: ";
+  PrintStreams(os, plan.derived);
+  return os.str();
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,100 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_STREAM_GRAPH_H_
+#define MYNTEYE_WRAPPER_STREAM_GRAPH_H_
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/** The bit of the stream in a mask of streams. */
+inline std::uint32_t StreamBit(const Stream &stream) {
+  return 1u << static_cast<int>(stream);
+}
+
+std::uint32_t StreamBits(const std::set<Stream> &streams);
+
+/**
+ * Processing dependencies of the streams, the raw are rectified, the
+ * rectified matched to the disparity, and the disparity normalized or
+ * reprojected to the depth and points.
+ *
+ * Resolves the streams wanted by the consumers to the fewest the SDK has to
+ * process. Those the wrapper may compute from the disparity on its own are
+ * derived, so the SDK stops at the disparity.
+ */
+class StreamGraph {
+ public:
+  using supports_t = std::function<bool(const Stream &stream)>;
+
+  struct Plan {
+    /** Enabled in the SDK, their processors are implied */
+    std::set<Stream> sdk;
+    /** Of the SDK streams, those published as they are */
+    std::set<Stream> published;
+    /** Computed by the wrapper from the disparity */
+    std::set<Stream> derived;
+
+    bool operator==(const Plan &other) const {
+      return sdk == other.sdk && published == other.published &&
+          derived == other.derived;
+    }
+    bool operator!=(const Plan &other) const {
+      return !(*this == other);
+    }
+  };
+
+  /** The processed streams, all but the raw, parents first. */
+  static const std::vector<Stream> &Processed();
+
+  /** The streams it is processed from, none for the raw. */
+  static std::vector<Stream> Parents(const Stream &stream);
+
+  /** The streams these are processed from, up to the raw. */
+  static std::set<Stream> Ancestors(const std::set<Stream> &streams);
+
+  /** Some stream of the set is processed from this one. */
+  static bool HasDescendant(const Stream &stream,
+      const std::set<Stream> &streams);
+
+  /**
+   * The wrapper may compute it from the disparity, the depth and points
+   * only if it can reproject, i.e. has the Q of a pinhole calibration.
+   */
+  static bool Derivable(const Stream &stream, bool reproject);
+
+  /**
+   * The plan for the wanted streams, and the enabled kept in the SDK
+   * without being published. Derives if derive and the disparity is
+   * supported, the depth and points only if reproject too.
+   */
+  static Plan Resolve(const std::set<Stream> &wanted,
+      const std::set<Stream> &enabled, bool derive, bool reproject,
+      const supports_t &supports);
+
+  /** The plan with the implied processors, to log. */
+  static std::string ToString(const Plan &plan);
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_STREAM_GRAPH_H_
@@ -0,0 +1,194 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "synthetic_device.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+// pixels the right view is shifted by
+const int DISPARITY = 16;
+// pixels the pattern moves per frame
+const int MOTION = 4;
+
+}  // namespace
+
+SyntheticDevice::SyntheticDevice(const Options &options)
+    : VirtualDevice("synthetic"),
+      options_(options),
+      timestamp_beg_(0),
+      generated_frames_(0) {
+  options_.width = std::max(options_.width, 2);
+  options_.height = std::max(options_.height, 2);
+  options_.fps = std::max(options_.fps, 1);
+  options_.imu_rate = std::max(options_.imu_rate, 0);
+  if (options_.timestamp_wrap == 0) {
+    options_.timestamp_wrap = 0xffffffffULL * 10;
+  }
+  if (options_.wrap_after > 0) {
+    timestamp_beg_ = options_.timestamp_wrap - std::min(
+        static_cast<std::uint64_t>(options_.wrap_after * 1000000),
+        options_.timestamp_wrap);
+  }
+  Render();
+  LOG(INFO) << "Synthetic device " << options_.width << "x"
+            << options_.height << " at " << options_.fps << " fps, imu at "
+            << options_.imu_rate << " hz, timestamps wrap after "
+            << options_.wrap_after << " s";
+}
+
+SyntheticDevice::~SyntheticDevice() {
+  Join();
+}
+
+StreamRequest SyntheticDevice::GetStreamRequest() const {
+  return StreamRequest(
+      options_.width, options_.height,
+      options_.model == Model::STANDARD ? Format::GREY : Format::BGR888,
+      options_.fps);
+}
+
+bool SyntheticDevice::Supports(const Stream &stream) const {
+  return stream == Stream::LEFT || stream == Stream::RIGHT ||
+      stream == Stream::POINTS;
+}
+
+void SyntheticDevice::Render() {
+  int width = options_.width, height = options_.height;
+  bool grey = options_.model == Model::STANDARD;
+  texture_.create(height, width * 2 + DISPARITY, grey ? CV_8UC1 : CV_8UC3);
+  for (int y = 0; y < texture_.rows; y++) {
+    auto row = texture_.ptr<std::uint8_t>(y);
+    for (int x = 0; x < texture_.cols; x++) {
+      int b = (x ^ y) & 0xff, g = (x * 3 + (y >> 2)) & 0xff,
+          r = ((x >> 3) * (y >> 3)) & 0xff;
+      if (grey) {
+        row[x] = (b + g + r) / 3;
+      } else {
+        row[x * 3] = b;
+        row[x * 3 + 1] = g;
+        row[x * 3 + 2] = r;
+      }
+    }
+  }
+
+  // a wavy surface in front of the camera, in 1mm as the sdk outputs
+  points_.create(height, width, CV_32FC3);
+  double f = width * 0.6, cx = width / 2.0, cy = height / 2.0;
+  for (int y = 0; y < height; y++) {
+    auto row = points_.ptr<cv::Vec3f>(y);
+    for (int x = 0; x < width; x++) {
+      double z = 1500 + 300 * std::sin(x * 2 * M_PI / width) *
+          std::cos(y * 2 * M_PI / height);
+      row[x] = cv::Vec3f((x - cx) * z / f, (y - cy) * z / f, z);
+    }
+  }
+}
+
+std::uint64_t SyntheticDevice::HardTime(std::uint64_t elapsed) const {
+  return (timestamp_beg_ + elapsed) % options_.timestamp_wrap;
+}
+
+void SyntheticDevice::Run() {
+  const double frame_period = 1000000.0 / options_.fps;
+  const double imu_period =
+      options_.imu_rate > 0 ? 1000000.0 / options_.imu_rate : 0;
+  auto time_beg = clock::now();
+  std::uint64_t frame_n = 0, imu_n = 0;
+  while (!IsStopping()) {
+    auto frame_t = static_cast<std::uint64_t>(frame_n * frame_period);
+    auto imu_t = static_cast<std::uint64_t>(imu_n * imu_period);
+    bool imu_next = imu_period > 0 && imu_t < frame_t;
+    std::uint64_t elapsed = imu_next ? imu_t : frame_t;
+    if (options_.realtime &&
+        !WaitUntil(time_beg + std::chrono::microseconds(elapsed))) {
+      break;
+    }
+    if (imu_next) {
+      EmitImu(imu_n++, elapsed);
+    } else {
+      EmitFrame(frame_n++, elapsed);
+    }
+  }
+}
+
+void SyntheticDevice::EmitFrame(
+    std::uint64_t frame_n, std::uint64_t elapsed) {
+  int shift = static_cast<int>(frame_n * MOTION % options_.width);
+  std::uint64_t timestamp = HardTime(elapsed);
+  for (auto &&stream : {Stream::LEFT, Stream::RIGHT, Stream::POINTS}) {
+    if (!IsStreamEnabled(stream) || !HasStreamCallback(stream))
+      continue;
+    api::StreamData data;
+    data.img = std::make_shared<ImgData>();
+    data.img->frame_id = static_cast<std::uint16_t>(frame_n);
+    data.img->timestamp = timestamp;
+    data.img->exposure_time = 240;
+    data.frame_id = data.img->frame_id;
+    // views of memory not written any more, no copy per frame
+    if (stream == Stream::POINTS) {
+      data.frame = points_;
+    } else {
+      int x = shift + (stream == Stream::RIGHT ? DISPARITY : 0);
+      data.frame = texture_(
+          cv::Rect(x, 0, options_.width, options_.height));
+    }
+    DispatchStream(stream, data);
+  }
+  ++generated_frames_;
+}
+
+void SyntheticDevice::EmitImu(std::uint64_t imu_n, std::uint64_t elapsed) {
+  if (!HasMotionCallback())
+    return;
+  double t = elapsed * 1e-6;
+  auto imu = std::make_shared<ImuData>();
+  imu->frame_id = static_cast<std::uint32_t>(imu_n);
+  imu->timestamp = HardTime(elapsed);
+  // accel in g, gyro in deg/s, slow swaying
+  imu->accel[0] = 0.05 * std::sin(M_PI * t);
+  imu->accel[1] = 0.05 * std::cos(M_PI * t);
+  imu->accel[2] = 1.0;
+  imu->gyro[0] = 10 * std::sin(0.4 * M_PI * t);
+  imu->gyro[1] = 10 * std::cos(0.4 * M_PI * t);
+  imu->gyro[2] = 0;
+  imu->temperature = 40;
+
+  api::MotionData data;
+  if (options_.model == Model::STANDARD) {
+    imu->flag = 0;
+    data.imu = imu;
+    DispatchMotion(data);
+    return;
+  }
+  // the second generation reports accel and gyro apart, gyro between two
+  // accel samples as the sync publish interpolates
+  auto gyro = std::make_shared<ImuData>(*imu);
+  imu->flag = 1;
+  data.imu = imu;
+  DispatchMotion(data);
+  gyro->flag = 2;
+  gyro->timestamp = HardTime(
+      elapsed + static_cast<std::uint64_t>(500000.0 / options_.imu_rate));
+  data.imu = gyro;
+  DispatchMotion(data);
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,86 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_SYNTHETIC_DEVICE_H_
+#define MYNTEYE_WRAPPER_SYNTHETIC_DEVICE_H_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+#include "virtual_device.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Generates stereo frames, points and imu samples without hardware.
+ *
+ * Frames are views of a moving textured pattern rendered once, so the cost
+ * measured is the one of the wrapper. Hardware timestamps wrap around like
+ * the device counter, the first wrap a few seconds after start.
+ */
+class SyntheticDevice : public VirtualDevice {
+ public:
+  struct Options {
+    /** STANDARD for grey frames, STANDARD2 for bgr and split imu */
+    Model model = Model::STANDARD2;
+    int width = 640;
+    int height = 400;
+    int fps = 30;
+    /** Imu samples per second, 0 for none */
+    int imu_rate = 200;
+    /** Pace by the clock, otherwise as fast as the callbacks return */
+    bool realtime = true;
+    /** Period of the hardware timestamp in 1us */
+    std::uint64_t timestamp_wrap = 0xffffffffULL * 10;
+    /** Seconds from start to the first wrap */
+    double wrap_after = 10;
+  };
+
+  explicit SyntheticDevice(const Options &options);
+  ~SyntheticDevice() override;
+
+  Model GetModel() const override {
+    return options_.model;
+  }
+  StreamRequest GetStreamRequest() const override;
+  bool Supports(const Stream &stream) const override;
+
+  std::uint64_t generated_frames() const {
+    return generated_frames_;
+  }
+
+ protected:
+  void Run() override;
+
+ private:
+  void Render();
+  std::uint64_t HardTime(std::uint64_t elapsed) const;
+  void EmitFrame(std::uint64_t frame_n, std::uint64_t elapsed);
+  void EmitImu(std::uint64_t imu_n, std::uint64_t elapsed);
+
+  Options options_;
+  std::uint64_t timestamp_beg_;
+
+  /** Pattern twice as wide as a frame, frames are moving views of it */
+  cv::Mat texture_;
+  cv::Mat points_;
+
+  std::atomic<std::uint64_t> generated_frames_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_SYNTHETIC_DEVICE_H_
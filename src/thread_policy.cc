@@ -0,0 +1,160 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "thread_policy.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+std::string ToString(const ThreadPolicy &policy) {
+  std::ostringstream ss;
+  ss << "cores ";
+  if (policy.cores.empty()) {
+    ss << "any";
+  }
+  for (std::size_t i = 0; i < policy.cores.size(); i++) {
+    ss << (i > 0 ? "," : "") << policy.cores[i];
+  }
+  if (policy.priority > 0) {
+    ss << ", fifo " << policy.priority;
+  } else {
+    ss << ", default scheduling";
+  }
+  return ss.str();
+}
+
+bool ApplyThreadPolicy(const ThreadPolicy &policy, std::string *error) {
+  pthread_t thread = pthread_self();
+  std::ostringstream errors;
+  if (!policy.cores.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto &&core : policy.cores) {
+      if (core < 0 || core >= CPU_SETSIZE) {
+        errors << "no core " << core << "; ";
+        continue;
+      }
+      CPU_SET(core, &set);
+    }
+    cpu_set_t got;
+    CPU_ZERO(&got);
+    int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err == 0) {
+      err = pthread_getaffinity_np(thread, sizeof(got), &got);
+    }
+    if (err != 0) {
+      errors << "affinity: " << std::strerror(err) << "; ";
+    } else if (!CPU_EQUAL(&set, &got)) {
+      errors << "affinity read back differs; ";
+    }
+  }
+  if (policy.priority > 0) {
+    sched_param param{};
+    param.sched_priority = policy.priority;
+    int err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+    int got_policy = SCHED_OTHER;
+    sched_param got{};
+    if (err == 0) {
+      err = pthread_getschedparam(thread, &got_policy, &got);
+    }
+    if (err != 0) {
+      errors << "SCHED_FIFO " << policy.priority << ": "
+             << std::strerror(err) << "; ";
+    } else if (got_policy != SCHED_FIFO ||
+        got.sched_priority != policy.priority) {
+      errors << "scheduling read back differs; ";
+    }
+  }
+  std::string result = errors.str();
+  if (error) {
+    // without the last "; "
+    *error = result.empty() ? result : result.substr(0, result.size() - 2);
+  }
+  return result.empty();
+}
+
+bool ProbeThreadPolicy(const ThreadPolicy &policy, std::string *error) {
+  bool ok = false;
+  std::thread probe([&policy, &ok, error]() {
+    ok = ApplyThreadPolicy(policy, error);
+  });
+  probe.join();
+  return ok;
+}
+
+bool LockMemory(std::size_t *locked_bytes, std::string *error) {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    if (error) {
+      *error = std::string("mlockall: ") + std::strerror(errno);
+    }
+    return false;
+  }
+  std::size_t kb = 0;
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmLck:") == 0) {
+      std::istringstream(line.substr(6)) >> kb;
+      break;
+    }
+  }
+  if (locked_bytes) {
+    *locked_bytes = kb * 1024;
+  }
+  if (kb == 0) {
+    if (error) {
+      *error = "mlockall returned, but no page is locked";
+    }
+    return false;
+  }
+  return true;
+}
+
+ThreadGroup::ThreadGroup(int id, const std::string &name)
+    : id_(id), name_(name), threads_(0), failures_(0) {}
+
+std::string ThreadGroup::last_error() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return last_error_;
+}
+
+void ThreadGroup::Apply() {
+  std::string error;
+  bool ok = ApplyThreadPolicy(policy_, &error);
+  ++threads_;
+  auto tid = syscall(SYS_gettid);
+  if (ok) {
+    LOG(INFO) << "Thread " << tid << " of " << name_ << ": "
+              << ToString(policy_);
+    return;
+  }
+  ++failures_;
+  LOG(WARNING) << "Thread " << tid << " of " << name_ << ", "
+               << ToString(policy_) << " failed: " << error;
+  std::lock_guard<std::mutex> _(mutex_);
+  last_error_ = error;
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,118 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_THREAD_POLICY_H_
+#define MYNTEYE_WRAPPER_THREAD_POLICY_H_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Cores and SCHED_FIFO priority of a group of threads, see the rt params.
+ */
+struct ThreadPolicy {
+  /** Cores to run on, any if empty */
+  std::vector<int> cores;
+  /** SCHED_FIFO priority, 0 keeps the default scheduling */
+  int priority = 0;
+
+  bool empty() const {
+    return cores.empty() && priority == 0;
+  }
+};
+
+/** The policy as "cores 2,3, fifo 80". */
+std::string ToString(const ThreadPolicy &policy);
+
+/**
+ * Apply the policy to the calling thread, then read back its affinity and
+ * scheduling. False with the reason if either did not take, SCHED_FIFO
+ * needs CAP_SYS_NICE or an rtprio limit.
+ */
+bool ApplyThreadPolicy(const ThreadPolicy &policy, std::string *error);
+
+/**
+ * Apply the policy to a thread started for it, so it is verified before the
+ * threads it is meant for exist.
+ */
+bool ProbeThreadPolicy(const ThreadPolicy &policy, std::string *error);
+
+/**
+ * Lock the pages of the process, those mapped and to be mapped, then read
+ * back the locked bytes.
+ */
+bool LockMemory(std::size_t *locked_bytes, std::string *error);
+
+/**
+ * Threads sharing a policy. Each joins from its own code, e.g. its first
+ * callback, as the threads of the SDK are not ours to start.
+ */
+class ThreadGroup {
+ public:
+  /** @param id distinct for each group, below 32 */
+  ThreadGroup(int id, const std::string &name);
+
+  void SetPolicy(const ThreadPolicy &policy) {
+    policy_ = policy;
+  }
+  const ThreadPolicy &policy() const {
+    return policy_;
+  }
+  const std::string &name() const {
+    return name_;
+  }
+
+  /**
+   * Apply the policy to the calling thread the first time it joins, cheap
+   * after. A thread in two groups has the policy of the last it joined.
+   */
+  void Join() {
+    thread_local std::uint32_t joined = 0;
+    if (policy_.empty() || (joined & (1u << id_)))
+      return;
+    joined |= 1u << id_;
+    Apply();
+  }
+
+  /** Threads joined, and those the policy did not take for */
+  std::uint32_t threads() const {
+    return threads_;
+  }
+  std::uint32_t failures() const {
+    return failures_;
+  }
+  std::string last_error();
+
+ private:
+  void Apply();
+
+  int id_;
+  std::string name_;
+  ThreadPolicy policy_;
+  std::atomic<std::uint32_t> threads_;
+  std::atomic<std::uint32_t> failures_;
+  std::mutex mutex_;
+  std::string last_error_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_THREAD_POLICY_H_
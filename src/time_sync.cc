@@ -0,0 +1,87 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "time_sync.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+void ImuAligner::Align(std::vector<ImuData> *aligned) {
+  aligned->clear();
+
+  if (acc_buf_.empty() || gyro_buf_.empty()) {
+    return;
+  }
+
+  ImuData imu_temp;
+  auto itg = gyro_buf_.end();
+  auto ita = acc_buf_.end();
+  for (auto it_gyro = gyro_buf_.begin();
+      it_gyro != gyro_buf_.end(); it_gyro++) {
+    for (auto it_acc = acc_buf_.begin();
+        it_acc+1 != acc_buf_.end(); it_acc++) {
+      if (it_gyro->timestamp >= it_acc->timestamp
+          && it_gyro->timestamp <= (it_acc+1)->timestamp) {
+        double k = static_cast<double>(
+            (it_acc+1)->timestamp - it_acc->timestamp);
+        k = static_cast<double>(it_gyro->timestamp - it_acc->timestamp) / k;
+
+        imu_temp = *it_gyro;
+        for (int i = 0; i < 3; i++) {
+          imu_temp.accel[i] = it_acc->accel[i] +
+              ((it_acc+1)->accel[i] - it_acc->accel[i]) * k;
+        }
+
+        aligned->push_back(imu_temp);
+
+        itg = it_gyro;
+        ita = it_acc;
+      }
+    }
+  }
+
+  if (itg != gyro_buf_.end()) {
+    gyro_buf_.erase(gyro_buf_.begin(), itg + 1);
+  }
+
+  if (ita != acc_buf_.end()) {
+    acc_buf_.erase(acc_buf_.begin(), ita);
+  }
+}
+
+void PushRecentStamp(
+    std::vector<std::int64_t> *stamps, std::int64_t stamp, std::size_t count) {
+  stamps->insert(stamps->begin(), stamp);
+  if (stamps->size() > count) {
+    stamps->pop_back();
+  }
+}
+
+bool HasCommonStamp(
+    const std::vector<std::int64_t> &left,
+    const std::vector<std::int64_t> &right) {
+  for (auto &&r : right) {
+    for (auto &&l : left) {
+      if (r == l)
+        return true;
+    }
+  }
+  return false;
+}
+
+std::int64_t MidExposureOffset(
+    std::uint16_t exposure_time, double unit, bool stamp_at_end) {
+  auto half = static_cast<std::int64_t>(exposure_time * unit / 2);
+  return stamp_at_end ? -half : half;
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,129 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_TIME_SYNC_H_
+#define MYNTEYE_WRAPPER_TIME_SYNC_H_
+#pragma once
+
+#include <ros/time.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Hardware timestamps of one stream made monotonic across the wraps of the
+ * device counter.
+ */
+class TimestampUnwrapper {
+ public:
+  /** @param period the wrap of the counter, in 1us */
+  explicit TimestampUnwrapper(std::uint64_t period)
+      : period_(period), last_(0), wraps_(0) {}
+
+  /** Called from one thread, the stream callback. */
+  std::uint64_t Unwrap(std::uint64_t hard_time) {
+    // a step back of more than half the period is a wrap, not a reorder
+    if (hard_time < last_ && last_ - hard_time > period_ / 2) {
+      ++wraps_;
+    }
+    last_ = hard_time;
+    return wraps_ * period_ + hard_time;
+  }
+
+ private:
+  std::uint64_t period_;
+  std::uint64_t last_;
+  std::uint64_t wraps_;
+};
+
+/**
+ * Hardware time to ros time, offset by the ros time of the first hardware
+ * time mapped. Shared by all streams so they keep one time base.
+ */
+class SoftTimeMapper {
+ public:
+  SoftTimeMapper() : soft_time_begin_(0), hard_time_begin_(0) {}
+
+  ros::Time Map(std::uint64_t hard_time) {
+    std::call_once(begin_flag_, [this, hard_time]() {
+      soft_time_begin_ = ros::Time::now().toSec();
+      hard_time_begin_ = hard_time;
+    });
+    std::uint64_t time_ns_detal = (hard_time - hard_time_begin_);
+    std::uint64_t time_ns_detal_s = time_ns_detal / 1000000;
+    std::uint64_t time_ns_detal_ns = time_ns_detal % 1000000;
+    double time_sec_double =
+        ros::Time(time_ns_detal_s, time_ns_detal_ns * 1000).toSec();
+    return ros::Time(soft_time_begin_ + time_sec_double);
+  }
+
+ private:
+  std::once_flag begin_flag_;
+  double soft_time_begin_;
+  std::uint64_t hard_time_begin_;
+};
+
+/**
+ * Pairs the separate accel and gyro samples of the device, the accel is
+ * interpolated at each gyro timestamp. Called from the motion callback only.
+ */
+class ImuAligner {
+ public:
+  void PushAccel(const ImuData &accel) {
+    acc_buf_.push_back(accel);
+  }
+  void PushGyro(const ImuData &gyro) {
+    gyro_buf_.push_back(gyro);
+  }
+
+  /**
+   * Replace aligned with the gyro samples the accel now surrounds, and drop
+   * the samples no longer needed.
+   */
+  void Align(std::vector<ImuData> *aligned);
+
+ private:
+  std::vector<ImuData> acc_buf_;
+  std::vector<ImuData> gyro_buf_;
+};
+
+/**
+ * Insert the stamp at the front of the recent stamps, keep count of them.
+ */
+void PushRecentStamp(
+    std::vector<std::int64_t> *stamps, std::int64_t stamp, std::size_t count);
+
+/** Whether the left and right recent stamps share a stamp. */
+bool HasCommonStamp(
+    const std::vector<std::int64_t> &left,
+    const std::vector<std::int64_t> &right);
+
+/**
+ * Offset of the mid exposure of an image from its timestamp, in 1us.
+ * @param exposure_time the virtual exposure of ImgData
+ * @param unit the duration of one exposure unit, in 1us
+ * @param stamp_at_end the timestamp marks the end of the exposure, else its
+ *     start
+ */
+std::int64_t MidExposureOffset(
+    std::uint16_t exposure_time, double unit, bool stamp_at_end);
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_TIME_SYNC_H_
@@ -0,0 +1,204 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "tracer.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+const std::size_t DEFAULT_BUFFER_SIZE = 65536;
+
+std::string Escape(const std::string &str) {
+  std::string escaped;
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    if (static_cast<unsigned char>(c) >= 0x20) {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+double ToMicroseconds(const Tracer::clock::duration &duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+}  // namespace
+
+struct Tracer::Buffer {
+  int tid;
+  std::string thread_name;
+  std::vector<Span> spans;
+  // written by the thread
+  std::atomic<std::size_t> head;
+  std::atomic<bool> retired;
+  // written by the dump
+  std::atomic<std::size_t> tail;
+  std::atomic<std::uint64_t> dropped;
+
+  explicit Buffer(std::size_t size)
+      : tid(0), spans(size), head(0), retired(false), tail(0), dropped(0) {}
+};
+
+// retires the buffer of the thread as it exits, the dump then reuses it
+struct Tracer::BufferOwner {
+  Buffer *buffer = nullptr;
+
+  ~BufferOwner() {
+    if (buffer != nullptr) {
+      buffer->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+
+Tracer &Tracer::Instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer()
+    : enabled_(false), buffer_size_(DEFAULT_BUFFER_SIZE), spare_dropped_(0) {}
+
+void Tracer::SetBufferSize(std::size_t spans) {
+  buffer_size_ = spans > 0 ? spans : 1;
+}
+
+void Tracer::Reserve(std::size_t threads) {
+  std::size_t size = buffer_size_;
+  std::lock_guard<std::mutex> _(mutex_);
+  while (buffers_.size() + spares_.size() < threads) {
+    spares_.emplace_back(new Buffer(size));
+  }
+}
+
+Tracer::Buffer *Tracer::ThreadBuffer() {
+  static thread_local BufferOwner owner;
+  if (owner.buffer == nullptr) {
+    std::unique_ptr<Buffer> buffer;
+    {
+      std::lock_guard<std::mutex> _(mutex_);
+      if (!spares_.empty()) {
+        buffer = std::move(spares_.back());
+        spares_.pop_back();
+      }
+    }
+    std::size_t size = buffer_size_;
+    if (!buffer) {
+      buffer.reset(new Buffer(size));
+    } else if (buffer->spans.size() != size) {
+      buffer->spans.resize(size);  // the size changed since reserved
+    }
+    buffer->tid = static_cast<int>(syscall(SYS_gettid));
+    char name[16] = {};
+    if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0) {
+      buffer->thread_name = name;
+    }
+    owner.buffer = buffer.get();
+    std::lock_guard<std::mutex> _(mutex_);
+    buffers_.push_back(std::move(buffer));
+  }
+  return owner.buffer;
+}
+
+void Tracer::Record(const Span &span) {
+  Buffer *buffer = ThreadBuffer();
+  std::size_t head = buffer->head.load(std::memory_order_relaxed);
+  std::size_t tail = buffer->tail.load(std::memory_order_acquire);
+  if (head - tail >= buffer->spans.size()) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer->spans[head % buffer->spans.size()] = span;
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+std::int64_t Tracer::Dump(const std::string &path) {
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (file == nullptr)
+    return -1;
+  int pid = static_cast<int>(getpid());
+  std::int64_t count = 0;
+  const char *separator = "\n";
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  std::lock_guard<std::mutex> _(mutex_);
+  std::size_t kept = 0;
+  for (std::size_t b = 0; b < buffers_.size(); b++) {
+    auto &&buffer = buffers_[b];
+    // read before the head, so no span follows one retired
+    bool retired = buffer->retired.load(std::memory_order_acquire);
+    std::fprintf(file,
+        "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+        "\"args\":{\"name\":\"%s\"}}",
+        separator, pid, buffer->tid, Escape(buffer->thread_name).c_str());
+    separator = ",\n";
+
+    std::size_t tail = buffer->tail.load(std::memory_order_relaxed);
+    std::size_t head = buffer->head.load(std::memory_order_acquire);
+    for (std::size_t i = tail; i != head; i++) {
+      auto &&span = buffer->spans[i % buffer->spans.size()];
+      std::fprintf(file,
+          "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+          "\"ts\":%.3f,\"dur\":%.3f",
+          separator, span.name, pid, buffer->tid,
+          ToMicroseconds(span.begin.time_since_epoch()),
+          ToMicroseconds(span.end - span.begin));
+      if (span.arg != nullptr) {
+        std::fprintf(file, ",\"args\":{\"stream\":\"%s\"}", span.arg);
+      }
+      std::fprintf(file, "}");
+      ++count;
+    }
+    // frees the slots for the thread
+    buffer->tail.store(head, std::memory_order_release);
+
+    if (retired) {
+      // its thread exited, reuse it for the threads to come
+      spare_dropped_ += buffer->dropped;
+      buffer->thread_name.clear();
+      buffer->head = 0;
+      buffer->tail = 0;
+      buffer->dropped = 0;
+      buffer->retired = false;
+      spares_.push_back(std::move(buffer));
+    } else if (kept++ != b) {
+      buffers_[kept - 1] = std::move(buffer);
+    }
+  }
+  buffers_.resize(kept);
+
+  std::fprintf(file, "\n]}\n");
+  if (std::fclose(file) != 0)
+    return -1;
+  return count;
+}
+
+std::uint64_t Tracer::dropped() const {
+  std::lock_guard<std::mutex> _(mutex_);
+  std::uint64_t dropped = spare_dropped_;
+  for (auto &&buffer : buffers_) {
+    dropped += buffer->dropped;
+  }
+  return dropped;
+}
+
+MYNTEYE_END_NAMESPACE
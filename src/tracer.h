@@ -0,0 +1,140 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_TRACER_H_
+#define MYNTEYE_WRAPPER_TRACER_H_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Spans of the pipeline steps of the process, per thread, written as a
+ * Chrome trace that chrome://tracing and ui.perfetto.dev open.
+ *
+ * Each thread records into its own buffer, a single producer ring the dump
+ * consumes without locking the thread. A full buffer drops new spans until
+ * the next dump. When disabled a span costs one relaxed load.
+ *
+ * A thread takes its buffer before its first span begins, from those
+ * reserved if any. The buffer of a thread that exited is reused after the
+ * dump of its last spans.
+ */
+class Tracer {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  struct Span {
+    /** Static strings, e.g. literals */
+    const char *name;
+    const char *arg;
+    clock::time_point begin;
+    clock::time_point end;
+  };
+
+  static Tracer &Instance();
+
+  bool enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+  void SetEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  /** Spans kept per thread, for the buffers of the threads to come. */
+  void SetBufferSize(std::size_t spans);
+
+  /** Allocate buffers up front, so the first span of a thread does not. */
+  void Reserve(std::size_t threads);
+
+  /** Take a buffer for the calling thread if it has none. */
+  void Attach() {
+    ThreadBuffer();
+  }
+
+  void Record(const Span &span);
+
+  /**
+   * Write the spans since the last dump, then drop them.
+   * @return the spans written, -1 if the file could not be opened
+   */
+  std::int64_t Dump(const std::string &path);
+
+  /** Spans dropped by full buffers */
+  std::uint64_t dropped() const;
+
+ private:
+  struct Buffer;
+  struct BufferOwner;
+
+  Tracer();
+
+  Buffer *ThreadBuffer();
+
+  std::atomic<bool> enabled_;
+  std::atomic<std::size_t> buffer_size_;
+
+  // buffer registration and dumps
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  // reserved or of threads that exited
+  std::vector<std::unique_ptr<Buffer>> spares_;
+  std::uint64_t spare_dropped_;
+};
+
+/**
+ * Records the span of its scope, or till End().
+ */
+class TraceSpan {
+ public:
+  /** @param name, arg static strings, arg may be null */
+  explicit TraceSpan(const char *name, const char *arg = nullptr)
+      : name_(nullptr) {
+    if (Tracer::Instance().enabled()) {
+      Tracer::Instance().Attach();
+      name_ = name;
+      arg_ = arg;
+      begin_ = Tracer::clock::now();
+    }
+  }
+  ~TraceSpan() {
+    End();
+  }
+
+  MYNTEYE_DISABLE_COPY(TraceSpan)
+
+  void End() {
+    if (name_ != nullptr) {
+      Tracer::Instance().Record({name_, arg_, begin_, Tracer::clock::now()});
+      name_ = nullptr;
+    }
+  }
+
+ private:
+  const char *name_;
+  const char *arg_;
+  Tracer::clock::time_point begin_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_TRACER_H_
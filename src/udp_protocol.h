@@ -0,0 +1,88 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_UDP_PROTOCOL_H_
+#define MYNTEYE_WRAPPER_UDP_PROTOCOL_H_
+#pragma once
+
+#include <cstdint>
+
+// self-contained, so consumers build it without the SDK
+namespace mynteye {
+namespace udp {
+
+/**
+ * Wire format of the udp multicast stream, in host byte order.
+ *
+ * Every message (one image or one imu sample) is split into fragments, each
+ * fragment is one datagram: PacketHeader followed by the fragment payload.
+ * The message payload is ImageHeader + pixels, or ImuPacket.
+ */
+
+const std::uint32_t MAGIC = 0x544e594d;  // "MYNT"
+const std::uint8_t VERSION = 1;
+
+enum MessageType : std::uint8_t {
+  MESSAGE_IMAGE = 0,
+  MESSAGE_IMU = 1,
+};
+
+#pragma pack(push, 1)
+
+struct PacketHeader {
+  std::uint32_t magic;
+  std::uint8_t version;
+  /** MessageType */
+  std::uint8_t type;
+  /** Stream value for images, 0 for imu */
+  std::uint8_t stream;
+  std::uint8_t reserved;
+  /** Message sequence, per stream */
+  std::uint32_t seq;
+  std::uint16_t frag_index;
+  std::uint16_t frag_count;
+  /** Total message size in bytes */
+  std::uint32_t msg_size;
+  /** Offset of this fragment in the message */
+  std::uint32_t frag_offset;
+};
+
+struct ImageHeader {
+  /** Hardware timestamp in 1us */
+  std::uint64_t timestamp;
+  std::uint16_t frame_id;
+  std::uint16_t width;
+  std::uint16_t height;
+  /** OpenCV type, e.g. CV_8UC3 */
+  std::uint16_t cv_type;
+  /** Bytes per row, rows are packed */
+  std::uint32_t step;
+};
+
+struct ImuPacket {
+  /** Hardware timestamp in 1us */
+  std::uint64_t timestamp;
+  std::uint32_t frame_id;
+  std::uint8_t flag;
+  std::uint8_t reserved[3];
+  double accel[3];
+  double gyro[3];
+  double temperature;
+};
+
+#pragma pack(pop)
+
+}  // namespace udp
+}  // namespace mynteye
+
+#endif  // MYNTEYE_WRAPPER_UDP_PROTOCOL_H_
@@ -0,0 +1,199 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "udp_receiver.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace mynteye {
+
+const udp::ImageHeader *UdpReceiver::Message::image() const {
+  if (type != udp::MESSAGE_IMAGE || payload.size() < sizeof(udp::ImageHeader))
+    return nullptr;
+  return reinterpret_cast<const udp::ImageHeader *>(payload.data());
+}
+
+const std::uint8_t *UdpReceiver::Message::image_data() const {
+  if (image() == nullptr)
+    return nullptr;
+  return payload.data() + sizeof(udp::ImageHeader);
+}
+
+const udp::ImuPacket *UdpReceiver::Message::imu() const {
+  if (type != udp::MESSAGE_IMU || payload.size() < sizeof(udp::ImuPacket))
+    return nullptr;
+  return reinterpret_cast<const udp::ImuPacket *>(payload.data());
+}
+
+UdpReceiver::UdpReceiver()
+    : fd_(-1), buffer_(65536), dropped_(0), received_(0) {}
+
+UdpReceiver::~UdpReceiver() {
+  Close();
+}
+
+bool UdpReceiver::Open(
+    const std::string &group, std::uint16_t port, const std::string &iface) {
+  Close();
+  error_.clear();
+
+  fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd_ < 0) {
+    return Fail("socket failed", errno);
+  }
+
+  int reuse = 1;
+  setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  int rcvbuf = 8 * 1024 * 1024;
+  setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+    Fail("bind failed", errno);
+    Close();
+    return false;
+  }
+
+  struct ip_mreq mreq;
+  if (inet_pton(AF_INET, group.c_str(), &mreq.imr_multiaddr) != 1) {
+    Fail("invalid group: " + group, 0);
+    Close();
+    return false;
+  }
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (!iface.empty() &&
+      inet_pton(AF_INET, iface.c_str(), &mreq.imr_interface) != 1) {
+    Fail("invalid interface: " + iface, 0);
+    Close();
+    return false;
+  }
+  if (setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+          sizeof(mreq)) < 0) {
+    Fail("join failed", errno);
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void UdpReceiver::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  assemblies_.clear();
+  next_seqs_.clear();
+}
+
+bool UdpReceiver::Receive(Message *msg, int timeout_ms) {
+  error_.clear();
+  if (fd_ < 0 || msg == nullptr) {
+    error_ = fd_ < 0 ? "not opened" : "no message";
+    return false;
+  }
+  while (true) {
+    struct pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret < 0)
+      return Fail("poll failed", errno);
+    if (ret == 0)
+      return false;  // timeout, not an error
+    ssize_t n = recv(fd_, buffer_.data(), buffer_.size(), 0);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      return Fail("recv failed", errno);
+    }
+    if (Accept(buffer_.data(), n, msg))
+      return true;
+  }
+}
+
+bool UdpReceiver::Fail(const std::string &what, int err) {
+  error_ = err != 0 ? what + ": " + std::strerror(err) : what;
+  return false;
+}
+
+bool UdpReceiver::Accept(
+    const std::uint8_t *packet, std::size_t n, Message *msg) {
+  if (n < sizeof(udp::PacketHeader))
+    return false;
+  udp::PacketHeader header;
+  std::memcpy(&header, packet, sizeof(header));
+  if (header.magic != udp::MAGIC || header.version != udp::VERSION ||
+      header.frag_count == 0 || header.frag_index >= header.frag_count)
+    return false;
+  const std::uint8_t *frag = packet + sizeof(header);
+  std::size_t frag_n = n - sizeof(header);
+  if (header.frag_offset + frag_n > header.msg_size)
+    return false;
+
+  std::uint16_t key = (header.type << 8) | header.stream;
+  auto &&assembly = assemblies_[key];
+  if (!assembly.active || assembly.seq != header.seq) {
+    if (assembly.active &&
+        static_cast<std::int32_t>(header.seq - assembly.seq) < 0) {
+      return false;  // late fragment of an older message
+    }
+    auto &&next = next_seqs_.find(key);
+    if (next != next_seqs_.end()) {
+      std::uint32_t gap = header.seq - next->second;
+      if (gap >= 0x80000000u)
+        return false;  // already completed or abandoned
+      dropped_ += gap;
+    }
+    if (assembly.active)
+      ++dropped_;  // abandon the incomplete one
+    assembly.active = true;
+    assembly.seq = header.seq;
+    assembly.frag_count = header.frag_count;
+    assembly.frag_received = 0;
+    assembly.frags.assign(header.frag_count, false);
+    assembly.payload.resize(header.msg_size);
+    next_seqs_[key] = header.seq + 1;
+  }
+  if (header.frag_count != assembly.frag_count ||
+      header.msg_size != assembly.payload.size() ||
+      assembly.frags[header.frag_index])
+    return false;
+
+  std::memcpy(assembly.payload.data() + header.frag_offset, frag, frag_n);
+  assembly.frags[header.frag_index] = true;
+  if (++assembly.frag_received < assembly.frag_count)
+    return false;
+
+  assembly.active = false;
+  msg->type = header.type;
+  msg->stream = header.stream;
+  msg->seq = header.seq;
+  msg->payload.swap(assembly.payload);
+  ++received_;
+  return true;
+}
+
+}  // namespace mynteye
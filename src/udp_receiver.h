@@ -0,0 +1,107 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_UDP_RECEIVER_H_
+#define MYNTEYE_WRAPPER_UDP_RECEIVER_H_
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "udp_protocol.h"
+
+namespace mynteye {
+
+/**
+ * Receives and reassembles the messages sent by UdpSink.
+ *
+ * Linked as mynteye_udp_receiver, it depends on neither the SDK nor ROS.
+ */
+class UdpReceiver {
+ public:
+  struct Message {
+    /** udp::MessageType */
+    std::uint8_t type;
+    std::uint8_t stream;
+    std::uint32_t seq;
+    std::vector<std::uint8_t> payload;
+
+    /** Valid if type is udp::MESSAGE_IMAGE */
+    const udp::ImageHeader *image() const;
+    /** Pixels of the image, rows are packed */
+    const std::uint8_t *image_data() const;
+    /** Valid if type is udp::MESSAGE_IMU */
+    const udp::ImuPacket *imu() const;
+  };
+
+  UdpReceiver();
+  ~UdpReceiver();
+
+  /**
+   * Join the multicast group, several receivers may share the port.
+   * @param iface the local interface address, empty for any
+   * @return false with the reason in error()
+   */
+  bool Open(
+      const std::string &group, std::uint16_t port,
+      const std::string &iface = "");
+  void Close();
+
+  /**
+   * Receive the next complete message.
+   * @param timeout_ms negative waits forever
+   * @return false on timeout or error
+   */
+  bool Receive(Message *msg, int timeout_ms = -1);
+
+  /** Messages lost or left incomplete */
+  std::uint64_t dropped() const {
+    return dropped_;
+  }
+  std::uint64_t received() const {
+    return received_;
+  }
+  /** Why the last Open() or Receive() failed, empty if it did not */
+  const std::string &error() const {
+    return error_;
+  }
+
+ private:
+  struct Assembly {
+    bool active = false;
+    std::uint32_t seq = 0;
+    std::uint16_t frag_count = 0;
+    std::uint16_t frag_received = 0;
+    std::vector<bool> frags;
+    std::vector<std::uint8_t> payload;
+  };
+
+  bool Accept(const std::uint8_t *packet, std::size_t n, Message *msg);
+  /** Set error() with the reason of errno if not 0, returns false */
+  bool Fail(const std::string &what, int err);
+
+  int fd_;
+  std::vector<std::uint8_t> buffer_;
+  std::map<std::uint16_t, Assembly> assemblies_;
+  std::map<std::uint16_t, std::uint32_t> next_seqs_;
+
+  std::uint64_t dropped_;
+  std::uint64_t received_;
+  std::string error_;
+};
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_WRAPPER_UDP_RECEIVER_H_
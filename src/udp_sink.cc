@@ -0,0 +1,205 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "udp_sink.h"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+UdpSink::UdpSink()
+    : fd_(-1), mtu_(1400), imu_seq_(0), sent_bytes_(0), send_errors_(0),
+      send_drops_(0) {
+  std::memset(&addr_, 0, sizeof(addr_));
+}
+
+UdpSink::~UdpSink() {
+  Close();
+}
+
+bool UdpSink::Open(
+    const std::string &group, std::uint16_t port, const std::string &iface,
+    int ttl, std::size_t mtu) {
+  Close();
+  if (mtu <= sizeof(udp::PacketHeader) + sizeof(udp::ImuPacket)) {
+    LOG(ERROR) << "Udp sink mtu too small: " << mtu;
+    return false;
+  }
+  mtu_ = mtu;
+
+  addr_.sin_family = AF_INET;
+  addr_.sin_port = htons(port);
+  if (inet_pton(AF_INET, group.c_str(), &addr_.sin_addr) != 1) {
+    LOG(ERROR) << "Udp sink invalid group: " << group;
+    return false;
+  }
+
+  fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd_ < 0) {
+    LOG(ERROR) << "Udp sink socket failed: " << std::strerror(errno);
+    return false;
+  }
+
+  unsigned char mc_ttl = static_cast<unsigned char>(ttl);
+  unsigned char mc_loop = 1;  // let listeners on this host receive
+  if (setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &mc_ttl,
+          sizeof(mc_ttl)) < 0 ||
+      setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &mc_loop,
+          sizeof(mc_loop)) < 0) {
+    LOG(ERROR) << "Udp sink setsockopt failed: " << std::strerror(errno);
+    Close();
+    return false;
+  }
+  if (!iface.empty()) {
+    struct in_addr if_addr;
+    if (inet_pton(AF_INET, iface.c_str(), &if_addr) != 1 ||
+        setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_IF, &if_addr,
+            sizeof(if_addr)) < 0) {
+      LOG(ERROR) << "Udp sink invalid interface: " << iface;
+      Close();
+      return false;
+    }
+  }
+  int sndbuf = 4 * 1024 * 1024;
+  setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+  VLOG(2) << "Udp sink opened on " << group << ":" << port;
+  return true;
+}
+
+void UdpSink::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool UdpSink::SendImage(
+    std::uint8_t stream, std::uint64_t timestamp, std::uint16_t frame_id,
+    std::uint16_t width, std::uint16_t height, std::uint16_t cv_type,
+    std::size_t row_bytes, const std::uint8_t *data, std::size_t step) {
+  udp::ImageHeader header;
+  header.timestamp = timestamp;
+  header.frame_id = frame_id;
+  header.width = width;
+  header.height = height;
+  header.cv_type = cv_type;
+  header.step = static_cast<std::uint32_t>(row_bytes);
+
+  std::lock_guard<std::mutex> _(image_mutex_);
+  std::size_t bytes_n = row_bytes * height;
+  const std::uint8_t *body = data;
+  if (step != row_bytes) {
+    // pack the rows of a cropped frame
+    pack_buffer_.resize(bytes_n);
+    for (std::size_t y = 0; y < height; y++) {
+      std::memcpy(
+          pack_buffer_.data() + y * row_bytes, data + y * step, row_bytes);
+    }
+    body = pack_buffer_.data();
+  }
+  return SendMessage(
+      udp::MESSAGE_IMAGE, stream, image_seqs_[stream]++,
+      reinterpret_cast<const std::uint8_t *>(&header), sizeof(header), body,
+      bytes_n);
+}
+
+bool UdpSink::SendImu(const udp::ImuPacket &imu) {
+  std::lock_guard<std::mutex> _(imu_mutex_);
+  return SendMessage(
+      udp::MESSAGE_IMU, 0, imu_seq_++,
+      reinterpret_cast<const std::uint8_t *>(&imu), sizeof(imu), nullptr, 0);
+}
+
+bool UdpSink::SendMessage(
+    std::uint8_t type, std::uint8_t stream, std::uint32_t seq,
+    const std::uint8_t *head, std::size_t head_n, const std::uint8_t *body,
+    std::size_t body_n) {
+  if (fd_ < 0)
+    return false;
+
+  std::size_t msg_size = head_n + body_n;
+  std::size_t frag_size = mtu_ - sizeof(udp::PacketHeader);
+  std::size_t frag_count = (msg_size + frag_size - 1) / frag_size;
+  if (frag_count > 0xffff) {
+    LOG(WARNING) << "Udp sink message too large: " << msg_size;
+    ++send_errors_;
+    return false;
+  }
+
+  udp::PacketHeader packet;
+  packet.magic = udp::MAGIC;
+  packet.version = udp::VERSION;
+  packet.type = type;
+  packet.stream = stream;
+  packet.reserved = 0;
+  packet.seq = seq;
+  packet.frag_count = static_cast<std::uint16_t>(frag_count);
+  packet.msg_size = static_cast<std::uint32_t>(msg_size);
+
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &addr_;
+  msg.msg_namelen = sizeof(addr_);
+
+  bool ok = true;
+  for (std::size_t i = 0; i < frag_count; i++) {
+    std::size_t beg = i * frag_size;
+    std::size_t end = std::min(beg + frag_size, msg_size);
+    packet.frag_index = static_cast<std::uint16_t>(i);
+    packet.frag_offset = static_cast<std::uint32_t>(beg);
+
+    // the fragment may span the head and the body, send without copy
+    struct iovec iov[3];
+    std::size_t iov_n = 0;
+    iov[iov_n].iov_base = &packet;
+    iov[iov_n++].iov_len = sizeof(packet);
+    if (beg < head_n) {
+      iov[iov_n].iov_base = const_cast<std::uint8_t *>(head + beg);
+      iov[iov_n++].iov_len = std::min(end, head_n) - beg;
+    }
+    if (end > head_n) {
+      std::size_t body_beg = beg > head_n ? beg - head_n : 0;
+      iov[iov_n].iov_base = const_cast<std::uint8_t *>(body + body_beg);
+      iov[iov_n++].iov_len = end - head_n - body_beg;
+    }
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_n;
+
+    // never wait for the buffer, the next message is due soon
+    ssize_t n = sendmsg(fd_, &msg, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // the receiver can not complete the message, skip its other fragments
+      ++send_drops_;
+      return false;
+    }
+    if (n < 0) {
+      ++send_errors_;
+      ok = false;
+      continue;
+    }
+    sent_bytes_ += n;
+  }
+  return ok;
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,107 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_UDP_SINK_H_
+#define MYNTEYE_WRAPPER_UDP_SINK_H_
+#pragma once
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mynteye/mynteye.h"
+#include "udp_protocol.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Sends images and imu samples to a udp multicast group.
+ *
+ * One send serves any number of listeners, see UdpReceiver. Images and imu
+ * samples lock on their own, so an imu sample never waits behind the
+ * datagrams of an image, and no send waits for the socket buffer.
+ */
+class UdpSink {
+ public:
+  UdpSink();
+  ~UdpSink();
+
+  /**
+   * Open the socket.
+   * @param group the multicast group, e.g. 239.255.0.1
+   * @param port the destination port
+   * @param iface the outgoing interface address, empty for the default
+   * @param ttl the multicast ttl, 0 keeps datagrams on this host
+   * @param mtu the max datagram size in bytes
+   */
+  bool Open(
+      const std::string &group, std::uint16_t port,
+      const std::string &iface = "", int ttl = 1, std::size_t mtu = 1400);
+  void Close();
+
+  bool IsOpened() const {
+    return fd_ >= 0;
+  }
+
+  /**
+   * Send one image, rows may be padded by step.
+   * @return false if the image was lost, e.g. the socket buffer was full
+   */
+  bool SendImage(
+      std::uint8_t stream, std::uint64_t timestamp, std::uint16_t frame_id,
+      std::uint16_t width, std::uint16_t height, std::uint16_t cv_type,
+      std::size_t row_bytes, const std::uint8_t *data, std::size_t step);
+
+  bool SendImu(const udp::ImuPacket &imu);
+
+  std::uint64_t sent_bytes() const {
+    return sent_bytes_;
+  }
+  std::uint64_t send_errors() const {
+    return send_errors_;
+  }
+  /** Messages lost as the socket buffer was full. */
+  std::uint64_t send_drops() const {
+    return send_drops_;
+  }
+
+ private:
+  bool SendMessage(
+      std::uint8_t type, std::uint8_t stream, std::uint32_t seq,
+      const std::uint8_t *head, std::size_t head_n, const std::uint8_t *body,
+      std::size_t body_n);
+
+  int fd_;
+  struct sockaddr_in addr_;
+  std::size_t mtu_;
+
+  std::mutex image_mutex_;
+  std::map<std::uint8_t, std::uint32_t> image_seqs_;
+  std::vector<std::uint8_t> pack_buffer_;
+
+  std::mutex imu_mutex_;
+  std::uint32_t imu_seq_;
+
+  std::atomic<std::uint64_t> sent_bytes_;
+  std::atomic<std::uint64_t> send_errors_;
+  std::atomic<std::uint64_t> send_drops_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_UDP_SINK_H_
@@ -0,0 +1,208 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "virtual_device.h"
+
+#include <utility>
+
+#include "mynteye/logger.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+VirtualDevice::VirtualDevice(const std::string &name)
+    : name_(name),
+      video_started_(false),
+      motion_started_(false),
+      stopping_(false),
+      stream_datas_max_(0),
+      motion_datas_max_(0) {}
+
+VirtualDevice::~VirtualDevice() {
+  Join();
+}
+
+void VirtualDevice::EnableStreamData(const Stream &stream) {
+  std::lock_guard<std::mutex> _(mutex_);
+  enabled_streams_.insert(stream);
+}
+
+void VirtualDevice::DisableStreamData(
+    const Stream &stream, stream_switch_callback_t callback, bool try_tag) {
+  if (callback) {
+    callback(stream);
+  }
+  if (try_tag)
+    return;
+  std::lock_guard<std::mutex> _(mutex_);
+  enabled_streams_.erase(stream);
+}
+
+void VirtualDevice::SetStreamCallback(
+    const Stream &stream, stream_callback_t callback) {
+  std::lock_guard<std::mutex> _(mutex_);
+  if (callback) {
+    stream_callbacks_[stream] = std::move(callback);
+  } else {
+    stream_callbacks_.erase(stream);
+  }
+}
+
+void VirtualDevice::SetMotionCallback(motion_callback_t callback) {
+  std::lock_guard<std::mutex> _(mutex_);
+  motion_callback_ = std::move(callback);
+}
+
+void VirtualDevice::EnableStreamDatas(std::size_t max_size) {
+  std::lock_guard<std::mutex> _(mutex_);
+  stream_datas_max_ = max_size;
+}
+
+std::vector<api::StreamData> VirtualDevice::GetStreamDatas(
+    const Stream &stream) {
+  std::vector<api::StreamData> datas;
+  std::lock_guard<std::mutex> _(mutex_);
+  auto &&it = stream_datas_.find(stream);
+  if (it != stream_datas_.end()) {
+    datas.swap(it->second);
+  }
+  return datas;
+}
+
+void VirtualDevice::EnableMotionDatas(std::size_t max_size) {
+  std::lock_guard<std::mutex> _(mutex_);
+  motion_datas_max_ = max_size;
+}
+
+std::vector<api::MotionData> VirtualDevice::GetMotionDatas() {
+  std::vector<api::MotionData> datas;
+  std::lock_guard<std::mutex> _(mutex_);
+  datas.swap(motion_datas_);
+  return datas;
+}
+
+void VirtualDevice::Start(const Source &source) {
+  std::lock_guard<std::mutex> _(mutex_);
+  if (source == Source::VIDEO_STREAMING || source == Source::ALL) {
+    video_started_ = true;
+  }
+  if (source == Source::MOTION_TRACKING || source == Source::ALL) {
+    motion_started_ = true;
+  }
+  if (!thread_.joinable()) {
+    stopping_ = false;
+    thread_ = std::thread([this]() {
+      LOG(INFO) << "Virtual device " << name_ << " started";
+      Run();
+      LOG(INFO) << "Virtual device " << name_ << " stopped";
+    });
+  }
+}
+
+void VirtualDevice::Stop(const Source &source) {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (source == Source::VIDEO_STREAMING || source == Source::ALL) {
+      video_started_ = false;
+    }
+    if (source == Source::MOTION_TRACKING || source == Source::ALL) {
+      motion_started_ = false;
+    }
+    if (video_started_ || motion_started_)
+      return;
+  }
+  Join();
+}
+
+void VirtualDevice::Join() {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    stopping_ = true;
+  }
+  cond_.notify_all();
+  if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) {
+    thread_.join();
+  }
+}
+
+bool VirtualDevice::IsStopping() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return stopping_;
+}
+
+bool VirtualDevice::WaitUntil(const clock::time_point &time) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !cond_.wait_until(lock, time, [this] { return stopping_; });
+}
+
+bool VirtualDevice::IsStreamEnabled(const Stream &stream) {
+  if (stream == Stream::LEFT || stream == Stream::RIGHT)
+    return true;
+  std::lock_guard<std::mutex> _(mutex_);
+  return enabled_streams_.find(stream) != enabled_streams_.end();
+}
+
+bool VirtualDevice::HasStreamCallback(const Stream &stream) {
+  std::lock_guard<std::mutex> _(mutex_);
+  return video_started_ && (stream_datas_max_ > 0 ||
+      stream_callbacks_.find(stream) != stream_callbacks_.end());
+}
+
+bool VirtualDevice::HasMotionCallback() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return motion_started_ &&
+      (motion_datas_max_ > 0 || motion_callback_ != nullptr);
+}
+
+void VirtualDevice::DispatchStream(
+    const Stream &stream, const api::StreamData &data) {
+  stream_callback_t callback;
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (!video_started_)
+      return;
+    auto &&it = stream_callbacks_.find(stream);
+    if (it == stream_callbacks_.end()) {
+      if (stream_datas_max_ > 0) {
+        auto &&datas = stream_datas_[stream];
+        if (datas.size() >= stream_datas_max_) {
+          datas.erase(datas.begin());
+        }
+        datas.push_back(data);
+      }
+      return;
+    }
+    callback = it->second;
+  }
+  callback(data);
+}
+
+void VirtualDevice::DispatchMotion(const api::MotionData &data) {
+  motion_callback_t callback;
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (!motion_started_)
+      return;
+    callback = motion_callback_;
+    if (motion_datas_max_ > 0) {
+      if (motion_datas_.size() >= motion_datas_max_) {
+        motion_datas_.erase(motion_datas_.begin());
+      }
+      motion_datas_.push_back(data);
+    }
+  }
+  if (callback) {
+    callback(data);
+  }
+}
+
+MYNTEYE_END_NAMESPACE
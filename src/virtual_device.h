@@ -0,0 +1,120 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_WRAPPER_VIRTUAL_DEVICE_H_
+#define MYNTEYE_WRAPPER_VIRTUAL_DEVICE_H_
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mynteye/api/api.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Device without hardware, in place of API for the data path.
+ *
+ * Mirrors the stream and motion calls of API, so the wrapper registers the
+ * same callbacks. Subclasses produce the data on their own thread in Run().
+ */
+class VirtualDevice {
+ public:
+  using stream_callback_t = API::stream_callback_t;
+  using motion_callback_t = API::motion_callback_t;
+  using stream_switch_callback_t = API::stream_switch_callback_t;
+  using clock = std::chrono::steady_clock;
+
+  explicit VirtualDevice(const std::string &name);
+  virtual ~VirtualDevice();
+
+  const std::string &name() const {
+    return name_;
+  }
+
+  virtual Model GetModel() const = 0;
+  virtual StreamRequest GetStreamRequest() const = 0;
+  virtual bool Supports(const Stream &stream) const = 0;
+
+  void EnableStreamData(const Stream &stream);
+  /** Calls back the stream itself, there are no dependent streams. */
+  void DisableStreamData(
+      const Stream &stream, stream_switch_callback_t callback,
+      bool try_tag = false);
+
+  void SetStreamCallback(const Stream &stream, stream_callback_t callback);
+  void SetMotionCallback(motion_callback_t callback);
+
+  /**
+   * Cache at most max_size datas of each stream without a callback, as the
+   * SDK does, for GetStreamDatas.
+   */
+  void EnableStreamDatas(std::size_t max_size);
+  std::vector<api::StreamData> GetStreamDatas(const Stream &stream);
+
+  /** Cache at most max_size motion datas, besides the callback. */
+  void EnableMotionDatas(std::size_t max_size);
+  std::vector<api::MotionData> GetMotionDatas();
+
+  void Start(const Source &source);
+  void Stop(const Source &source);
+
+ protected:
+  /** Produce data until it returns or IsStopping(). */
+  virtual void Run() = 0;
+
+  bool IsStopping();
+  /** Sleep until the time, false if stopping. */
+  bool WaitUntil(const clock::time_point &time);
+
+  /** LEFT and RIGHT are native, others need EnableStreamData. */
+  bool IsStreamEnabled(const Stream &stream);
+  /** A callback or the cache takes the data. */
+  bool HasStreamCallback(const Stream &stream);
+  bool HasMotionCallback();
+
+  void DispatchStream(const Stream &stream, const api::StreamData &data);
+  void DispatchMotion(const api::MotionData &data);
+
+  /** Stop and join the thread, subclasses call it in their destructor. */
+  void Join();
+
+ private:
+  std::string name_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool video_started_;
+  bool motion_started_;
+  bool stopping_;
+  std::set<Stream> enabled_streams_;
+  std::map<Stream, stream_callback_t> stream_callbacks_;
+  motion_callback_t motion_callback_;
+  // caches of the pull mode, off at 0
+  std::size_t stream_datas_max_;
+  std::map<Stream, std::vector<api::StreamData>> stream_datas_;
+  std::size_t motion_datas_max_;
+  std::vector<api::MotionData> motion_datas_;
+
+  std::thread thread_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_WRAPPER_VIRTUAL_DEVICE_H_
@@ -29,6 +29,14 @@ int main(int argc, char *argv[]) {
   nodelet.load(
       ros::this_node::getName(), "mynteye/ROSWrapperNodelet", remap, nargv);
 
+  bool bench_enable = false;
+  ros::param::get("~bench/enable", bench_enable);
+  if (bench_enable) {
+    // in this process, the messages are passed by pointer
+    nodelet.load(ros::this_node::getName() + "/bench",
+        "mynteye/SubscriberBenchNodelet", remap, nargv);
+  }
+
   ros::spin();
 
   return 0;
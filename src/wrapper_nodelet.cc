@@ -16,31 +16,65 @@
 
 #include <cv_bridge/cv_bridge.h>
 #include <image_transport/image_transport.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <sensor_msgs/CompressedImage.h>
 #include <sensor_msgs/Imu.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/Temperature.h>
 #include <sensor_msgs/image_encodings.h>
-#include <sensor_msgs/point_cloud2_iterator.h>
+#include <std_msgs/Empty.h>
 #include <tf/tf.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 
 #include <opencv2/calib3d/calib3d.hpp>
 
+#include <mynt_eye_ros_wrapper/DumpBlackBox.h>
+#include <mynt_eye_ros_wrapper/GetCachedFrame.h>
 #include <mynt_eye_ros_wrapper/GetInfo.h>
+#include <mynt_eye_ros_wrapper/Reconfigure.h>
+#include <mynt_eye_ros_wrapper/Trace.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <ctime>
+#include <iomanip>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "mynteye/logger.h"
 #include "mynteye/api/api.h"
 #include "mynteye/device/context.h"
 #include "mynteye/device/device.h"
-#define CONFIGURU_IMPLEMENTATION 1
-#include "configuru.hpp"
-using namespace configuru;  // NOLINT
-
+#include "acquisition.h"
+#include "alloc_stats.h"
+#include "black_box.h"
+#include "conversions.h"
+#include "frame_cache.h"
+#include "info_json.h"
+#include "message_pool.h"
+#include "metrics_server.h"
+#include "pipeline_stats.h"
+#include "process_stats.h"
+#include "playback_device.h"
+#include "recorder.h"
+#include "shm_ring.h"
+#include "stream_graph.h"
+#include "synthetic_device.h"
+#include "time_sync.h"
+#include "thread_policy.h"
+#include "tracer.h"
+#include "udp_sink.h"
+#ifdef WITH_X264
+#include "h264_encoder.h"
+#endif
 #define PIE 3.1416
 #define MATCH_CHECK_THRESHOLD 3
 
@@ -48,6 +82,8 @@ using namespace configuru;  // NOLINT
   std::fixed << std::setprecision(std::numeric_limits<double>::max_digits10)
 
 static const std::size_t MAXSIZE = 4;
+// recycled messages kept per stream, more in flight are allocated
+static const std::size_t MESSAGE_POOL_SIZE = 4;
 
 MYNTEYE_BEGIN_NAMESPACE
 
@@ -73,9 +109,18 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
 
   ~ROSWrapperNodelet() {
     // std::cout << __func__ << std::endl;
+    if (metrics_server_) {
+      metrics_server_->Close();  // reads the stats and sinks below
+    }
+    if (pull_thread_) {
+      pull_thread_->Stop();
+    }
     if (api_) {
       api_->Stop(Source::ALL);
     }
+    if (virtual_device_) {
+      virtual_device_->Stop(Source::ALL);
+    }
     if (time_beg_ != -1) {
       double time_end = ros::Time::now().toSec();
 
@@ -107,30 +152,64 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
         }
       }
 
+      logPoolStats("Points", points_pool_);
+      for (auto &&it : image_pools_) {
+        std::ostringstream name;
+        name << it.first;
+        logPoolStats(name.str(), it.second);
+      }
+      for (auto &&it : mono_pools_) {
+        std::ostringstream name;
+        name << it.first << " mono";
+        logPoolStats(name.str(), it.second);
+      }
+
+      if (recorder_) {
+        recorder_->Close();
+        LOG(INFO) << "Record count: " << recorder_->records()
+                  << ", dropped: " << recorder_->dropped()
+                  << ", written: " << (recorder_->written_bytes() >> 20)
+                  << " MB";
+      }
+
+      if (black_box_) {
+        LOG(INFO) << "Black box count: " << black_box_->records()
+                  << ", dropped: " << black_box_->dropped()
+                  << ", dumps: " << black_box_->dumps()
+                  << ", span: " << black_box_->Span() << " s";
+        black_box_->Close();
+      }
+
+#ifdef WITH_X264
+      std::size_t h264_count = h264_worker_ ?
+          h264_worker_->encoded_count() : 0;
+      if (h264_count > 0) {
+        LOG(INFO) << "H264 count: " << h264_count
+                  << ", dropped: " << h264_worker_->dropped_count()
+                  << ", ms per frame: "
+                  << (h264_worker_->encode_time() * 1000 / h264_count);
+      }
+#endif
+
       // ROS messages could not be reliably printed here, using glog instead :(
       // ros::Duration(1).sleep();  // 1s
       // https://answers.ros.org/question/35163/how-to-perform-an-action-at-nodelet-unload-shutdown/
     }
   }
 
-  ros::Time hardTimeToSoftTime(std::uint64_t _hard_time) {
-    static bool isInited = false;
-    static double soft_time_begin(0);
-    static std::uint64_t hard_time_begin(0);
-
-    if (false == isInited) {
-      soft_time_begin = ros::Time::now().toSec();
-      hard_time_begin = _hard_time;
-      isInited = true;
-    }
-
-    std::uint64_t time_ns_detal = (_hard_time - hard_time_begin);
-    std::uint64_t time_ns_detal_s = time_ns_detal / 1000000;
-    std::uint64_t time_ns_detal_ns = time_ns_detal % 1000000;
-    double time_sec_double =
-      ros::Time(time_ns_detal_s, time_ns_detal_ns * 1000).toSec();
+  template <typename M>
+  void logPoolStats(const std::string &name, const MessagePool<M> &pool) {
+    if (pool.acquisitions() == 0)
+      return;
+    LOG(INFO) << name << " messages: " << pool.acquisitions()
+              << ", allocations: " << pool.allocations()
+              << ", per frame: "
+              << (static_cast<double>(pool.allocations()) /
+                  pool.acquisitions());
+  }
 
-    return ros::Time(soft_time_begin + time_sec_double);
+  ros::Time hardTimeToSoftTime(std::uint64_t _hard_time) {
+    return soft_time_.Map(_hard_time);
   }
 
   // ros::Time hardTimeToSoftTime(std::uint64_t _hard_time) {
@@ -149,12 +228,6 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
   //       static_cast<double>(_hard_time - hard_time_begin) * 0.000001f));
   // }
 
-  inline bool is_overflow(std::uint64_t now,
-      std::uint64_t pre) {
-
-    return (now < pre) && ((pre - now) > (unit_hard_time / 2));
-  }
-
   inline bool is_repeated(std::uint64_t now,
       std::uint64_t pre) {
     return now == pre;
@@ -168,30 +241,15 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
 
   ros::Time checkUpTimeStamp(std::uint64_t _hard_time,
       const Stream &stream) {
-    static std::map<Stream, std::uint64_t> hard_time_now;
-    static std::map<Stream, std::uint64_t> acc;
-
-    if (is_overflow(_hard_time, hard_time_now[stream])) {
-      acc[stream]++;
-    }
-
-    hard_time_now[stream] = _hard_time;
-
+    TraceSpan span("unwrap", traceArg(stream));
     return hardTimeToSoftTime(
-        acc[stream] * unit_hard_time + _hard_time);
+        stream_unwrappers_.at(stream)->Unwrap(_hard_time));
   }
 
-  ros::Time checkUpImuTimeStamp(std::uint64_t _hard_time) {
-    static std::uint64_t hard_time_now(0), acc(0);
-
-    if (is_overflow(_hard_time, hard_time_now)) {
-      acc++;
-    }
-
-    hard_time_now = _hard_time;
-
-    return hardTimeToSoftTime(
-        acc * unit_hard_time + _hard_time);
+  /** Unwrap each imu sample once, the aligned samples keep the time. */
+  std::uint64_t unwrapImuTimeStamp(std::uint64_t _hard_time) {
+    TraceSpan span("unwrap", "imu");
+    return imu_unwrapper_->Unwrap(_hard_time);
   }
 
   void onInit() override {
@@ -199,7 +257,8 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     private_nh_ = getMTPrivateNodeHandle();
 
     initDevice();
-    NODELET_FATAL_COND(api_ == nullptr, "No MYNT EYE device selected :(");
+    NODELET_FATAL_COND(api_ == nullptr && virtual_device_ == nullptr,
+        "No MYNT EYE device selected :(");
 
     pthread_mutex_init(&mutex_data_, nullptr);
 
@@ -250,6 +309,22 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
       private_nh_.getParamCached(it->second + "_frame_id", frame_ids_[it->first]);
     }
 
+    // region of interest: [x, y, width, height], empty for the full frame
+    for (auto &&it = stream_names.begin(); it != stream_names.end(); ++it) {
+      std::vector<int> roi;
+      private_nh_.getParamCached(it->second + "_roi", roi);
+      if (roi.empty()) {
+        continue;
+      }
+      if (roi.size() != 4 || roi[2] <= 0 || roi[3] <= 0) {
+        NODELET_WARN_STREAM("Invalid " << it->second << "_roi, ignored");
+        continue;
+      }
+      stream_rois_[it->first] = cv::Rect(roi[0], roi[1], roi[2], roi[3]);
+      NODELET_INFO_STREAM("Crop " << it->first << " to " <<
+          stream_rois_[it->first]);
+    }
+
     imu_frame_id_ = "camera_imu_frame";
     temperature_frame_id_ = "camera_temperature_frame";
     private_nh_.getParamCached("imu_frame_id", imu_frame_id_);
@@ -262,7 +337,9 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     disparity_type_ = DisparityComputingMethod::BM;
     private_nh_.getParamCached("disparity_computing_method", tmp_disparity_type_);
     disparity_type_ = (DisparityComputingMethod)tmp_disparity_type_;
-    api_->SetDisparityComputingMethodType(disparity_type_);
+    if (api_) {
+      api_->SetDisparityComputingMethodType(disparity_type_);
+    }
 
     // device options of standard210a
     if (model_ == Model::STANDARD210A) {
@@ -330,7 +407,7 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     }
 
     for (auto &&it = option_names_.begin(); it != option_names_.end(); ++it) {
-      if (!api_->Supports(it->first))
+      if (!api_ || !api_->Supports(it->first))
         continue;
       int value = -1;
       private_nh_.getParamCached(it->second, value);
@@ -351,6 +428,7 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
         points_publisher_ = nh_.advertise<sensor_msgs::PointCloud2>(topic, 1);
       } else {  // camera
         camera_publishers_[it->first] = it_mynteye.advertiseCamera(topic, 1);
+        image_pools_.emplace(it->first, MESSAGE_POOL_SIZE);
       }
       NODELET_INFO_STREAM("Advertized on topic " << topic);
     }
@@ -365,6 +443,7 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
             it->first == Stream::RIGHT_RECTIFIED ||
             it->first == Stream::LEFT_RECTIFIED) {
           mono_publishers_[it->first] = it_mynteye.advertise(topic, 1);
+          mono_pools_.emplace(it->first, MESSAGE_POOL_SIZE);
         }
         NODELET_INFO_STREAM("Advertized on topic " << topic);
       }
@@ -408,29 +487,386 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
                         sensor_msgs::Temperature>(temperature_topic, 100);
     NODELET_INFO_STREAM("Advertized on topic " << temperature_topic);
 
+    // video and motion sources started by their consumers
+
+    private_nh_.getParamCached("sources/on_demand", sources_on_demand_);
+    private_nh_.getParamCached("sources/stop_delay", sources_stop_delay_);
+
+    // acquisition by callbacks of the SDK threads, or drained in batches
+
+    std::string acquisition_mode = "callback";
+    private_nh_.getParamCached("acquisition/mode", acquisition_mode);
+    private_nh_.getParamCached("acquisition/period", pull_period_);
+    private_nh_.getParamCached("acquisition/motion_datas", pull_motion_datas_);
+    if (acquisition_mode == "pull" && pull_period_ > 0) {
+      pull_thread_.reset(new PullThread());
+      if (virtual_device_) {
+        virtual_device_->EnableStreamDatas(4);  // as the SDK caches
+      }
+      NODELET_INFO_STREAM("Acquisition by pull every " << pull_period_
+          << " s");
+    } else if (acquisition_mode != "callback") {
+      NODELET_WARN_STREAM("Unknown acquisition/mode " << acquisition_mode
+          << ", by callback");
+    }
+
+    // real-time scheduling of the acquisition and publish threads
+
+    initRealtime();
+
+    // processed streams, see StreamGraph
+
+    private_nh_.getParamCached("graph/derive", graph_derive_);
+
     // stream toggles
 
     for (auto &&it = stream_names.begin(); it != stream_names.end(); ++it) {
       if (it->first == Stream::LEFT || it->first == Stream::RIGHT) {
         continue;  // native streams
       } else {
-        if (!api_->Supports(it->first))
+        if (!supports(it->first))
           continue;
         bool enabled = false;
         private_nh_.getParamCached("enable_" + it->second, enabled);
         if (enabled) {
-          api_->EnableStreamData(it->first);
+          enableStreamData(it->first);
+          enabled_streams_.insert(it->first);
           NODELET_INFO_STREAM("Enable stream data of " << it->first);
         }
       }
     }
 
+    // udp multicast sink
+
+    bool udp_enable = false;
+    private_nh_.getParamCached("udp_sink/enable", udp_enable);
+    if (udp_enable) {
+      std::string udp_group = "239.255.0.1";
+      std::string udp_interface = "";
+      int udp_port = 9000, udp_ttl = 1, udp_mtu = 1400;
+      std::vector<std::string> udp_streams{"left", "right"};
+      private_nh_.getParamCached("udp_sink/group", udp_group);
+      private_nh_.getParamCached("udp_sink/port", udp_port);
+      private_nh_.getParamCached("udp_sink/interface", udp_interface);
+      private_nh_.getParamCached("udp_sink/ttl", udp_ttl);
+      private_nh_.getParamCached("udp_sink/mtu", udp_mtu);
+      private_nh_.getParamCached("udp_sink/streams", udp_streams);
+      private_nh_.getParamCached("udp_sink/imu", udp_imu_);
+      udp_sink_.reset(new UdpSink());
+      if (udp_sink_->Open(
+              udp_group, udp_port, udp_interface, udp_ttl, udp_mtu)) {
+        for (auto &&name : udp_streams) {
+          for (auto &&it = stream_names.begin(); it != stream_names.end();
+               ++it) {
+            if (it->second == name && supports(it->first)) {
+              udp_streams_[it->first] = true;
+            }
+          }
+        }
+        NODELET_INFO_STREAM("Udp sink on " << udp_group << ":" << udp_port);
+      } else {
+        NODELET_ERROR_STREAM("Udp sink open failed, disabled");
+        udp_sink_.reset();
+      }
+    }
+
+    // shared memory ring
+
+    bool shm_enable = false;
+    private_nh_.getParamCached("shm_ring/enable", shm_enable);
+    if (shm_enable) {
+      std::vector<std::string> shm_streams{"left", "right"};
+      bool shm_imu = true;
+      int shm_imu_slots = 1024;
+      shm_prefix_ = "/mynteye_";
+      private_nh_.getParamCached("shm_ring/prefix", shm_prefix_);
+      private_nh_.getParamCached("shm_ring/slots", shm_slots_);
+      private_nh_.getParamCached("shm_ring/streams", shm_streams);
+      private_nh_.getParamCached("shm_ring/imu", shm_imu);
+      private_nh_.getParamCached("shm_ring/imu_slots", shm_imu_slots);
+      for (auto &&name : shm_streams) {
+        for (auto &&it = stream_names.begin(); it != stream_names.end();
+             ++it) {
+          if (it->second == name && supports(it->first)) {
+            // the ring is created on the first frame, knowing its size
+            shm_writers_[it->first].reset(new shm::RingWriter());
+            shm_names_[it->first] = name;
+          }
+        }
+      }
+      if (shm_imu) {
+        shm_imu_writer_.reset(new shm::RingWriter());
+        if (!shm_imu_writer_->Create(
+                shm_prefix_ + "imu", shm_imu_slots, sizeof(shm::ImuSample))) {
+          NODELET_ERROR_STREAM("Create shared memory " << shm_prefix_
+              << "imu failed");
+          shm_imu_writer_.reset();
+        }
+      }
+    }
+
+    // native recording
+
+    bool record_enable = false;
+    private_nh_.getParamCached("record/enable", record_enable);
+    if (record_enable) {
+      std::string record_path = "";
+      std::vector<std::string> record_streams{"left", "right"};
+      int record_chunk_size = 16, record_chunk_count = 8;
+      Recorder::Options record_options;
+      private_nh_.getParamCached("record/path", record_path);
+      private_nh_.getParamCached("record/streams", record_streams);
+      private_nh_.getParamCached("record/imu", record_imu_);
+      private_nh_.getParamCached("record/chunk_size", record_chunk_size);
+      private_nh_.getParamCached("record/chunk_count", record_chunk_count);
+      private_nh_.getParamCached("record/lz4", record_options.lz4);
+      private_nh_.getParamCached("record/direct", record_options.direct);
+      record_options.chunk_size =
+          static_cast<std::size_t>(std::max(record_chunk_size, 1)) << 20;
+      record_options.chunk_count = std::max(record_chunk_count, 2);
+      if (record_path.empty()) {
+        char name[64];
+        std::time_t now = std::time(nullptr);
+        std::strftime(name, sizeof(name), "mynteye_%Y%m%d_%H%M%S.myntrec",
+            std::localtime(&now));
+        record_path = name;
+      }
+      recorder_.reset(new Recorder());
+      if (recorder_->Open(record_path, record_options)) {
+        for (auto &&name : record_streams) {
+          for (auto &&it = stream_names.begin(); it != stream_names.end();
+               ++it) {
+            if (it->second == name && supports(it->first)) {
+              record_streams_[it->first] = true;
+            }
+          }
+        }
+        NODELET_INFO_STREAM("Recording to " << record_path);
+      } else {
+        NODELET_ERROR_STREAM("Open record " << record_path
+            << " failed, disabled");
+        recorder_.reset();
+      }
+    }
+
+    // black box, the latest records in memory dumped on a trigger
+
+    bool black_box_enable = false;
+    private_nh_.getParamCached("blackbox/enable", black_box_enable);
+    if (black_box_enable) {
+      std::vector<std::string> black_box_streams{"left", "right"};
+      int black_box_budget = 1024;
+      BlackBox::Options black_box_options;
+      private_nh_.getParamCached("blackbox/budget", black_box_budget);
+      private_nh_.getParamCached("blackbox/streams", black_box_streams);
+      private_nh_.getParamCached("blackbox/imu", black_box_imu_);
+      private_nh_.getParamCached("blackbox/seconds", black_box_seconds_);
+      private_nh_.getParamCached("blackbox/dir", black_box_dir_);
+      private_nh_.getParamCached("blackbox/lz4", black_box_options.record.lz4);
+      private_nh_.getParamCached(
+          "blackbox/direct", black_box_options.record.direct);
+      black_box_options.budget =
+          static_cast<std::size_t>(std::max(black_box_budget, 1)) << 20;
+      black_box_.reset(new BlackBox());
+      if (black_box_->Open(black_box_options)) {
+        for (auto &&name : black_box_streams) {
+          for (auto &&it = stream_names.begin(); it != stream_names.end();
+               ++it) {
+            if (it->second == name && supports(it->first)) {
+              black_box_streams_[it->first] = true;
+            }
+          }
+        }
+        black_box_service_ = nh_.advertiseService(
+            "blackbox/dump", &ROSWrapperNodelet::dumpBlackBox, this);
+        black_box_subscriber_ = nh_.subscribe<std_msgs::Empty>(
+            "blackbox/trigger", 1, [this](const std_msgs::EmptyConstPtr &) {
+              std::string path = blackBoxPath();
+              if (!black_box_->Dump(path, black_box_seconds_)) {
+                NODELET_WARN_STREAM("Black box dump to " << path
+                    << " not started, dumping or open failed");
+              }
+            });
+        NODELET_INFO_STREAM("Black box of " << (black_box_->capacity() >> 20)
+            << " MB, dump with service blackbox/dump or topic "
+            "blackbox/trigger");
+      } else {
+        NODELET_ERROR_STREAM("Black box allocation failed, disabled");
+        black_box_.reset();
+      }
+    }
+
+    // recent frames by stamp, looked up by service
+
+    bool cache_enable = false;
+    private_nh_.getParamCached("cache/enable", cache_enable);
+    if (cache_enable) {
+      std::vector<std::string> cache_streams{"left"};
+      double cache_seconds = 5;
+      int cache_max_frames = 300;
+      private_nh_.getParamCached("cache/streams", cache_streams);
+      private_nh_.getParamCached("cache/seconds", cache_seconds);
+      private_nh_.getParamCached("cache/max_frames", cache_max_frames);
+      for (auto &&name : cache_streams) {
+        for (auto &&it = stream_names.begin(); it != stream_names.end();
+             ++it) {
+          // points are no images
+          if (it->second == name && it->first != Stream::POINTS &&
+              supports(it->first)) {
+            frame_caches_[it->first].reset(new FrameCache<sensor_msgs::Image>(
+                cache_seconds, cache_max_frames));
+            cache_streams_[name] = it->first;
+          }
+        }
+      }
+      if (!cache_streams_.empty()) {
+        get_cached_frame_service_ = nh_.advertiseService(
+            "get_cached_frame", &ROSWrapperNodelet::getCachedFrame, this);
+        NODELET_INFO_STREAM("Caching " << cache_seconds << " s of "
+            << cache_streams_.size() << " streams, lookup with service "
+            "get_cached_frame");
+      }
+    }
+
+    // h264 video output
+
+    bool h264_enable = false;
+    private_nh_.getParamCached("h264/enable", h264_enable);
+    if (h264_enable) {
+#ifdef WITH_X264
+      std::string h264_topic = "left/image_h264";
+      std::string h264_stream = "left";
+      H264Encoder::Options h264_options;
+      h264_options.fps = frame_rate_;
+      private_nh_.getParamCached("h264/topic", h264_topic);
+      private_nh_.getParamCached("h264/stream", h264_stream);
+      private_nh_.getParamCached("h264/bitrate", h264_options.bitrate);
+      private_nh_.getParamCached("h264/keyint", h264_options.keyint);
+      private_nh_.getParamCached("h264/preset", h264_options.preset);
+      private_nh_.getParamCached("h264/tune", h264_options.tune);
+      for (auto &&it = stream_names.begin(); it != stream_names.end(); ++it) {
+        if (it->second == h264_stream) {
+          h264_stream_ = it->first;
+          h264_worker_.reset(new H264EncodeWorker(h264_options,
+              [this](const std::vector<std::uint8_t> &data, bool,
+                  std::uint64_t stamp) {
+                rt_publish_.Join();
+                sensor_msgs::CompressedImagePtr msg(
+                    new sensor_msgs::CompressedImage());
+                msg->header.stamp.fromNSec(stamp);
+                msg->header.frame_id = frame_ids_[h264_stream_];
+                msg->format = "h264";
+                msg->data = data;
+                h264_publisher_.publish(msg);
+              }));
+        }
+      }
+      if (h264_worker_) {
+        // new subscribers could only decode from a keyframe
+        h264_publisher_ = nh_.advertise<sensor_msgs::CompressedImage>(
+            h264_topic, 1,
+            [this](const ros::SingleSubscriberPublisher &) {
+              h264_worker_->ForceKeyframe();
+            });
+        NODELET_INFO_STREAM("Advertized on topic " << h264_topic);
+      } else {
+        NODELET_ERROR_STREAM("H264 unknown stream " << h264_stream);
+      }
+#else
+      NODELET_WARN_STREAM("H264 output needs libx264, rebuild with it");
+#endif
+    }
+
     int ros_output_framerate = -1;
     private_nh_.getParamCached("ros_output_framerate_cut", ros_output_framerate);
     if (ros_output_framerate > 0 && ros_output_framerate < 7) {
       skip_tag = ros_output_framerate;
     }
 
+    // timestamps, unwrapped per stream as each counter wraps on its own
+
+    for (auto &&it = stream_names.begin(); it != stream_names.end(); ++it) {
+      stream_unwrappers_[it->first].reset(
+          new TimestampUnwrapper(unit_hard_time));
+    }
+    imu_unwrapper_.reset(new TimestampUnwrapper(unit_hard_time));
+
+    // diagnostics
+
+    stream_names_ = stream_names;
+    for (auto &&it = stream_names.begin(); it != stream_names.end(); ++it) {
+      stream_stats_[it->first].reset(new StreamStats());
+    }
+    private_nh_.getParamCached("latency/stamp_at_end", stamp_at_end_);
+    // 0 uses the stamps as is, the mid exposure offset is uncalibrated
+    private_nh_.getParamCached("latency/exposure_unit", exposure_unit_);
+    exposure_unit_ = std::max(exposure_unit_, 0.0);
+    bool diagnostics_enable = true;
+    double diagnostics_period = 1;
+    private_nh_.getParamCached("diagnostics/enable", diagnostics_enable);
+    private_nh_.getParamCached("diagnostics/period", diagnostics_period);
+    private_nh_.getParamCached("diagnostics/threads", diagnostics_threads_);
+    if (diagnostics_enable && diagnostics_period > 0) {
+      diagnostics_publisher_ =
+          nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+      diagnostics_time_ = ros::WallTime::now();
+      if (diagnostics_threads_ > 0) {
+        ProcessStats::Sample sample;
+        process_stats_.Take(&sample);  // starts the first period
+      }
+      diagnostics_timer_ = nh_.createWallTimer(
+          ros::WallDuration(diagnostics_period),
+          &ROSWrapperNodelet::publishDiagnostics, this);
+      NODELET_INFO_STREAM("Diagnostics every " << diagnostics_period
+          << " s on topic /diagnostics");
+    }
+
+    // counters for Prometheus, scraped on their own thread
+
+    bool metrics_enable = false;
+    int metrics_port = 9464;
+    private_nh_.getParamCached("metrics/enable", metrics_enable);
+    private_nh_.getParamCached("metrics/port", metrics_port);
+    if (metrics_enable) {
+      metrics_server_.reset(new MetricsServer());
+      if (metrics_server_->Open(static_cast<std::uint16_t>(metrics_port),
+              [this]() { return renderMetrics(); })) {
+        NODELET_INFO_STREAM("Metrics on http://127.0.0.1:" << metrics_port
+            << "/metrics");
+      } else {
+        NODELET_ERROR_STREAM("Serve metrics on port " << metrics_port
+            << " failed");
+        metrics_server_.reset();
+      }
+    }
+
+    // allocations and copies per frame, on diagnostics
+
+    bool alloc_stats_enable = false;
+    private_nh_.getParamCached("alloc_stats/enable", alloc_stats_enable);
+    if (alloc_stats_enable) {
+      alloc_stats::Enable();
+      NODELET_INFO_STREAM("Counting allocations and copies per frame"
+          << (alloc_stats::HooksBuilt() ? ", operator new included" :
+              ", build WITH_ALLOC_STATS to include operator new"));
+    }
+
+    // tracing of the pipeline steps, switched by service
+
+    bool trace_enable = false;
+    int trace_buffer = 65536;
+    private_nh_.getParamCached("trace/enable", trace_enable);
+    private_nh_.getParamCached("trace/buffer", trace_buffer);
+    private_nh_.getParamCached("trace/dir", trace_dir_);
+    private_nh_.getParamCached("trace/threads", trace_threads_);
+    Tracer::Instance().SetBufferSize(trace_buffer);
+    if (trace_enable) {
+      Tracer::Instance().Reserve(trace_threads_);
+    }
+    Tracer::Instance().SetEnabled(trace_enable);
+    trace_service_ = nh_.advertiseService(
+        "trace", &ROSWrapperNodelet::trace, this);
+
     // services
 
     const std::string DEVICE_INFO_SERVICE = "get_info";
@@ -438,18 +874,315 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
         DEVICE_INFO_SERVICE, &ROSWrapperNodelet::getInfo, this);
     NODELET_INFO_STREAM("Advertized service " << DEVICE_INFO_SERVICE);
 
+    reconfigure_service_ = nh_.advertiseService(
+        "reconfigure", &ROSWrapperNodelet::reconfigure, this);
+
     publishStaticTransforms();
+    if (pull_thread_) {
+      pull_thread_->Start(pull_period_, [this]() { return pullDatas(); });
+    }
     ros::Rate loop_rate(frame_rate_);
     while (private_nh_.ok()) {
-      publishTopics();
+      {
+        std::lock_guard<std::mutex> _(device_mutex_);
+        publishTopics();
+      }
       loop_rate.sleep();
     }
   }
 
+  /**
+   * Check the policies of the thread groups on a probe thread, then lock
+   * the memory and prefault the message pools, see the rt params.
+   */
+  void initRealtime() {
+    for (auto &&group : {&rt_sdk_, &rt_imu_, &rt_publish_}) {
+      ThreadPolicy policy;
+      std::string prefix = "rt/" + group->name();
+      private_nh_.getParamCached(prefix + "/cores", policy.cores);
+      private_nh_.getParamCached(prefix + "/priority", policy.priority);
+      if (policy.empty())
+        continue;
+      // kept if the probe fails, what takes of it still applies
+      group->SetPolicy(policy);
+      std::string error;
+      if (ProbeThreadPolicy(policy, &error)) {
+        NODELET_INFO_STREAM("Threads of " << group->name() << ": "
+            << ToString(policy));
+      } else {
+        NODELET_WARN_STREAM("Threads of " << group->name() << ", "
+            << ToString(policy) << " failed: " << error);
+        rt_probe_errors_[group->name()] = error;
+      }
+    }
+
+    private_nh_.getParamCached("rt/mlockall", rt_mlockall_);
+    if (rt_mlockall_) {
+      if (LockMemory(&rt_locked_bytes_, &rt_lock_error_)) {
+        NODELET_INFO_STREAM("Memory locked, "
+            << (rt_locked_bytes_ >> 20) << " MB");
+      } else {
+        NODELET_WARN_STREAM("Lock memory failed: " << rt_lock_error_);
+      }
+    }
+
+    bool prefault = false;
+    private_nh_.getParamCached("rt/prefault", prefault);
+    if (prefault) {
+      rt_prefault_bytes_ = prefaultPools();
+      NODELET_INFO_STREAM("Message pools prefaulted, "
+          << (rt_prefault_bytes_ >> 20) << " MB");
+    }
+  }
+
+  /** Map the buffers of the message pools, sized for the stream request. */
+  std::size_t prefaultPools() {
+    StreamRequest request = virtual_device_ ?
+        virtual_device_->GetStreamRequest() : api_->GetStreamRequest();
+    // the request of the second generation is of both eyes side by side, the
+    // SDK splits each frame in halves, the virtual devices request one eye
+    int width = request.width;
+    if (!virtual_device_ && model_ != Model::STANDARD) {
+      width /= 2;
+    }
+    auto &&pixels = [this, width, &request](const Stream &stream) {
+      cv::Rect rect(0, 0, width, request.height);
+      auto &&it = stream_rois_.find(stream);
+      if (it != stream_rois_.end()) {
+        rect &= it->second;
+      }
+      return static_cast<std::size_t>(rect.area());
+    };
+    std::size_t total = 0;
+    auto &&prefill = [&total](MessagePool<sensor_msgs::Image> *pool,
+        std::size_t bytes) {
+      // zeroed, so each page is touched
+      pool->Prefill([bytes](sensor_msgs::Image *msg) {
+        msg->data.resize(bytes);
+      });
+      total += bytes * MESSAGE_POOL_SIZE;
+    };
+    for (auto &&it : image_pools_) {
+      auto &&encoding = camera_encodings_.find(it.first);
+      if (!isStreamSupported(it.first) || encoding == camera_encodings_.end())
+        continue;
+      prefill(&it.second, pixels(it.first) *
+          enc::numChannels(encoding->second) *
+          enc::bitDepth(encoding->second) / 8);
+    }
+    for (auto &&it : mono_pools_) {
+      if (isStreamSupported(it.first)) {
+        prefill(&it.second, pixels(it.first));
+      }
+    }
+    if (isStreamSupported(Stream::POINTS)) {
+      // x, y, z and rgb as floats
+      std::size_t bytes = pixels(Stream::POINTS) * 16;
+      points_pool_.Prefill([bytes](sensor_msgs::PointCloud2 *msg) {
+        msg->data.resize(bytes);
+      });
+      total += bytes * MESSAGE_POOL_SIZE;
+    }
+    return total;
+  }
+
+  /** In pull mode the SDK threads only queue, the pull thread calls back. */
+  void joinSdkThread() {
+    if (!pull_thread_) {
+      rt_sdk_.Join();
+    }
+  }
+
+  bool reconfigure(
+      mynt_eye_ros_wrapper::Reconfigure::Request &req,     // NOLINT
+      mynt_eye_ros_wrapper::Reconfigure::Response &res) {  // NOLINT
+    res.success = false;
+    if (!api_) {
+      res.message = "virtual device, nothing to configure";
+      return true;
+    }
+    // checked before the sources stop, so a bad request changes nothing
+    auto &&requests = api_->GetStreamRequests();
+    if (req.request_index >= static_cast<int>(requests.size())) {
+      res.message = "request_index out of range";
+      return true;
+    }
+    if (req.option_names.size() != req.option_values.size()) {
+      res.message = "option_names and option_values differ in size";
+      return true;
+    }
+    std::vector<std::pair<Option, std::int32_t>> options;
+    for (std::size_t i = 0; i < req.option_names.size(); i++) {
+      auto &&name = req.option_names[i];
+      auto &&it = std::find_if(option_names_.begin(), option_names_.end(),
+          [&name](const std::pair<const Option, std::string> &option) {
+            auto &&param = option.second;
+            return param == name ||
+                param.substr(param.find('/') + 1) == name;
+          });
+      if (it == option_names_.end() || !api_->Supports(it->first)) {
+        res.message = "option " + name + " not supported";
+        return true;
+      }
+      options.emplace_back(it->first, req.option_values[i]);
+    }
+
+    std::lock_guard<std::mutex> _(device_mutex_);
+    ros::WallTime time_beg = ros::WallTime::now();
+    if (video_source_.started || motion_source_.started) {
+      api_->Stop(Source::ALL);
+    }
+    int request_index = request_index_;
+    if (req.request_index >= 0) {
+      api_->ConfigStreamRequest(requests[req.request_index]);
+      request_index = req.request_index;
+    }
+    for (auto &&option : options) {
+      api_->SetOptionValue(option.first, option.second);
+      NODELET_INFO_STREAM("Reconfigure " << option.first << " to "
+          << api_->GetOptionValue(option.first));
+    }
+    auto &&request = api_->GetStreamRequest();
+    frame_rate_ = model_ == Model::STANDARD ?
+        api_->GetOptionValue(Option::FRAME_RATE) : request.fps;
+    setRequestMode(request_index, request.width, request.height);
+    refreshStreamRequest();
+    if (video_source_.started) {
+      startSource(Source::VIDEO_STREAMING);
+    }
+    if (motion_source_.started) {
+      startSource(Source::MOTION_TRACKING);
+    }
+
+    res.success = true;
+    res.request_index = request_index_;
+    res.width = request.width;
+    res.height = request.height;
+    res.fps = frame_rate_;
+    res.seconds = (ros::WallTime::now() - time_beg).toSec();
+    NODELET_INFO_STREAM("Reconfigured to request " << request_index_ << ", "
+        << request.width << "x" << request.height << " at " << frame_rate_
+        << " fps, stopped for " << res.seconds << " s");
+    return true;
+  }
+
+  /** Stream request as the diagnostics and the metrics report it. */
+  struct RequestMode {
+    int index;
+    /** e.g. "640x400@30" */
+    std::string mode;
+  };
+
+  /** Set while holding device_mutex_, or before the node runs. */
+  void setRequestMode(int index, int width, int height) {
+    std::ostringstream mode;
+    mode << width << "x" << height << "@" << frame_rate_;
+    request_index_ = index;
+    request_mode_ = mode.str();
+  }
+
+  /** A snapshot, not torn by a reconfigure. */
+  RequestMode requestMode() {
+    std::lock_guard<std::mutex> _(device_mutex_);
+    return {request_index_, request_mode_};
+  }
+
+  /** Drop what depends on the stream request, while the sources stop. */
+  void refreshStreamRequest() {
+    camera_info_ptrs_.clear();
+    computeRectTransforms();
+    for (auto &&it : frame_caches_) {
+      it.second->Clear();
+    }
+  }
+
+  bool getCachedFrame(
+      mynt_eye_ros_wrapper::GetCachedFrame::Request &req,     // NOLINT
+      mynt_eye_ros_wrapper::GetCachedFrame::Response &res) {  // NOLINT
+    auto &&it = cache_streams_.find(req.stream);
+    if (it == cache_streams_.end()) {
+      res.success = false;
+      return true;
+    }
+    auto &&msg = frame_caches_[it->second]->Nearest(req.stamp);
+    res.success = msg != nullptr;
+    if (msg) {
+      res.image = *msg;
+    }
+    return true;
+  }
+
+  bool dumpBlackBox(
+      mynt_eye_ros_wrapper::DumpBlackBox::Request &req,     // NOLINT
+      mynt_eye_ros_wrapper::DumpBlackBox::Response &res) {  // NOLINT
+    res.path = req.path.empty() ? blackBoxPath() : req.path;
+    res.success = black_box_->Dump(
+        res.path, req.seconds > 0 ? req.seconds : black_box_seconds_);
+    return true;
+  }
+
+  bool trace(
+      mynt_eye_ros_wrapper::Trace::Request &req,     // NOLINT
+      mynt_eye_ros_wrapper::Trace::Response &res) {  // NOLINT
+    using Request = mynt_eye_ros_wrapper::Trace::Request;
+    auto &&tracer = Tracer::Instance();
+    switch (req.action) {
+      case Request::START:
+        tracer.Reserve(trace_threads_);
+        tracer.SetEnabled(true);
+        res.success = true;
+        break;
+      case Request::STOP:
+        tracer.SetEnabled(false);
+        res.success = true;
+        break;
+      case Request::DUMP:
+        res.path = req.path.empty() ? tracePath() : req.path;
+        res.spans = tracer.Dump(res.path);
+        res.success = res.spans >= 0;
+        NODELET_INFO_STREAM("Trace of " << res.spans << " spans to "
+            << res.path << ", dropped: " << tracer.dropped());
+        break;
+      default:
+        NODELET_WARN_STREAM("Trace action " << req.action << " not exist");
+        return false;
+    }
+    return true;
+  }
+
+  std::string tracePath() {
+    char name[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(name, sizeof(name), "mynteye_trace_%Y%m%d_%H%M%S.json",
+        std::localtime(&now));
+    if (trace_dir_.empty())
+      return name;
+    return trace_dir_ + "/" + name;
+  }
+
+  /** Stream of a span, only looked up while tracing. */
+  const char *traceArg(const Stream &stream) {
+    return Tracer::Instance().enabled() ?
+        stream_names_.at(stream).c_str() : nullptr;
+  }
+
+  std::string blackBoxPath() {
+    char name[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(name, sizeof(name), "mynteye_blackbox_%Y%m%d_%H%M%S.myntrec",
+        std::localtime(&now));
+    if (black_box_dir_.empty())
+      return name;
+    return black_box_dir_ + "/" + name;
+  }
+
   bool getInfo(
       mynt_eye_ros_wrapper::GetInfo::Request &req,     // NOLINT
       mynt_eye_ros_wrapper::GetInfo::Response &res) {  // NOLINT
     using Request = mynt_eye_ros_wrapper::GetInfo::Request;
+    if (!api_) {
+      return false;  // no device info of a virtual device
+    }
     switch (req.key) {
       case Request::DEVICE_NAME:
         res.value = api_->GetInfo(Info::DEVICE_NAME);
@@ -486,83 +1219,13 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
         auto intri_left = api_->GetIntrinsicsBase(Stream::LEFT);
         auto calib_model = intri_left->calib_model();
         if (calib_model == CalibrationModel::PINHOLE) {
-          auto intri_left =
-              api_->GetIntrinsics<IntrinsicsPinhole>(Stream::LEFT);
-          auto intri_right =
-              api_->GetIntrinsics<IntrinsicsPinhole>(Stream::RIGHT);
-          Config intrinsics{
-            {"calib_model", "pinhole"},
-            {"left", {
-              {"width", intri_left.width},
-              {"height", intri_left.height},
-              {"fx", intri_left.fx},
-              {"fy", intri_left.fy},
-              {"cx", intri_left.cx},
-              {"cy", intri_left.cy},
-              {"model", intri_left.model},
-              {"coeffs", Config::array(
-                  {intri_left.coeffs[0],
-                   intri_left.coeffs[1],
-                   intri_left.coeffs[2],
-                   intri_left.coeffs[3],
-                   intri_left.coeffs[4]})}
-            }},
-            {"right", {
-              {"width", intri_right.width},
-              {"height", intri_right.height},
-              {"fx", intri_right.fx},
-              {"fy", intri_right.fy},
-              {"cx", intri_right.cx},
-              {"cy", intri_right.cy},
-              {"model", intri_right.model},
-              {"coeffs", Config::array(
-                  {intri_right.coeffs[0],
-                   intri_right.coeffs[1],
-                   intri_right.coeffs[2],
-                   intri_right.coeffs[3],
-                   intri_right.coeffs[4]})}
-            }}
-          };
-          std::string json = dump_string(intrinsics, configuru::JSON);
-          res.value = json;
+          res.value = ToJson(
+              api_->GetIntrinsics<IntrinsicsPinhole>(Stream::LEFT),
+              api_->GetIntrinsics<IntrinsicsPinhole>(Stream::RIGHT));
         } else if (calib_model == CalibrationModel::KANNALA_BRANDT) {
-          auto intri_left =
-              api_->GetIntrinsics<IntrinsicsEquidistant>(Stream::LEFT);
-          auto intri_right =
-              api_->GetIntrinsics<IntrinsicsEquidistant>(Stream::RIGHT);
-          Config intrinsics{
-            {"calib_model", "kannala_brandt"},
-            {"left", {
-              {"width", intri_left.width},
-              {"height", intri_left.height},
-              {"coeffs", Config::array(
-                  {intri_left.coeffs[0],
-                   intri_left.coeffs[1],
-                   intri_left.coeffs[2],
-                   intri_left.coeffs[3],
-                   intri_left.coeffs[4],
-                   intri_left.coeffs[5],
-                   intri_left.coeffs[6],
-                   intri_left.coeffs[7]})
-              }
-            }},
-            {"right", {
-              {"width", intri_right.width},
-              {"height", intri_right.height},
-              {"coeffs", Config::array(
-                  {intri_right.coeffs[0],
-                   intri_right.coeffs[1],
-                   intri_right.coeffs[2],
-                   intri_right.coeffs[3],
-                   intri_right.coeffs[4],
-                   intri_right.coeffs[5],
-                   intri_right.coeffs[6],
-                   intri_right.coeffs[7]})
-              }
-            }}
-          };
-          std::string json = dump_string(intrinsics, configuru::JSON);
-          res.value = json;
+          res.value = ToJson(
+              api_->GetIntrinsics<IntrinsicsEquidistant>(Stream::LEFT),
+              api_->GetIntrinsics<IntrinsicsEquidistant>(Stream::RIGHT));
         } else {
           NODELET_INFO_STREAM("INVALID CALIB INTRINSICS" << calib_model);
           res.value = "null";
@@ -570,57 +1233,14 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
       }
       break;
       case Request::IMG_EXTRINSICS_RTOL:
-      {
-        auto extri = api_->GetExtrinsics(Stream::RIGHT, Stream::LEFT);
-        Config extrinsics{
-          {"rotation",     Config::array({extri.rotation[0][0], extri.rotation[0][1], extri.rotation[0][2],   // NOLINT
-                                          extri.rotation[1][0], extri.rotation[1][1], extri.rotation[1][2],   // NOLINT
-                                          extri.rotation[2][0], extri.rotation[2][1], extri.rotation[2][2]})},// NOLINT
-          {"translation",  Config::array({extri.translation[0], extri.translation[1], extri.translation[2]})} // NOLINT
-        };
-        std::string json = dump_string(extrinsics, configuru::JSON);
-        res.value = json;
-      }
-      break;
+        res.value = ToJson(api_->GetExtrinsics(Stream::RIGHT, Stream::LEFT));
+        break;
       case Request::IMU_INTRINSICS:
-      {
-        bool is_ok;
-        auto intri = api_->GetMotionIntrinsics();
-        Config intrinsics {
-          {"accel", {
-            {"scale",     Config::array({ intri.accel.scale[0][0], intri.accel.scale[0][1],  intri.accel.scale[0][2],   // NOLINT
-                                          intri.accel.scale[1][0], intri.accel.scale[1][1],  intri.accel.scale[1][2],   // NOLINT
-                                          intri.accel.scale[2][0], intri.accel.scale[2][1],  intri.accel.scale[2][2]})},// NOLINT
-            {"drift",     Config::array({ intri.accel.drift[0],    intri.accel.drift[1],     intri.accel.drift[2]})}, // NOLINT
-            {"noise",     Config::array({ intri.accel.noise[0],    intri.accel.noise[1],     intri.accel.noise[2]})}, // NOLINT
-            {"bias",      Config::array({ intri.accel.bias[0],     intri.accel.bias[1],      intri.accel.bias[2]})} // NOLINT
-          }},
-          {"gyro", {
-            {"scale",     Config::array({ intri.gyro.scale[0][0], intri.gyro.scale[0][1],  intri.gyro.scale[0][2],   // NOLINT
-                                          intri.gyro.scale[1][0], intri.gyro.scale[1][1],  intri.gyro.scale[1][2],   // NOLINT
-                                          intri.gyro.scale[2][0], intri.gyro.scale[2][1],  intri.gyro.scale[2][2]})},// NOLINT
-            {"drift",     Config::array({ intri.gyro.drift[0],    intri.gyro.drift[1],     intri.gyro.drift[2]})}, // NOLINT
-            {"noise",     Config::array({ intri.gyro.noise[0],    intri.gyro.noise[1],     intri.gyro.noise[2]})}, // NOLINT
-            {"bias",      Config::array({ intri.gyro.bias[0],     intri.gyro.bias[1],      intri.gyro.bias[2]})} // NOLINT
-          }}
-        };
-        std::string json = dump_string(intrinsics, JSON);
-        res.value = json;
-      }
-      break;
+        res.value = ToJson(api_->GetMotionIntrinsics());
+        break;
       case Request::IMU_EXTRINSICS:
-      {
-        auto extri = api_->GetMotionExtrinsics(Stream::LEFT);
-        Config extrinsics{
-          {"rotation",     Config::array({extri.rotation[0][0], extri.rotation[0][1], extri.rotation[0][2],   // NOLINT
-                                          extri.rotation[1][0], extri.rotation[1][1], extri.rotation[1][2],   // NOLINT
-                                          extri.rotation[2][0], extri.rotation[2][1], extri.rotation[2][2]})},// NOLINT
-          {"translation",  Config::array({extri.translation[0], extri.translation[1], extri.translation[2]})} // NOLINT
-        };
-        std::string json = dump_string(extrinsics, configuru::JSON);
-        res.value = json;
-      }
-      break;
+        res.value = ToJson(api_->GetMotionExtrinsics(Stream::LEFT));
+        break;
       default:
         NODELET_WARN_STREAM("Info of key " << req.key << " not exist");
         return false;
@@ -628,6 +1248,327 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     return true;
   }
 
+  void arriveFrame(
+      const Stream &stream, const api::StreamData &data, ros::Time stamp) {
+    auto &&stats = stream_stats_.at(stream);
+    // as received, e.g. yuyv, or as processed
+    stats->Receive(data.frame_raw ? data.frame_raw->size() :
+        data.frame.total() * data.frame.elemSize());
+    if (stream == Stream::LEFT || stream == Stream::RIGHT) {
+      // raw, as delivered by the device
+      raw_frame_ids_.Add(data.img->frame_id);
+      stats->Arrive(data.img->frame_id);
+    } else {
+      stats->Arrive(data.img->frame_id, &raw_frame_ids_);
+    }
+    stats->RecordArrival((ros::Time::now() - stamp).toNSec() / 1000);
+  }
+
+  void publishDiagnostics(const ros::WallTimerEvent &) {
+    ros::WallTime now = ros::WallTime::now();
+    double elapsed = (now - diagnostics_time_).toSec();
+    diagnostics_time_ = now;
+    if (elapsed <= 0)
+      return;
+#ifdef WITH_X264
+    if (h264_worker_) {
+      // dropped by the encoder queue
+      std::size_t dropped = h264_worker_->dropped_count();
+      stream_stats_.at(h264_stream_)->Drop(
+          StreamStats::LOSS_PUBLISH, dropped - h264_dropped_);
+      h264_dropped_ = dropped;
+    }
+#endif
+    RequestMode request = requestMode();
+    diagnostic_msgs::DiagnosticArray msg;
+    msg.header.stamp = ros::Time::now();
+    for (auto &&it : stream_stats_) {
+      std::ostringstream name;
+      name << it.first;
+      addDiagnostics(name.str(), it.second.get(), request, elapsed, &msg);
+    }
+    addDiagnostics("imu", &imu_stats_, request, elapsed, &msg);
+    if (pull_thread_) {
+      addAcquisitionDiagnostics(elapsed, &msg);
+    }
+    addRealtimeDiagnostics(&msg);
+    if (diagnostics_threads_ > 0) {
+      addProcessDiagnostics(&msg);
+    }
+    if (!msg.status.empty()) {
+      diagnostics_publisher_.publish(msg);
+    }
+  }
+
+  void addProcessDiagnostics(diagnostic_msgs::DiagnosticArray *msg) {
+    ProcessStats::Sample sample;
+    if (!process_stats_.Take(&sample))
+      return;
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "mynteye: process";
+    status.hardware_id = "mynteye";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+    if (!sample.threads.empty() && sample.threads[0].cpu > 0.9) {
+      // one core for a thread, it falls behind
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "thread " + sample.threads[0].name + " (" +
+          std::to_string(sample.threads[0].tid) + ") saturates a core";
+    }
+    addDiagnosticsValue(&status, "cpu %", sample.cpu * 100);
+    addDiagnosticsValue(&status, "rss MB",
+        static_cast<double>(sample.rss_bytes) / (1 << 20));
+    addDiagnosticsValue(&status, "threads", sample.threads.size());
+    int count = std::min<int>(diagnostics_threads_, sample.threads.size());
+    for (int i = 0; i < count; i++) {
+      auto &&thread = sample.threads[i];
+      addDiagnosticsValue(&status, "cpu % of " + thread.name + " (" +
+          std::to_string(thread.tid) + ")", thread.cpu * 100);
+    }
+    msg->status.push_back(status);
+  }
+
+  void addAcquisitionDiagnostics(
+      double elapsed, diagnostic_msgs::DiagnosticArray *msg) {
+    std::uint64_t ticks = pull_thread_->ticks() - pull_ticks_;
+    pull_ticks_ = pull_thread_->ticks();
+    std::uint64_t samples = pull_thread_->samples() - pull_samples_;
+    pull_samples_ = pull_thread_->samples();
+    auto &&lateness = pull_thread_->lateness().TakeSummary();
+    std::uint64_t max_samples = pull_thread_->TakeMaxSamples();
+    if (ticks == 0)
+      return;
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "mynteye: acquisition";
+    status.hardware_id = "mynteye";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "pull";
+    if (lateness.max > pull_period_ * 1000) {
+      // the samples of the missed ticks wait for the next
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "pull ticks late by more than a period";
+    }
+    addDiagnosticsValue(&status, "ticks/s", ticks / elapsed);
+    addDiagnosticsValue(&status, "imu per tick",
+        static_cast<double>(samples) / ticks);
+    addDiagnosticsValue(&status, "imu max per tick", max_samples);
+    addDiagnosticsValue(&status, "late p50 ms", lateness.p50);
+    addDiagnosticsValue(&status, "late p99 ms", lateness.p99);
+    addDiagnosticsValue(&status, "late max ms", lateness.max);
+    msg->status.push_back(status);
+  }
+
+  void addRealtimeDiagnostics(diagnostic_msgs::DiagnosticArray *msg) {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "mynteye: realtime";
+    status.hardware_id = "mynteye";
+    std::string error;
+    for (auto &&group : {&rt_sdk_, &rt_imu_, &rt_publish_}) {
+      if (group->policy().empty())
+        continue;
+      diagnostic_msgs::KeyValue kv;
+      kv.key = group->name();
+      kv.value = ToString(group->policy());
+      status.values.push_back(kv);
+      addDiagnosticsValue(&status, group->name() + " threads",
+          group->threads());
+      addDiagnosticsValue(&status, group->name() + " failed",
+          group->failures());
+      auto &&probe = rt_probe_errors_.find(group->name());
+      if (group->failures() > 0) {
+        error = group->name() + ": " + group->last_error();
+      } else if (group->threads() == 0 && probe != rt_probe_errors_.end()) {
+        error = group->name() + ": " + probe->second;
+      }
+    }
+    if (rt_mlockall_) {
+      addDiagnosticsValue(&status, "locked MB",
+          static_cast<double>(rt_locked_bytes_) / (1 << 20));
+      if (!rt_lock_error_.empty()) {
+        error = rt_lock_error_;
+      }
+    }
+    if (rt_prefault_bytes_ > 0) {
+      addDiagnosticsValue(&status, "prefaulted MB",
+          static_cast<double>(rt_prefault_bytes_) / (1 << 20));
+    }
+    if (status.values.empty())
+      return;
+    if (error.empty()) {
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "OK";
+    } else {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = error;
+    }
+    msg->status.push_back(status);
+  }
+
+  static void addDiagnosticsValue(diagnostic_msgs::DiagnosticStatus *status,
+      const std::string &key, double value) {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3) << value;
+    diagnostic_msgs::KeyValue kv;
+    kv.key = key;
+    kv.value = ss.str();
+    status->values.push_back(kv);
+  }
+
+  void addDiagnostics(const std::string &name, StreamStats *stats,
+      const RequestMode &request, double elapsed,
+      diagnostic_msgs::DiagnosticArray *msg) {
+    auto &&counts = diagnostics_counts_[name];
+    std::uint64_t frames = stats->frames() - counts.frames;
+    counts.frames = stats->frames();
+    std::uint64_t bytes = stats->bytes() - counts.bytes;
+    counts.bytes = stats->bytes();
+    std::uint64_t drops = 0;
+    std::uint64_t loss_drops[StreamStats::LOSS_LAST];
+    for (int i = 0; i < StreamStats::LOSS_LAST; i++) {
+      auto loss = static_cast<StreamStats::Loss>(i);
+      loss_drops[i] = stats->drops(loss) - counts.drops[i];
+      counts.drops[i] = stats->drops(loss);
+      drops += loss_drops[i];
+    }
+    if (frames == 0 && drops == 0)
+      return;
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "mynteye: " + name;
+    status.hardware_id = "mynteye";
+    if (drops > 0) {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      std::ostringstream message;
+      message << drops << " dropped (";
+      for (int i = 0; i < StreamStats::LOSS_LAST; i++) {
+        message << (i > 0 ? ", " : "")
+                << StreamStats::LossName(static_cast<StreamStats::Loss>(i))
+                << " " << loss_drops[i];
+      }
+      message << ")";
+      status.message = message.str();
+    } else {
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "OK";
+    }
+    auto add = [&status](const std::string &key, double value) {
+      addDiagnosticsValue(&status, key, value);
+    };
+    add("fps", frames / elapsed);
+    add("request index", request.index);
+    diagnostic_msgs::KeyValue mode;
+    mode.key = "request mode";
+    mode.value = request.mode;
+    status.values.push_back(mode);
+    if (bytes > 0) {
+      add("MB/s", bytes / elapsed / (1 << 20));
+    }
+    add("drops", drops);
+    for (int i = 0; i < StreamStats::LOSS_LAST; i++) {
+      add(std::string("drops ") +
+          StreamStats::LossName(static_cast<StreamStats::Loss>(i)),
+          loss_drops[i]);
+    }
+    if (alloc_stats::Enabled() && frames > 0) {
+      for (int i = 0; i < StreamStats::ALLOC_LAST; i++) {
+        auto path = static_cast<StreamStats::AllocPath>(i);
+        auto &&allocs = stats->TakeAllocs(path);
+        std::string key = StreamStats::AllocPathName(path);
+        add(key + " allocs per frame",
+            static_cast<double>(allocs.allocations) / frames);
+        add(key + " alloc KB per frame",
+            allocs.allocated_bytes / 1024.0 / frames);
+        add(key + " copy KB per frame",
+            allocs.copied_bytes / 1024.0 / frames);
+      }
+    }
+    for (int i = 0; i < StreamStats::STAGE_LAST; i++) {
+      auto stage = static_cast<StreamStats::Stage>(i);
+      auto &&summary = stats->latency(stage).TakeSummary();
+      if (summary.count == 0)
+        continue;
+      std::string key = StreamStats::StageName(stage);
+      add(key + " p50 ms", summary.p50);
+      add(key + " p90 ms", summary.p90);
+      add(key + " p99 ms", summary.p99);
+      add(key + " max ms", summary.max);
+      if (stage == StreamStats::STAGE_GLASS && exposure_unit_ <= 0) {
+        diagnostic_msgs::KeyValue glass;
+        glass.key = key + " offset";
+        glass.value = "uncalibrated until latency/exposure_unit is set";
+        status.values.push_back(glass);
+      }
+    }
+    msg->status.push_back(status);
+  }
+
+  /** On the metrics thread, reads the atomic counters only. */
+  std::string renderMetrics() {
+    std::vector<std::pair<std::string, StreamStats *>> streams;
+    for (auto &&it : stream_stats_) {
+      if (it.second->frames() > 0 || it.second->drops() > 0) {
+        streams.emplace_back(stream_names_.at(it.first), it.second.get());
+      }
+    }
+    streams.emplace_back("imu", &imu_stats_);
+
+    MetricsText text;
+    text.Family("mynteye_frames_total", "counter",
+        "Frames at the callbacks, the fps is its rate");
+    for (auto &&it : streams) {
+      text.Sample("mynteye_frames_total", {{"stream", it.first}},
+          it.second->frames());
+    }
+    text.Family("mynteye_received_bytes_total", "counter",
+        "Bytes of the frames as received");
+    for (auto &&it : streams) {
+      text.Sample("mynteye_received_bytes_total", {{"stream", it.first}},
+          it.second->bytes());
+    }
+    text.Family("mynteye_drops_total", "counter",
+        "Frames lost, by where they were lost");
+    for (auto &&it : streams) {
+      for (int i = 0; i < StreamStats::LOSS_LAST; i++) {
+        auto loss = static_cast<StreamStats::Loss>(i);
+        text.Sample("mynteye_drops_total",
+            {{"stream", it.first}, {"loss", StreamStats::LossName(loss)}},
+            it.second->drops(loss));
+      }
+    }
+    text.Family("mynteye_latency_seconds", "histogram",
+        "Latency of the pipeline stages");
+    for (auto &&it : streams) {
+      for (int i = 0; i < StreamStats::STAGE_LAST; i++) {
+        auto stage = static_cast<StreamStats::Stage>(i);
+        text.Histogram("mynteye_latency_seconds",
+            {{"stream", it.first}, {"stage", StreamStats::StageName(stage)}},
+            it.second->latency(stage));
+      }
+    }
+    text.Family("mynteye_clock_offset_seconds", "gauge",
+        "Host time at the last callback minus the frame stamp, its trend is "
+        "the drift of the device clock");
+    for (auto &&it : streams) {
+      text.Sample("mynteye_clock_offset_seconds", {{"stream", it.first}},
+          it.second->clock_offset() / 1e6);
+    }
+    RequestMode request = requestMode();
+    text.Family("mynteye_request_index", "gauge",
+        "Stream request of the device, the latencies depend on its mode");
+    text.Sample("mynteye_request_index", {{"mode", request.mode}},
+        request.index);
+    text.Family("mynteye_queue_depth", "gauge",
+        "Items waiting, callbacks for the conversion lock or chunks for the "
+        "disk");
+    text.Sample("mynteye_queue_depth", {{"queue", "convert"}},
+        convert_waiting_);
+    if (recorder_) {
+      text.Sample("mynteye_queue_depth", {{"queue", "record"}},
+          recorder_->queued_chunks());
+    }
+    return text.str();
+  }
+
   void publishData(
       const Stream &stream, const api::StreamData &data, std::uint32_t seq,
       ros::Time stamp) {
@@ -654,47 +1595,290 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     return -1;
   }
 
-  void publishOthers(const Stream &stream) {
-    if ((getStreamSubscribers(stream) > 0 && !is_published_[stream]) ||
-        mono_publishers_[stream].getNumSubscribers() > 0) {
-      api_->EnableStreamData(stream);
-      api_->SetStreamCallback(
-          stream, [this, stream](const api::StreamData &data) {
-            ros::Time stamp = checkUpTimeStamp(
-                data.img->timestamp, stream);
-            static std::size_t count = 0;
-            ++count;
-            publishData(stream, data, count, stamp);
-          });
-      is_published_[stream] = true;
+  bool isUdpStream(const Stream &stream) {
+    return udp_sink_ && udp_streams_.find(stream) != udp_streams_.end();
+  }
+
+  /** False if the frame was lost, as the other sinks. */
+  bool publishUdp(const Stream &stream, const api::StreamData &data) {
+    if (!isUdpStream(stream) || data.frame.empty())
+      return true;
+    cv::Mat frame = cropFrame(stream, data.frame);
+    alloc_stats::CountCopy(frame.total() * frame.elemSize());
+    return udp_sink_->SendImage(
+        static_cast<std::uint8_t>(stream),
+        data.img ? data.img->timestamp : 0, data.img ? data.img->frame_id : 0,
+        frame.cols, frame.rows, frame.type(), frame.cols * frame.elemSize(),
+        frame.data, frame.step);
+  }
+
+  bool isH264Subscribed(const Stream &stream) {
+#ifdef WITH_X264
+    return h264_worker_ && h264_stream_ == stream &&
+        h264_publisher_.getNumSubscribers() > 0;
+#else
+    return false;
+#endif
+  }
+
+  void publishH264(const Stream &stream, const api::StreamData &data,
+      ros::Time stamp) {
+#ifdef WITH_X264
+    if (!isH264Subscribed(stream) || data.frame.empty())
       return;
+    // encoded on the worker, the raw frame keeps the memory alive
+    h264_worker_->Push(
+        cropFrame(stream, data.frame), data.frame_raw, stamp.toNSec());
+#endif
+  }
+
+  bool isShmStream(const Stream &stream) {
+    return shm_writers_.find(stream) != shm_writers_.end();
+  }
+
+  bool publishShm(const Stream &stream, const api::StreamData &data) {
+    if (!isShmStream(stream) || data.frame.empty())
+      return true;
+    cv::Mat frame = cropFrame(stream, data.frame);
+    std::size_t row_bytes = frame.cols * frame.elemSize();
+    std::size_t bytes = row_bytes * frame.rows;
+    auto &&writer = shm_writers_[stream];
+    if (writer->slot_size() < bytes) {
+      // created on the first frame, readers reopen if it is recreated
+      std::string name = shm_prefix_ + shm_names_[stream];
+      if (!writer->Create(name, shm_slots_, bytes)) {
+        NODELET_ERROR_STREAM_THROTTLE(
+            10, "Create shared memory " << name << " failed");
+        return false;
+      }
+      NODELET_INFO_STREAM("Shared memory ring " << name << ", slots: "
+          << shm_slots_ << ", slot size: " << bytes);
     }
+    shm::SlotMeta meta{};
+    meta.type = shm::SLOT_IMAGE;
+    meta.stream = static_cast<std::uint8_t>(stream);
+    meta.timestamp = data.img ? data.img->timestamp : 0;
+    meta.frame_id = data.img ? data.img->frame_id : 0;
+    meta.width = frame.cols;
+    meta.height = frame.rows;
+    meta.cv_type = frame.type();
+    alloc_stats::CountCopy(bytes);
+    return writer->Write(meta, frame.data, row_bytes, frame.rows, frame.step);
+  }
+
+  bool isRecordStream(const Stream &stream) {
+    return recorder_ && record_streams_.find(stream) != record_streams_.end();
+  }
+
+  bool publishRecord(const Stream &stream, const api::StreamData &data) {
+    if (!isRecordStream(stream) || data.frame.empty())
+      return true;
+    return writeRecordImage(recorder_.get(), stream, data);
+  }
+
+  bool isBlackBoxStream(const Stream &stream) {
+    return black_box_ &&
+        black_box_streams_.find(stream) != black_box_streams_.end();
+  }
+
+  bool publishBlackBox(const Stream &stream, const api::StreamData &data) {
+    if (!isBlackBoxStream(stream) || data.frame.empty())
+      return true;
+    return writeRecordImage(black_box_.get(), stream, data);
+  }
+
+  /** Write to a Recorder or a BlackBox. */
+  template <typename Writer>
+  bool writeRecordImage(
+      Writer *writer, const Stream &stream, const api::StreamData &data) {
+    record::RecordHeader header{};
+    header.stream = static_cast<std::uint8_t>(stream);
+    if (data.img) {
+      header.frame_id = data.img->frame_id;
+      header.timestamp = data.img->timestamp;
+      header.exposure_time = data.img->exposure_time;
+      header.is_ets = data.img->is_ets;
+    }
+    auto &&raw = data.frame_raw;
+    if (raw && raw->width() == data.frame.cols &&
+        raw->height() == data.frame.rows) {
+      // the raw buffer, e.g. yuyv is smaller than the converted bgr
+      std::size_t row_bytes = raw->size() / raw->height();
+      header.format = static_cast<std::uint32_t>(raw->format());
+      header.width = raw->width();
+      header.height = raw->height();
+      alloc_stats::CountCopy(raw->size());
+      return writer->WriteImage(
+          header, raw->data(), row_bytes, raw->height(), row_bytes);
+    } else {
+      const cv::Mat &frame = data.frame;
+      header.cv_type = frame.type();
+      header.width = frame.cols;
+      header.height = frame.rows;
+      alloc_stats::CountCopy(frame.total() * frame.elemSize());
+      return writer->WriteImage(header, frame.data,
+          frame.cols * frame.elemSize(), frame.rows, frame.step);
+    }
+  }
+
+  bool isSinkStream(const Stream &stream) {
+    return isUdpStream(stream) || isShmStream(stream) ||
+        isRecordStream(stream) || isBlackBoxStream(stream) ||
+        isCacheStream(stream);
+  }
 
-    int disable_tag = 0;
-    api_->DisableStreamData(stream, [&](const Stream &stream) {
-            disable_tag += getStreamSubscribers(stream);
-          }, true);
-    if (disable_tag == 0 && is_published_[stream]) {
-      api_->DisableStreamData(stream, [&](const Stream &stream) {
-            api_->SetStreamCallback(stream, nullptr);
-            is_published_[stream] = false;
+  bool isCacheStream(const Stream &stream) {
+    return frame_caches_.find(stream) != frame_caches_.end();
+  }
+
+  void publishSinks(const Stream &stream, const api::StreamData &data) {
+    TraceSpan span("sinks", traceArg(stream));
+    bool ok = publishUdp(stream, data);
+    ok = publishShm(stream, data) && ok;
+    ok = publishRecord(stream, data) && ok;
+    ok = publishBlackBox(stream, data) && ok;
+    if (!ok) {
+      stream_stats_.at(stream)->Drop(StreamStats::LOSS_PUBLISH);
+    }
+  }
+
+  /** A subscriber or sink of the stream. */
+  bool isStreamWanted(const Stream &stream) {
+    return getStreamSubscribers(stream) > 0 ||
+        mono_publishers_[stream].getNumSubscribers() > 0 ||
+        isSinkStream(stream) || isH264Subscribed(stream);
+  }
+
+  bool isStreamSupported(const Stream &stream) {
+    return !virtual_device_ || virtual_device_->Supports(stream);
+  }
+
+  /**
+   * Enable the fewest streams in the SDK for the wanted processed streams,
+   * see StreamGraph, and disable those no longer needed.
+   */
+  void updateStreamGraph() {
+    std::set<Stream> wanted;
+    for (auto &&stream : StreamGraph::Processed()) {
+      if (isStreamSupported(stream) && isStreamWanted(stream))
+        wanted.insert(stream);
+    }
+    auto &&plan = StreamGraph::Resolve(wanted, enabled_streams_,
+        graph_derive_, canReproject(),
+        [this](const Stream &stream) { return isStreamSupported(stream); });
+    if (plan == stream_plan_)
+      return;
+
+    // read by the callbacks, new ones publish from their first frame
+    published_streams_ = StreamBits(plan.published);
+    derived_streams_ = StreamBits(plan.derived);
+    for (auto &&stream : plan.sdk) {
+      if (stream_plan_.sdk.find(stream) != stream_plan_.sdk.end())
+        continue;
+      enableStreamData(stream);
+      setStreamCallback(
+          stream, [this, stream](const api::StreamData &data) {
+            joinSdkThread();
+            if (published_streams_ & StreamBit(stream)) {
+              publishOther(stream, data);
+            }
+            if (stream == Stream::DISPARITY) {
+              publishDerived(data, derived_streams_);
+            }
           });
+    }
+    // the SDK enabled the parents with a stream, but disables only its
+    // children with it, so the processed parents are disabled too
+    std::set<Stream> stale = stream_plan_.sdk;
+    for (auto &&stream : StreamGraph::Ancestors(stream_plan_.sdk)) {
+      if (!StreamGraph::Parents(stream).empty())
+        stale.insert(stream);
+    }
+    // children first, the SDK disables the children of a stream with it
+    std::set<Stream> disabled;
+    for (auto it = stale.rbegin(); it != stale.rend(); ++it) {
+      const Stream &stream = *it;
+      if (plan.sdk.find(stream) != plan.sdk.end() ||
+          enabled_streams_.find(stream) != enabled_streams_.end() ||
+          disabled.find(stream) != disabled.end())
+        continue;
+      if (StreamGraph::HasDescendant(stream, plan.sdk)) {
+        // still processed for them
+        setStreamCallback(stream, nullptr);
+        continue;
+      }
+      disableStreamData(stream, [&](const Stream &stream) {
+            setStreamCallback(stream, nullptr);
+            disabled.insert(stream);
+          });
+    }
+    NODELET_INFO_STREAM("Stream graph, " << StreamGraph::ToString(plan));
+    stream_plan_ = plan;
+  }
+
+  void publishOther(const Stream &stream, const api::StreamData &data) {
+    TraceSpan span("callback", traceArg(stream));
+    AllocScope alloc_scope(stream_stats_.at(stream).get());
+    ros::Time stamp = checkUpTimeStamp(data.img->timestamp, stream);
+    arriveFrame(stream, data, stamp);
+    static std::size_t count = 0;
+    ++count;
+    publishSinks(stream, data);
+    publishH264(stream, data, stamp);
+    publishData(stream, data, count, stamp);
+  }
+
+  /**
+   * The Q of a pinhole calibration, see computeRectTransforms(). Without,
+   * e.g. with KANNALA_BRANDT, the SDK processes the depth and points.
+   */
+  bool canReproject() const {
+    return q_.rows == 4 && q_.cols == 4;
+  }
+
+  /** The derived streams from the disparity, in place of the SDK. */
+  void publishDerived(const api::StreamData &disparity,
+      std::uint32_t derived) {
+    if (derived == 0 || !disparity.img || disparity.frame.empty())
       return;
+    for (auto &&stream : {Stream::DISPARITY_NORMALIZED, Stream::DEPTH,
+        Stream::POINTS}) {
+      if (!(derived & StreamBit(stream)))
+        continue;
+      api::StreamData data;
+      data.img = disparity.img;
+      data.frame_id = disparity.frame_id;
+      {
+        TraceSpan span("derive", traceArg(stream));
+        if (stream == Stream::DISPARITY_NORMALIZED) {
+          NormalizeDisparity(disparity.frame, &data.frame);
+        } else if (stream == Stream::DEPTH) {
+          DisparityToDepth(disparity.frame, q_, &data.frame);
+        } else {
+          DisparityToPoints(disparity.frame, q_, &data.frame);
+        }
+      }
+      publishOther(stream, data);
     }
   }
 
   void publishTopics() {
     // publishMesh();
     if ((camera_publishers_[Stream::LEFT].getNumSubscribers() > 0 ||
-        mono_publishers_[Stream::LEFT].getNumSubscribers() > 0) &&
+        mono_publishers_[Stream::LEFT].getNumSubscribers() > 0 ||
+        isSinkStream(Stream::LEFT) || isH264Subscribed(Stream::LEFT)) &&
         !is_published_[Stream::LEFT]) {
-      api_->SetStreamCallback(
+      setStreamCallback(
           Stream::LEFT, [&](const api::StreamData &data) {
+            joinSdkThread();
             ++left_count_;
             if (left_count_ > 10) {
+              TraceSpan span("callback", traceArg(Stream::LEFT));
+              AllocScope alloc_scope(stream_stats_.at(Stream::LEFT).get());
               // ros::Time stamp = hardTimeToSoftTime(data.img->timestamp);
               ros::Time stamp = checkUpTimeStamp(
                   data.img->timestamp, Stream::LEFT);
+              arriveFrame(Stream::LEFT, data, stamp);
               if (skip_tag > 0) {
                 if (skip_tmp_left_tag == 0) {
                   skip_tmp_left_tag = skip_tag;
@@ -702,13 +1886,11 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
                   skip_tmp_left_tag--;
                   return;
                 }
-                if (left_timestamps.size() < MATCH_CHECK_THRESHOLD) {
-                  left_timestamps.insert(left_timestamps.begin(), data.img->timestamp);
-                } else {
-                  left_timestamps.insert(left_timestamps.begin(), data.img->timestamp);
-                  left_timestamps.pop_back();
-                }
+                PushRecentStamp(&left_timestamps, data.img->timestamp,
+                    MATCH_CHECK_THRESHOLD);
               }
+              publishSinks(Stream::LEFT, data);
+              publishH264(Stream::LEFT, data, stamp);
               publishCamera(Stream::LEFT, data, left_count_, stamp);
               publishMono(Stream::LEFT, data, left_count_, stamp);
               NODELET_DEBUG_STREAM(
@@ -724,15 +1906,20 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     }
 
     if ((camera_publishers_[Stream::RIGHT].getNumSubscribers() > 0 ||
-        mono_publishers_[Stream::RIGHT].getNumSubscribers() > 0) &&
+        mono_publishers_[Stream::RIGHT].getNumSubscribers() > 0 ||
+        isSinkStream(Stream::RIGHT) || isH264Subscribed(Stream::RIGHT)) &&
         !is_published_[Stream::RIGHT]) {
-      api_->SetStreamCallback(
+      setStreamCallback(
           Stream::RIGHT, [&](const api::StreamData &data) {
+            joinSdkThread();
             ++right_count_;
             if (right_count_ > 10) {
+              TraceSpan span("callback", traceArg(Stream::RIGHT));
+              AllocScope alloc_scope(stream_stats_.at(Stream::RIGHT).get());
               // ros::Time stamp = hardTimeToSoftTime(data.img->timestamp);
               ros::Time stamp = checkUpTimeStamp(
                   data.img->timestamp, Stream::RIGHT);
+              arriveFrame(Stream::RIGHT, data, stamp);
               if (skip_tag > 0) {
                 if (skip_tmp_right_tag == 0) {
                   skip_tmp_right_tag = skip_tag;
@@ -740,30 +1927,18 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
                   skip_tmp_right_tag--;
                   return;
                 }
-                if (right_timestamps.size() < MATCH_CHECK_THRESHOLD) {
-                  right_timestamps.insert(right_timestamps.begin(), data.img->timestamp);
-                } else {
-                  right_timestamps.insert(right_timestamps.begin(), data.img->timestamp);
-                  right_timestamps.pop_back();
-                  bool is_match = false;
-                  for (size_t i = 0; i < right_timestamps.size(); i++) {
-                    for (size_t j = 0; j < left_timestamps.size(); j++) {
-                      if (right_timestamps[i] == left_timestamps[j]) {
-                        is_match = true;
-                        break;
-                      }
-                    }
-                    if (is_match) {
-                      break;
-                    }
-                  }
-
-                  if (!is_match) {
-                    std::cout << "find the output stamp can't matched try to fix with one skip step." << std::endl;
-                    skip_tmp_right_tag++;
-                  }
+                bool is_full =
+                    right_timestamps.size() >= MATCH_CHECK_THRESHOLD;
+                PushRecentStamp(&right_timestamps, data.img->timestamp,
+                    MATCH_CHECK_THRESHOLD);
+                if (is_full &&
+                    !HasCommonStamp(left_timestamps, right_timestamps)) {
+                  std::cout << "find the output stamp can't matched try to fix with one skip step." << std::endl;
+                  skip_tmp_right_tag++;
                 }
               }
+              publishSinks(Stream::RIGHT, data);
+              publishH264(Stream::RIGHT, data, stamp);
               publishCamera(Stream::RIGHT, data, right_count_, stamp);
               publishMono(Stream::RIGHT, data, right_count_, stamp);
               NODELET_DEBUG_STREAM(
@@ -778,18 +1953,28 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
       is_published_[Stream::RIGHT] = true;
     }
 
-    std::vector<Stream> other_streams{
-        Stream::LEFT_RECTIFIED, Stream::RIGHT_RECTIFIED,
-        Stream::DISPARITY,      Stream::DISPARITY_NORMALIZED,
-        Stream::POINTS,         Stream::DEPTH
-        };
-    for (auto &&stream : other_streams) {
-      publishOthers(stream);
+    updateStreamGraph();
+
+    if (!is_motion_published_ && isMotionWanted() && pull_thread_) {
+      // drained by the pull thread, see publishMotionBatch()
+      enableMotionDatas(pull_motion_datas_);
+      imu_time_beg_ = ros::Time::now().toSec();
+      is_motion_published_ = true;
     }
 
-    if (!is_motion_published_) {
-      api_->SetMotionCallback([this](const api::MotionData &data) {
-      ros::Time stamp = checkUpImuTimeStamp(data.imu->timestamp);
+    if (!is_motion_published_ && isMotionWanted()) {
+      setMotionCallback([this](const api::MotionData &data) {
+      rt_imu_.Join();
+      TraceSpan span("callback", "imu");
+      std::uint64_t time = unwrapImuTimeStamp(data.imu->timestamp);
+      ros::Time stamp = hardTimeToSoftTime(time);
+      imu_stats_.Arrive();
+      if (data.imu && data.imu->flag < imu_gaps_.size()) {
+        // accel and gyro may count on their own
+        imu_stats_.Drop(StreamStats::LOSS_DEVICE,
+            imu_gaps_[data.imu->flag].Next(data.imu->frame_id));
+      }
+      imu_stats_.RecordArrival((ros::Time::now() - stamp).toNSec() / 1000);
 
       // static double imu_time_prev = -1;
       // NODELET_INFO_STREAM("ros_time_beg: " << FULL_PRECISION << ros_time_beg
@@ -801,13 +1986,16 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
       // imu_time_prev = data.imu->timestamp;
       ++imu_count_;
       if (imu_count_ > 50) {
+        if (data.imu) {
+          publishSinksImu(*data.imu);
+        }
         if (publish_imu_by_sync_) {
           if (data.imu) {
-            if (data.imu->flag == 1) {  // accelerometer
-              imu_accel_ = data.imu;
-              publishImuBySync();
-            } else if (data.imu->flag == 2) {  // gyroscope
-              imu_gyro_ = data.imu;
+            // accelerometer or gyroscope
+            if (data.imu->flag == 1 || data.imu->flag == 2) {
+              double accel[3], gyro[3];
+              convertImu(*data.imu, accel, gyro);
+              pushImuBySync(*data.imu, time, accel, gyro);
               publishImuBySync();
             } else {
               publishImu(data, imu_count_, stamp);
@@ -839,10 +2027,67 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
       is_motion_published_ = true;
     }
 
-    if (!is_started_) {
-      time_beg_ = ros::Time::now().toSec();
-      api_->Start(Source::ALL);
-      is_started_ = true;
+    updateSource(Source::VIDEO_STREAMING, "video", isVideoWanted(),
+        &video_source_);
+    updateSource(Source::MOTION_TRACKING, "motion", isMotionWanted(),
+        &motion_source_);
+  }
+
+  /** Any image stream has a subscriber or sink. */
+  bool isVideoWanted() {
+    if (!sources_on_demand_)
+      return true;
+    for (auto &&it : stream_names_) {
+      if (isStreamSupported(it.first) && isStreamWanted(it.first))
+        return true;
+    }
+    return false;
+  }
+
+  /** The imu or temperature has a subscriber, or the imu a sink. */
+  bool isMotionWanted() {
+    if (!sources_on_demand_)
+      return true;
+    return pub_imu_.getNumSubscribers() > 0 ||
+        pub_temperature_.getNumSubscribers() > 0 ||
+        (udp_sink_ && udp_imu_) || shm_imu_writer_ ||
+        (recorder_ && record_imu_) || (black_box_ && black_box_imu_);
+  }
+
+  struct SourceState {
+    bool started = false;
+    // since when it has no consumer, zero if it has
+    ros::WallTime idle_since;
+  };
+
+  /**
+   * Start the source once wanted, stop it once unwanted for
+   * sources/stop_delay, so a reconnecting subscriber does not restart it.
+   */
+  void updateSource(const Source &source, const char *name, bool wanted,
+      SourceState *state) {
+    if (wanted) {
+      state->idle_since = ros::WallTime();
+      if (!state->started) {
+        if (!is_started_) {
+          time_beg_ = ros::Time::now().toSec();
+          is_started_ = true;
+        }
+        startSource(source);
+        state->started = true;
+        NODELET_INFO_STREAM("Start " << name << " source");
+      }
+      return;
+    }
+    if (!state->started)
+      return;
+    ros::WallTime now = ros::WallTime::now();
+    if (state->idle_since.isZero()) {
+      state->idle_since = now;
+    } else if ((now - state->idle_since).toSec() >= sources_stop_delay_) {
+      stopSource(source);
+      state->started = false;
+      NODELET_INFO_STREAM("Stop " << name << " source, no consumer");
     }
   }
 
@@ -851,22 +2096,57 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
       ros::Time stamp) {
     // if (camera_publishers_[stream].getNumSubscribers() == 0)
     //   return;
-    std_msgs::Header header;
-    header.seq = seq;
-    header.stamp = stamp;
-    header.frame_id = frame_ids_[stream];
+    auto &&stats = stream_stats_.at(stream);
+    auto &&pool = image_pools_.at(stream);
+    auto &&msg = pool.Acquire();
+    msg->header.seq = seq;
+    msg->header.stamp = stamp;
+    msg->header.frame_id = frame_ids_[stream];
+    const char *trace_arg = traceArg(stream);
+    TraceSpan queue_span("queue", trace_arg);
+    auto queue_beg = StreamStats::clock::now();
+    ++convert_waiting_;
     pthread_mutex_lock(&mutex_data_);
-    cv::Mat img = data.frame;
-    if (stream == Stream::DISPARITY) {  // 32FC1 > 8UC1 = MONO8
-      img.convertTo(img, CV_8UC1);
+    --convert_waiting_;
+    stats->Record(StreamStats::STAGE_QUEUE, queue_beg,
+        StreamStats::clock::now());
+    queue_span.End();
+    TraceSpan convert_span("convert", trace_arg);
+    std::size_t capacity = msg->data.capacity();
+    cv::Mat img = cropFrame(stream, data.frame);
+    {
+      TraceSpan fill_span("fill", trace_arg);
+      if (stream == Stream::DISPARITY) {  // 32FC1 > 8UC1 = MONO8
+        FillDisparityMsg(img, camera_encodings_[stream], msg.get());
+      } else {
+        // copies, and converts if the encoding differs
+        alloc_stats::CountCopy(img.total() * img.elemSize());
+        cv_bridge::CvImage(msg->header, camera_encodings_[stream], img)
+            .toImageMsg(*msg);
+      }
+    }
+    if (msg->data.capacity() != capacity) {
+      pool.CountAllocation();
     }
-    auto &&msg =
-        cv_bridge::CvImage(header, camera_encodings_[stream], img).toImageMsg();
     pthread_mutex_unlock(&mutex_data_);
+    convert_span.End();
     auto &&info = getCameraInfo(stream);
     info->header.stamp = msg->header.stamp;
     info->header.frame_id = frame_ids_[stream];
-    camera_publishers_[stream].publish(msg, info);
+    auto convert_end = StreamStats::clock::now();
+    stats->Record(StreamStats::STAGE_CONVERT, stats->callback_time,
+        convert_end);
+    {
+      TraceSpan publish_span("publish", trace_arg);
+      camera_publishers_[stream].publish(msg, info);
+    }
+    stats->Record(StreamStats::STAGE_PUBLISH, convert_end,
+        StreamStats::clock::now());
+    recordGlass(stats.get(), data, stamp);
+    if (isCacheStream(stream)) {
+      // shares the published message
+      frame_caches_[stream]->Put(msg);
+    }
   }
 
   /*
@@ -894,15 +2174,25 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
       ros::Time stamp) {
     if (mono_publishers_[stream].getNumSubscribers() == 0)
       return;
-    std_msgs::Header header;
-    header.seq = seq;
-    header.stamp = stamp;
-    header.frame_id = frame_ids_[stream];
+    auto &&pool = mono_pools_.at(stream);
+    auto &&msg = pool.Acquire();
+    msg->header.seq = seq;
+    msg->header.stamp = stamp;
+    msg->header.frame_id = frame_ids_[stream];
+    const char *trace_arg = traceArg(stream);
     pthread_mutex_lock(&mutex_data_);
-    cv::Mat mono;
-    cv::cvtColor(data.frame, mono, CV_RGB2GRAY);
-    auto &&msg = cv_bridge::CvImage(header, enc::MONO8, mono).toImageMsg();
+    std::size_t capacity = msg->data.capacity();
+    cv::Mat img = cropFrame(stream, data.frame);
+    {
+      // convert into the message directly
+      TraceSpan fill_span("fill mono", trace_arg);
+      FillMonoMsg(img, msg.get());
+    }
+    if (msg->data.capacity() != capacity) {
+      pool.CountAllocation();
+    }
     pthread_mutex_unlock(&mutex_data_);
+    TraceSpan publish_span("publish mono", trace_arg);
     mono_publishers_[stream].publish(msg);
   }
 
@@ -911,56 +2201,57 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     // if (points_publisher_.getNumSubscribers() == 0)
     //   return;
 
-    auto &&in = api_->GetIntrinsicsBase(Stream::LEFT);
-
-    sensor_msgs::PointCloud2 msg;
-    msg.header.seq = seq;
-    msg.header.stamp = stamp;
-    msg.header.frame_id = frame_ids_[Stream::POINTS];
-    msg.width = in->width;
-    msg.height = in->height;
-    msg.is_dense = true;
-
-    sensor_msgs::PointCloud2Modifier modifier(msg);
-
-    modifier.setPointCloud2Fields(
-        4, "x", 1, sensor_msgs::PointField::FLOAT32, "y", 1,
-        sensor_msgs::PointField::FLOAT32, "z", 1,
-        sensor_msgs::PointField::FLOAT32, "rgb", 1,
-        sensor_msgs::PointField::FLOAT32);
-
-    modifier.setPointCloud2FieldsByString(2, "xyz", "rgb");
-
-    sensor_msgs::PointCloud2Iterator<float> iter_x(msg, "x");
-    sensor_msgs::PointCloud2Iterator<float> iter_y(msg, "y");
-    sensor_msgs::PointCloud2Iterator<float> iter_z(msg, "z");
-
-    sensor_msgs::PointCloud2Iterator<uint8_t> iter_r(msg, "r");
-    sensor_msgs::PointCloud2Iterator<uint8_t> iter_g(msg, "g");
-    sensor_msgs::PointCloud2Iterator<uint8_t> iter_b(msg, "b");
-
-    for (std::size_t y = 0; y < in->height; ++y) {
-      for (std::size_t x = 0; x < in->width; ++x) {
-        auto &&point = data.frame.at<cv::Vec3f>(y, x);
-
-        *iter_x = point[2] * 0.001;
-        *iter_y = 0.f - point[0] * 0.001;
-        *iter_z = 0.f - point[1] * 0.001;
-
-        *iter_r = static_cast<uint8_t>(255);
-        *iter_g = static_cast<uint8_t>(255);
-        *iter_b = static_cast<uint8_t>(255);
-
-        ++iter_x;
-        ++iter_y;
-        ++iter_z;
-        ++iter_r;
-        ++iter_g;
-        ++iter_b;
-      }
+    cv::Mat points = cropFrame(Stream::POINTS, data.frame);
+
+    auto &&msg = points_pool_.Acquire();
+    std::size_t capacity = msg->data.capacity();
+    msg->header.seq = seq;
+    msg->header.stamp = stamp;
+    msg->header.frame_id = frame_ids_[Stream::POINTS];
+    const char *trace_arg = traceArg(Stream::POINTS);
+    TraceSpan fill_span("fill", trace_arg);
+    FillPointCloudMsg(points, msg.get());
+    fill_span.End();
+    if (msg->data.capacity() != capacity) {
+      points_pool_.CountAllocation();
     }
 
+    auto &&stats = stream_stats_.at(Stream::POINTS);
+    auto convert_end = StreamStats::clock::now();
+    stats->Record(StreamStats::STAGE_CONVERT, stats->callback_time,
+        convert_end);
+    TraceSpan publish_span("publish", trace_arg);
     points_publisher_.publish(msg);
+    publish_span.End();
+    stats->Record(StreamStats::STAGE_PUBLISH, convert_end,
+        StreamStats::clock::now());
+    recordGlass(stats.get(), data, stamp);
+  }
+
+  /** Mid exposure of the frame to now, once its publish returned. */
+  void recordGlass(
+      StreamStats *stats, const api::StreamData &data, ros::Time stamp) {
+    if (!data.img)
+      return;
+    std::int64_t mid = MidExposureOffset(
+        data.img->exposure_time, exposure_unit_, stamp_at_end_);
+    stats->Record(StreamStats::STAGE_GLASS,
+        (ros::Time::now() - stamp).toNSec() / 1000 - mid);
+  }
+
+  /**
+   * Crop the frame to the stream roi, only a header view without copy.
+   */
+  cv::Mat cropFrame(const Stream &stream, const cv::Mat &frame) {
+    auto &&it = stream_rois_.find(stream);
+    if (it == stream_rois_.end()) {
+      return frame;
+    }
+    cv::Rect roi = it->second & cv::Rect(0, 0, frame.cols, frame.rows);
+    if (roi.area() <= 0) {
+      return frame;
+    }
+    return frame(roi);
   }
 
   void publishImu(
@@ -968,16 +2259,35 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     if (pub_imu_.getNumSubscribers() == 0)
       return;
 
+    double accel[3], gyro[3];
+    convertImu(*data.imu, accel, gyro);
+    publishImu(accel, gyro, seq, stamp);
+  }
+
+  void convertImu(const ImuData &imu, double *accel, double *gyro) {
+    // acceleration should be in m/s^2 (not in g's)
+    // velocity should be in rad/sec
+    for (int i = 0; i < 3; i++) {
+      accel[i] = imu.accel[i] * gravity_;
+      gyro[i] = imu.gyro[i] * M_PI / 180;
+    }
+  }
+
+  /** Accel in m/s^2 and gyro in rad/s. */
+  void publishImu(const double *accel, const double *gyro, std::uint32_t seq,
+      ros::Time stamp) {
+    if (pub_imu_.getNumSubscribers() == 0)
+      return;
+
     sensor_msgs::Imu msg;
 
     msg.header.seq = seq;
     msg.header.stamp = stamp;
     msg.header.frame_id = imu_frame_id_;
 
-    // acceleration should be in m/s^2 (not in g's)
-    msg.linear_acceleration.x = data.imu->accel[0] * gravity_;
-    msg.linear_acceleration.y = data.imu->accel[1] * gravity_;
-    msg.linear_acceleration.z = data.imu->accel[2] * gravity_;
+    msg.linear_acceleration.x = accel[0];
+    msg.linear_acceleration.y = accel[1];
+    msg.linear_acceleration.z = accel[2];
 
     msg.linear_acceleration_covariance[0] = 0;
     msg.linear_acceleration_covariance[1] = 0;
@@ -991,10 +2301,9 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     msg.linear_acceleration_covariance[7] = 0;
     msg.linear_acceleration_covariance[8] = 0;
 
-    // velocity should be in rad/sec
-    msg.angular_velocity.x = data.imu->gyro[0] * M_PI / 180;
-    msg.angular_velocity.y = data.imu->gyro[1] * M_PI / 180;
-    msg.angular_velocity.z = data.imu->gyro[2] * M_PI / 180;
+    msg.angular_velocity.x = gyro[0];
+    msg.angular_velocity.y = gyro[1];
+    msg.angular_velocity.z = gyro[2];
 
     msg.angular_velocity_covariance[0] = 0;
     msg.angular_velocity_covariance[1] = 0;
@@ -1011,108 +2320,157 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     pub_imu_.publish(msg);
   }
 
-  void timestampAlign() {
-    static std::vector<ImuData> acc_buf;
-    static std::vector<ImuData> gyro_buf;
-
-    if (imu_accel_ != nullptr) {
-      acc_buf.push_back(*imu_accel_);
+  /** One tick of the pull thread, returns the motion samples drained. */
+  std::size_t pullDatas() {
+    rt_imu_.Join();
+    {
+      std::lock_guard<std::mutex> _(pull_mutex_);
+      for (auto &&it : pull_callbacks_) {
+        for (auto &&data : getStreamDatas(it.first)) {
+          it.second(data);
+        }
+      }
     }
-
-    if (imu_gyro_ != nullptr) {
-      gyro_buf.push_back(*imu_gyro_);
+    auto &&datas = getMotionDatas();
+    if (!datas.empty()) {
+      publishMotionBatch(datas);
     }
+    return datas.size();
+  }
 
-    imu_accel_ = nullptr;
-    imu_gyro_ = nullptr;
-
-    imu_align_.clear();
-
-    if (acc_buf.empty() || gyro_buf.empty()) {
-      return;
+  /**
+   * The motion samples of one pull, as the motion callback publishes each,
+   * with the timestamps and units converted over the batch.
+   */
+  void publishMotionBatch(const std::vector<api::MotionData> &datas) {
+    TraceSpan span("batch", "imu");
+    motion_batch_.Assign(datas);
+    motion_batch_.Unwrap(imu_unwrapper_.get());
+    motion_batch_.Convert(gravity_);
+    ros::Time now = ros::Time::now();
+    bool aligned = false;
+    for (std::size_t i = 0; i < motion_batch_.size(); i++) {
+      auto &&imu = motion_batch_.imu(i);
+      ros::Time stamp = hardTimeToSoftTime(motion_batch_.time(i));
+      imu_stats_.Arrive();
+      if (imu.flag < imu_gaps_.size()) {
+        imu_stats_.Drop(StreamStats::LOSS_DEVICE,
+            imu_gaps_[imu.flag].Next(imu.frame_id));
+      }
+      imu_stats_.RecordArrival((now - stamp).toNSec() / 1000);
+      ++imu_count_;
+      if (imu_count_ <= 50)
+        continue;
+      publishSinksImu(imu);
+      // accelerometer or gyroscope
+      if (publish_imu_by_sync_ && (imu.flag == 1 || imu.flag == 2)) {
+        pushImuBySync(imu, motion_batch_.time(i), motion_batch_.accel(i),
+            motion_batch_.gyro(i));
+        aligned = true;
+      } else {
+        publishImu(motion_batch_.accel(i), motion_batch_.gyro(i), imu_count_,
+            stamp);
+        publishTemperature(imu.temperature, imu_count_, stamp);
+      }
     }
+    if (aligned) {
+      // aligned once for the batch
+      publishImuBySync();
+    }
+  }
 
-    ImuData imu_temp;
-    auto itg = gyro_buf.end();
-    auto ita = acc_buf.end();
-    for (auto it_gyro = gyro_buf.begin();
-        it_gyro != gyro_buf.end(); it_gyro++) {
-      for (auto it_acc = acc_buf.begin();
-          it_acc+1 != acc_buf.end(); it_acc++) {
-        if (it_gyro->timestamp >= it_acc->timestamp
-            && it_gyro->timestamp <= (it_acc+1)->timestamp) {
-          double k = static_cast<double>((it_acc+1)->timestamp - it_acc->timestamp);
-          k = static_cast<double>(it_gyro->timestamp - it_acc->timestamp) / k;
-
-          imu_temp = *it_gyro;
-          imu_temp.accel[0] = it_acc->accel[0] + ((it_acc+1)->accel[0] - it_acc->accel[0]) * k;
-          imu_temp.accel[1] = it_acc->accel[1] + ((it_acc+1)->accel[1] - it_acc->accel[1]) * k;
-          imu_temp.accel[2] = it_acc->accel[2] + ((it_acc+1)->accel[2] - it_acc->accel[2]) * k;
+  void publishSinksImu(const ImuData &imu) {
+    if (udp_sink_ && udp_imu_ && !publishUdpImu(imu)) {
+      imu_stats_.Drop(StreamStats::LOSS_PUBLISH);
+    }
+    if (shm_imu_writer_) {
+      publishShmImu(imu);
+    }
+    if (recorder_ && record_imu_) {
+      recorder_->WriteImu(imu.timestamp, toImuRecord(imu));
+    }
+    if (black_box_ && black_box_imu_) {
+      black_box_->WriteImu(imu.timestamp, toImuRecord(imu));
+    }
+  }
 
-          imu_align_.push_back(imu_temp);
+  /** False if the sample was lost, as publishUdp(). */
+  bool publishUdpImu(const ImuData &imu) {
+    udp::ImuPacket packet;
+    packet.timestamp = imu.timestamp;
+    packet.frame_id = imu.frame_id;
+    packet.flag = imu.flag;
+    std::fill(packet.reserved, packet.reserved + 3, 0);
+    for (int i = 0; i < 3; i++) {
+      packet.accel[i] = imu.accel[i];
+      packet.gyro[i] = imu.gyro[i];
+    }
+    packet.temperature = imu.temperature;
+    return udp_sink_->SendImu(packet);
+  }
 
-          itg = it_gyro;
-          ita = it_acc;
-        }
-      }
+  void publishShmImu(const ImuData &imu) {
+    shm::ImuSample sample;
+    sample.frame_id = imu.frame_id;
+    sample.flag = imu.flag;
+    std::fill(sample.reserved, sample.reserved + 3, 0);
+    for (int i = 0; i < 3; i++) {
+      sample.accel[i] = imu.accel[i];
+      sample.gyro[i] = imu.gyro[i];
     }
+    sample.temperature = imu.temperature;
+    shm::SlotMeta meta{};
+    meta.type = shm::SLOT_IMU;
+    meta.timestamp = imu.timestamp;
+    shm_imu_writer_->Write(
+        meta, reinterpret_cast<const std::uint8_t *>(&sample),
+        sizeof(sample), 1, sizeof(sample));
+  }
 
-    if (itg != gyro_buf.end()) {
-      gyro_buf.erase(gyro_buf.begin(), itg + 1);
+  record::ImuRecord toImuRecord(const ImuData &imu) {
+    record::ImuRecord sample{};
+    sample.frame_id = imu.frame_id;
+    sample.flag = imu.flag;
+    sample.is_ets = imu.is_ets;
+    for (int i = 0; i < 3; i++) {
+      sample.accel[i] = imu.accel[i];
+      sample.gyro[i] = imu.gyro[i];
     }
+    sample.temperature = imu.temperature;
+    return sample;
+  }
 
-    if (ita != acc_buf.end()) {
-      acc_buf.erase(acc_buf.begin(), ita);
+  /**
+   * Queue a sample to align, with its unwrapped time, accel in m/s^2 and
+   * gyro in rad/s, so the aligned samples need neither again.
+   */
+  void pushImuBySync(const ImuData &data, std::uint64_t time,
+      const double *accel, const double *gyro) {
+    ImuData imu = data;
+    imu.timestamp = time;
+    for (int i = 0; i < 3; i++) {
+      imu.accel[i] = accel[i];
+      imu.gyro[i] = gyro[i];
+    }
+    if (imu.flag == 1) {  // accelerometer
+      imu_aligner_.PushAccel(imu);
+    } else {  // gyroscope
+      imu_aligner_.PushGyro(imu);
     }
   }
 
+  void timestampAlign() {
+    TraceSpan span("imu align");
+    imu_aligner_.Align(&imu_align_);
+  }
+
   void publishImuBySync() {
     timestampAlign();
 
     for (int i = 0; i < imu_align_.size(); i++) {
-      sensor_msgs::Imu msg;
-
-      msg.header.seq = imu_sync_count_;
-      ros::Time stamp = checkUpImuTimeStamp(imu_align_[i].timestamp);
-      msg.header.stamp = stamp;
-      msg.header.frame_id = imu_frame_id_;
-
-      // acceleration should be in m/s^2 (not in g's)
-      msg.linear_acceleration.x = imu_align_[i].accel[0] * gravity_;
-      msg.linear_acceleration.y = imu_align_[i].accel[1] * gravity_;
-      msg.linear_acceleration.z = imu_align_[i].accel[2] * gravity_;
-
-      msg.linear_acceleration_covariance[0] = 0;
-      msg.linear_acceleration_covariance[1] = 0;
-      msg.linear_acceleration_covariance[2] = 0;
-
-      msg.linear_acceleration_covariance[3] = 0;
-      msg.linear_acceleration_covariance[4] = 0;
-      msg.linear_acceleration_covariance[5] = 0;
-
-      msg.linear_acceleration_covariance[6] = 0;
-      msg.linear_acceleration_covariance[7] = 0;
-      msg.linear_acceleration_covariance[8] = 0;
-
-      // velocity should be in rad/sec
-      msg.angular_velocity.x = imu_align_[i].gyro[0] * M_PI / 180;
-      msg.angular_velocity.y = imu_align_[i].gyro[1] * M_PI / 180;
-      msg.angular_velocity.z = imu_align_[i].gyro[2] * M_PI / 180;
-
-      msg.angular_velocity_covariance[0] = 0;
-      msg.angular_velocity_covariance[1] = 0;
-      msg.angular_velocity_covariance[2] = 0;
-
-      msg.angular_velocity_covariance[3] = 0;
-      msg.angular_velocity_covariance[4] = 0;
-      msg.angular_velocity_covariance[5] = 0;
-
-      msg.angular_velocity_covariance[6] = 0;
-      msg.angular_velocity_covariance[7] = 0;
-      msg.angular_velocity_covariance[8] = 0;
-
-      pub_imu_.publish(msg);
-
+      ros::Time stamp = hardTimeToSoftTime(imu_align_[i].timestamp);
+      publishImu(imu_align_[i].accel, imu_align_[i].gyro, imu_sync_count_,
+          stamp);
       publishTemperature(imu_align_[i].temperature, imu_sync_count_, stamp);
 
       ++imu_sync_count_;
@@ -1133,7 +2491,149 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
   }
 
  private:
+  bool supports(const Stream &stream) {
+    return virtual_device_ ? virtual_device_->Supports(stream)
+                           : api_->Supports(stream);
+  }
+
+  void enableStreamData(const Stream &stream) {
+    if (virtual_device_) {
+      virtual_device_->EnableStreamData(stream);
+    } else {
+      api_->EnableStreamData(stream);
+    }
+  }
+
+  void disableStreamData(const Stream &stream,
+      API::stream_switch_callback_t callback, bool try_tag = false) {
+    if (virtual_device_) {
+      virtual_device_->DisableStreamData(stream, callback, try_tag);
+    } else {
+      api_->DisableStreamData(stream, callback, try_tag);
+    }
+  }
+
+  void setStreamCallback(const Stream &stream,
+      API::stream_callback_t callback) {
+    if (pull_thread_) {
+      // called by the pull thread with the datas of the stream
+      std::lock_guard<std::mutex> _(pull_mutex_);
+      if (callback) {
+        pull_callbacks_[stream] = callback;
+      } else {
+        pull_callbacks_.erase(stream);
+      }
+      return;
+    }
+    if (virtual_device_) {
+      virtual_device_->SetStreamCallback(stream, callback);
+    } else {
+      api_->SetStreamCallback(stream, callback);
+    }
+  }
+
+  void setMotionCallback(API::motion_callback_t callback) {
+    if (virtual_device_) {
+      virtual_device_->SetMotionCallback(callback);
+    } else {
+      api_->SetMotionCallback(callback);
+    }
+  }
+
+  std::vector<api::StreamData> getStreamDatas(const Stream &stream) {
+    if (virtual_device_) {
+      return virtual_device_->GetStreamDatas(stream);
+    } else {
+      return api_->GetStreamDatas(stream);
+    }
+  }
+
+  void enableMotionDatas(std::size_t max_size) {
+    if (virtual_device_) {
+      virtual_device_->EnableMotionDatas(max_size);
+    } else {
+      api_->EnableMotionDatas(max_size);
+    }
+  }
+
+  std::vector<api::MotionData> getMotionDatas() {
+    if (virtual_device_) {
+      return virtual_device_->GetMotionDatas();
+    } else {
+      return api_->GetMotionDatas();
+    }
+  }
+
+  void startSource(const Source &source) {
+    if (virtual_device_) {
+      virtual_device_->Start(source);
+    } else {
+      api_->Start(source);
+    }
+  }
+
+  void stopSource(const Source &source) {
+    if (virtual_device_) {
+      virtual_device_->Stop(source);
+    } else {
+      api_->Stop(source);
+    }
+  }
+
+  bool initVirtualDevice() {
+    std::string playback_path = "";
+    bool synthetic = false;
+    private_nh_.getParamCached("playback/path", playback_path);
+    private_nh_.getParamCached("synthetic/enable", synthetic);
+    if (!playback_path.empty()) {
+      PlaybackDevice::Options options;
+      private_nh_.getParamCached("playback/rate", options.rate);
+      private_nh_.getParamCached("playback/loop", options.loop);
+      options.timestamp_wrap = unit_hard_time;
+      auto device = std::make_shared<PlaybackDevice>();
+      if (!device->Open(playback_path, options)) {
+        NODELET_FATAL_STREAM("Open playback " << playback_path
+            << " failed :(");
+        return true;
+      }
+      virtual_device_ = device;
+      frame_rate_ = device->GetStreamRequest().fps;
+      if (options.rate > 0) {
+        frame_rate_ = std::max(1,
+            static_cast<int>(frame_rate_ * options.rate));
+      }
+    } else if (synthetic) {
+      SyntheticDevice::Options options;
+      std::string model = "standard2";
+      private_nh_.getParamCached("synthetic/model", model);
+      private_nh_.getParamCached("synthetic/width", options.width);
+      private_nh_.getParamCached("synthetic/height", options.height);
+      private_nh_.getParamCached("synthetic/fps", options.fps);
+      private_nh_.getParamCached("synthetic/imu_rate", options.imu_rate);
+      private_nh_.getParamCached("synthetic/realtime", options.realtime);
+      private_nh_.getParamCached("synthetic/wrap_after", options.wrap_after);
+      options.model = model == "standard" ? Model::STANDARD
+                                          : Model::STANDARD2;
+      options.timestamp_wrap = unit_hard_time;
+      virtual_device_ = std::make_shared<SyntheticDevice>(options);
+      frame_rate_ = virtual_device_->GetStreamRequest().fps;
+    } else {
+      return false;
+    }
+
+    model_ = virtual_device_->GetModel();
+    auto &&request = virtual_device_->GetStreamRequest();
+    setRequestMode(0, request.width, request.height);
+    NODELET_INFO_STREAM("Virtual device " << virtual_device_->name()
+        << ", no calibration, default intrinsics are used");
+    computeRectTransforms();
+    return true;
+  }
+
   void initDevice() {
+    if (initVirtualDevice())
+      return;
+
     std::shared_ptr<Device> device = nullptr;
 
     device = selectDevice();
@@ -1187,8 +2687,11 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
         api_->ConfigStreamRequest(requests[0]);
       } else {
         api_->ConfigStreamRequest(requests[request_index]);
+        request_index_ = request_index;
       }
     }
+    auto &&request = api_->GetStreamRequest();
+    setRequestMode(request_index_, request.width, request.height);
 
     computeRectTransforms();
   }
@@ -1293,9 +2796,12 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
   }
 
   void computeRectTransforms() {
-    ROS_ASSERT(api_);
-    auto in_left_base = api_->GetIntrinsicsBase(Stream::LEFT);
-    auto in_right_base = api_->GetIntrinsicsBase(Stream::RIGHT);
+    ROS_ASSERT(api_ || virtual_device_);
+    std::shared_ptr<IntrinsicsBase> in_left_base, in_right_base;
+    if (api_) {
+      in_left_base = api_->GetIntrinsicsBase(Stream::LEFT);
+      in_right_base = api_->GetIntrinsicsBase(Stream::RIGHT);
+    }
     is_intrinsics_enable_ = in_left_base && in_right_base;
     if (is_intrinsics_enable_) {
       if (in_left_base->calib_model() != CalibrationModel::PINHOLE ||
@@ -1310,8 +2816,10 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     auto in_left = *std::dynamic_pointer_cast<IntrinsicsPinhole>(in_left_base);
     auto in_right = *std::dynamic_pointer_cast<IntrinsicsPinhole>(
         in_right_base);
-    auto ex_right_to_left = api_->GetExtrinsics(Stream::RIGHT, Stream::LEFT);
-    if (!is_intrinsics_enable_) {
+    Extrinsics ex_right_to_left;
+    if (is_intrinsics_enable_) {
+      ex_right_to_left = api_->GetExtrinsics(Stream::RIGHT, Stream::LEFT);
+    } else {
       ex_right_to_left = *(getDefaultExtrinsics());
     }
 
@@ -1347,14 +2855,22 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     if (camera_info_ptrs_.find(stream) != camera_info_ptrs_.end()) {
       return camera_info_ptrs_[stream];
     }
-    ROS_ASSERT(api_);
+    ROS_ASSERT(api_ || virtual_device_);
     // http://docs.ros.org/kinetic/api/sensor_msgs/html/msg/CameraInfo.html
     sensor_msgs::CameraInfo *camera_info = new sensor_msgs::CameraInfo();
     camera_info_ptrs_[stream] = sensor_msgs::CameraInfoPtr(camera_info);
-    auto info_pair = api_->GetCameraROSMsgInfoPair();
-    camera_info->width = info_pair->left.width;
-    camera_info->height = info_pair->left.height;
-    if (is_intrinsics_enable_) {
+    if (!api_) {
+      // virtual device, size only as there is no calibration
+      auto &&request = virtual_device_->GetStreamRequest();
+      camera_info->width = request.width;
+      camera_info->height = request.height;
+    }
+    auto info_pair = api_ ? api_->GetCameraROSMsgInfoPair() : nullptr;
+    if (info_pair) {
+      camera_info->width = info_pair->left.width;
+      camera_info->height = info_pair->left.height;
+    }
+    if (is_intrinsics_enable_ && info_pair) {
       if (stream == Stream::RIGHT ||
           stream == Stream::RIGHT_RECTIFIED) {
         if (info_pair->right.distortion_model == "KANNALA_BRANDT") {
@@ -1410,6 +2926,19 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
         }
       }
     }
+    auto &&it = stream_rois_.find(stream);
+    if (it != stream_rois_.end()) {
+      // roi is given in full resolution image coordinates
+      cv::Rect roi = it->second &
+          cv::Rect(0, 0, camera_info->width, camera_info->height);
+      camera_info->roi.x_offset = roi.x;
+      camera_info->roi.y_offset = roi.y;
+      camera_info->roi.width = roi.width;
+      camera_info->roi.height = roi.height;
+      // the raw roi must be rectified by consumers, others are rectified
+      camera_info->roi.do_rectify =
+          (stream == Stream::LEFT || stream == Stream::RIGHT);
+    }
     return camera_info_ptrs_[stream];
   }
 
@@ -1431,7 +2960,8 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     static_tf_broadcaster_.sendTransform(b2l_msg);
 
     // Transform left frame to right frame
-    auto &&l2r_ex = api_->GetExtrinsics(Stream::LEFT, Stream::RIGHT);
+    Extrinsics l2r_ex = api_ ? api_->GetExtrinsics(Stream::LEFT, Stream::RIGHT)
+                             : getDefaultExtrinsics()->Inverse();
     tf::Quaternion l2r_q;
     tf::Matrix3x3 l2r_r(
         l2r_ex.rotation[0][0], l2r_ex.rotation[0][1], l2r_ex.rotation[0][2],
@@ -1536,7 +3066,9 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
     static_tf_broadcaster_.sendTransform(b2p_msg);
 
     // Transform left frame to imu frame
-    auto &&l2i_ex = api_->GetMotionExtrinsics(Stream::LEFT);
+    // a virtual device has no imu extrinsics, identity by the zero rotation
+    Extrinsics l2i_ex = api_ ? api_->GetMotionExtrinsics(Stream::LEFT)
+                             : Extrinsics();
     geometry_msgs::TransformStamped l2i_msg;
     l2i_msg.header.stamp = tf_stamp;
     l2i_msg.header.frame_id = frame_ids_[Stream::LEFT];
@@ -1593,6 +3125,8 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
   std::map<Stream, image_transport::CameraPublisher> camera_publishers_;
   std::map<Stream, sensor_msgs::CameraInfoPtr> camera_info_ptrs_;
   std::map<Stream, std::string> camera_encodings_;
+  // region of interest of each stream, not present means the full frame
+  std::map<Stream, cv::Rect> stream_rois_;
 
   // image: LEFT_RECTIFIED, RIGHT_RECTIFIED, DISPARITY, DISPARITY_NORMALIZED,
   // DEPTH
@@ -1605,12 +3139,97 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
   // pointcloud: POINTS
   ros::Publisher points_publisher_;
 
+  // recycled messages of camera, mono and pointcloud
+  std::map<Stream, MessagePool<sensor_msgs::Image>> image_pools_;
+  std::map<Stream, MessagePool<sensor_msgs::Image>> mono_pools_;
+  MessagePool<sensor_msgs::PointCloud2> points_pool_{MESSAGE_POOL_SIZE};
+
   ros::Publisher pub_imu_;
   ros::Publisher pub_temperature_;
 
   tf2_ros::StaticTransformBroadcaster static_tf_broadcaster_;
 
+  // udp multicast sink, null if disabled
+  std::unique_ptr<UdpSink> udp_sink_;
+  std::map<Stream, bool> udp_streams_;
+  bool udp_imu_ = true;
+
+  // shared memory rings, no entry if disabled
+  std::map<Stream, std::unique_ptr<shm::RingWriter>> shm_writers_;
+  std::map<Stream, std::string> shm_names_;
+  std::unique_ptr<shm::RingWriter> shm_imu_writer_;
+  std::string shm_prefix_;
+  int shm_slots_ = 8;
+
+  // native recording, null if disabled
+  std::unique_ptr<Recorder> recorder_;
+  std::map<Stream, bool> record_streams_;
+  bool record_imu_ = true;
+
+  // black box, null if disabled
+  std::unique_ptr<BlackBox> black_box_;
+  std::map<Stream, bool> black_box_streams_;
+  bool black_box_imu_ = true;
+  double black_box_seconds_ = 30;
+  std::string black_box_dir_;
+  ros::ServiceServer black_box_service_;
+  ros::Subscriber black_box_subscriber_;
+
+  // recent frames, no entry if disabled
+  std::map<Stream, std::unique_ptr<FrameCache<sensor_msgs::Image>>>
+      frame_caches_;
+  std::map<std::string, Stream> cache_streams_;
+  ros::ServiceServer get_cached_frame_service_;
+
+#ifdef WITH_X264
+  // h264 video output, null if disabled
+  ros::Publisher h264_publisher_;
+  Stream h264_stream_;
+  std::unique_ptr<H264EncodeWorker> h264_worker_;
+  // dropped at the last diagnostics
+  std::size_t h264_dropped_ = 0;
+#endif
+
+  // per stream latencies and counters, published as diagnostics
+  std::map<Stream, std::unique_ptr<StreamStats>> stream_stats_;
+  // of the diagnostics, metrics and traces
+  std::map<Stream, std::string> stream_names_;
+  StreamStats imu_stats_;
+  // frame ids of the raw streams, to tell device from sdk drops
+  FrameIdHistory raw_frame_ids_;
+  // imu ids by flag, motion callback only
+  std::array<SequenceGap<std::uint32_t>, 3> imu_gaps_;
+  ros::Publisher diagnostics_publisher_;
+  ros::WallTimer diagnostics_timer_;
+  ros::WallTime diagnostics_time_;
+  // frames and drops at the last publish, diagnostics timer only
+  struct DiagnosticsCounts {
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t drops[StreamStats::LOSS_LAST] = {};
+  };
+  std::map<std::string, DiagnosticsCounts> diagnostics_counts_;
+  // busiest threads on the diagnostics, none for no process status
+  int diagnostics_threads_ = 8;
+  ProcessStats process_stats_;
+  // duration of an exposure unit in 1us, to the mid exposure of a frame
+  double exposure_unit_ = 0;
+  bool stamp_at_end_ = false;
+  // callbacks waiting for the conversion lock
+  std::atomic<int> convert_waiting_{0};
+  // counters in the Prometheus format, null if disabled
+  std::unique_ptr<MetricsServer> metrics_server_;
+
   ros::ServiceServer get_info_service_;
+  // stream request and options while running, see device_mutex_
+  ros::ServiceServer reconfigure_service_;
+  // held to start, stop or configure the device
+  std::mutex device_mutex_;
+
+  // spans by service trace, the tracer is of the process
+  std::string trace_dir_;
+  int trace_threads_ = 16;
+  ros::ServiceServer trace_service_;
 
   // node params
 
@@ -1626,6 +3245,8 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
   // api
 
   std::shared_ptr<API> api_;
+  // in place of api_ for playback or synthetic data, null for a device
+  std::shared_ptr<VirtualDevice> virtual_device_;
 
   // rectification transforms
   cv::Mat left_r_, right_r_, left_p_, right_p_, q_;
@@ -1639,14 +3260,49 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
   std::size_t right_count_ = 0;
   std::size_t imu_count_ = 0;
   std::size_t imu_sync_count_ = 0;
-  std::shared_ptr<ImuData> imu_accel_;
-  std::shared_ptr<ImuData> imu_gyro_;
   bool publish_imu_by_sync_ = true;
   std::map<Stream, bool> is_published_;
   bool is_motion_published_;
+  // a source was started once
   bool is_started_;
+  // started by the consumers of the source
+  SourceState video_source_;
+  SourceState motion_source_;
+  bool sources_on_demand_ = true;
+  double sources_stop_delay_ = 2;
+  // acquisition/mode pull, null by callback
+  std::unique_ptr<PullThread> pull_thread_;
+  double pull_period_ = 0.005;
+  int pull_motion_datas_ = 1000;
+  std::mutex pull_mutex_;
+  std::map<Stream, API::stream_callback_t> pull_callbacks_;
+  MotionBatch motion_batch_;
+  // of the last diagnostics
+  std::uint64_t pull_ticks_ = 0;
+  std::uint64_t pull_samples_ = 0;
+  // real-time scheduling, see rt/*
+  ThreadGroup rt_sdk_{0, "sdk"};
+  ThreadGroup rt_imu_{1, "imu"};
+  ThreadGroup rt_publish_{2, "publish"};
+  std::map<std::string, std::string> rt_probe_errors_;
+  bool rt_mlockall_ = false;
+  std::size_t rt_locked_bytes_ = 0;
+  std::string rt_lock_error_;
+  std::size_t rt_prefault_bytes_ = 0;
+  // processed streams in the SDK and in the wrapper
+  StreamGraph::Plan stream_plan_;
+  std::set<Stream> enabled_streams_;
+  bool graph_derive_ = true;
+  // masks of the plan, for the callbacks
+  std::atomic<std::uint32_t> published_streams_{0};
+  std::atomic<std::uint32_t> derived_streams_{0};
   int frame_rate_;
+  // of the stream requests of the device, 0 for a virtual one, set with
+  // request_mode_ under device_mutex_, see requestMode()
+  std::atomic<int> request_index_{0};
+  std::string request_mode_;
   bool is_intrinsics_enable_;
+  ImuAligner imu_aligner_;
   std::vector<ImuData> imu_align_;
   int skip_tag;
   int skip_tmp_left_tag;
@@ -1661,6 +3317,9 @@ class ROSWrapperNodelet : public nodelet::Nodelet {
   std::vector<int64_t> right_timestamps;
 
   std::uint64_t unit_hard_time = std::numeric_limits<std::uint32_t>::max();
+  std::map<Stream, std::unique_ptr<TimestampUnwrapper>> stream_unwrappers_;
+  std::unique_ptr<TimestampUnwrapper> imu_unwrapper_;
+  SoftTimeMapper soft_time_;
 };
 
 MYNTEYE_END_NAMESPACE
@@ -0,0 +1,168 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <time.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#ifdef WITH_AVCODEC
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "h264_encoder.h"
+
+// Encodes synthetic frames, reports the cpu time per frame and the bitrate.
+// With libavcodec, decodes the stream back and checks the quality.
+//
+// Usage: h264_bench [width] [height] [frames] [bitrate] [keyint]
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+double thread_cpu_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void make_frame(int i, cv::Mat *frame) {
+  // moving textured pattern
+  for (int y = 0; y < frame->rows; y++) {
+    auto row = frame->ptr<cv::Vec3b>(y);
+    for (int x = 0; x < frame->cols; x++) {
+      int u = x + i * 4, v = y + i * 2;
+      row[x] = cv::Vec3b(
+          (u ^ v) & 0xff, (u * 3 + (v >> 2)) & 0xff,
+          ((u >> 3) * (v >> 3)) & 0xff);
+    }
+  }
+}
+
+#ifdef WITH_AVCODEC
+double psnr(const std::uint8_t *a, const std::uint8_t *b, int width,
+    int height, int b_stride) {
+  double mse = 0;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      double d = a[y * width + x] - b[y * b_stride + x];
+      mse += d * d;
+    }
+  }
+  mse /= width * height;
+  return mse == 0 ? 99 : 10 * std::log10(255 * 255 / mse);
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int width = argc > 1 ? std::atoi(argv[1]) : 1280;
+  int height = argc > 2 ? std::atoi(argv[2]) : 800;
+  int frames = argc > 3 ? std::atoi(argv[3]) : 300;
+  H264Encoder::Options options;
+  if (argc > 4) options.bitrate = std::atoi(argv[4]);
+  if (argc > 5) options.keyint = std::atoi(argv[5]);
+
+  H264Encoder encoder;
+  if (!encoder.Open(width, height, options)) {
+    return 1;
+  }
+
+#ifdef WITH_AVCODEC
+  const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+  AVCodecContext *decoder = avcodec_alloc_context3(codec);
+  if (codec == nullptr || avcodec_open2(decoder, codec, nullptr) < 0) {
+    std::cerr << "Open h264 decoder failed" << std::endl;
+    return 1;
+  }
+  AVPacket *packet = av_packet_alloc();
+  AVFrame *decoded = av_frame_alloc();
+  int decoded_n = 0;
+  double psnr_min = 99;
+#endif
+
+  cv::Mat frame(height, width, CV_8UC3);
+  cv::Mat i420(height * 3 / 2, width, CV_8UC1);
+  std::vector<std::uint8_t> out;
+  std::size_t bytes = 0, keyframes = 0;
+  double cpu_time = 0;
+  for (int i = 0; i < frames; i++) {
+    make_frame(i, &frame);
+
+    double time_beg = thread_cpu_time();
+    cv::cvtColor(frame, i420, cv::COLOR_BGR2YUV_I420);
+    bool keyframe = false;
+    if (!encoder.Encode(i420.data, i, &out, &keyframe)) {
+      return 1;
+    }
+    cpu_time += thread_cpu_time() - time_beg;
+    bytes += out.size();
+    if (keyframe) ++keyframes;
+
+#ifdef WITH_AVCODEC
+    if (out.empty()) continue;
+    packet->data = out.data();
+    packet->size = static_cast<int>(out.size());
+    if (avcodec_send_packet(decoder, packet) < 0) {
+      std::cerr << "Decode frame " << i << " failed" << std::endl;
+      return 1;
+    }
+    while (avcodec_receive_frame(decoder, decoded) == 0) {
+      if (decoded->width != width || decoded->height != height) {
+        std::cerr << "Decoded size mismatch" << std::endl;
+        return 1;
+      }
+      psnr_min = std::min(psnr_min, psnr(
+          i420.data, decoded->data[0], width, height, decoded->linesize[0]));
+      ++decoded_n;
+    }
+#endif
+  }
+
+  std::cout << std::fixed << std::setprecision(3)
+            << "resolution: " << width << "x" << height
+            << ", frames: " << frames << ", keyframes: " << keyframes
+            << std::endl
+            << "cpu per frame: " << (cpu_time * 1000 / frames) << " ms"
+            << ", bitrate at " << options.fps << " fps: "
+            << (bytes * 8.0 * options.fps / frames / 1000) << " kbit/s"
+            << std::endl;
+
+#ifdef WITH_AVCODEC
+  avcodec_send_packet(decoder, nullptr);  // flush
+  while (avcodec_receive_frame(decoder, decoded) == 0) {
+    ++decoded_n;
+  }
+  std::cout << "decoded: " << decoded_n << ", min psnr: " << psnr_min
+            << " dB" << std::endl;
+  av_frame_free(&decoded);
+  av_packet_free(&packet);
+  avcodec_free_context(&decoder);
+  if (decoded_n != frames || psnr_min < 25) {
+    std::cerr << "Loopback decode failed" << std::endl;
+    return 1;
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,167 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "recorder.h"
+
+// Records synthetic stereo YUYV frames and 200 Hz imu, reports the sustained
+// write throughput and drops, then reads the file back to verify it.
+// fps 0 writes as fast as the disk takes it, to find the headroom.
+//
+// Usage: record_bench [path] [seconds] [width] [height] [fps] [lz4] [direct]
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+const int IMU_RATE = 200;
+const std::uint32_t FORMAT_YUYV = 0x56595559;  // fourcc "YUYV"
+
+void make_frame(int i, int width, int height, std::vector<std::uint8_t> *buf) {
+  // moving textured pattern, 2 bytes per pixel
+  buf->resize(width * height * 2);
+  for (int y = 0; y < height; y++) {
+    std::uint8_t *row = buf->data() + y * width * 2;
+    for (int x = 0; x < width * 2; x++) {
+      int u = x + i * 4, v = y + i * 2;
+      row[x] = (x & 1) ? 128 + ((u ^ v) & 0x1f) : ((u >> 2) + v) & 0xff;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::string path = argc > 1 ? argv[1] : "record_bench.myntrec";
+  double seconds = argc > 2 ? std::atof(argv[2]) : 10;
+  int width = argc > 3 ? std::atoi(argv[3]) : 1280;
+  int height = argc > 4 ? std::atoi(argv[4]) : 800;
+  int fps = argc > 5 ? std::atoi(argv[5]) : 30;
+  Recorder::Options options;
+  options.lz4 = argc > 6 && std::atoi(argv[6]) != 0;
+  options.direct = argc > 7 && std::atoi(argv[7]) != 0;
+
+  // a few distinct frames, so generating them does not limit the rate
+  std::vector<std::vector<std::uint8_t>> frames(8);
+  for (std::size_t i = 0; i < frames.size(); i++) {
+    make_frame(i, width, height, &frames[i]);
+  }
+
+  Recorder recorder;
+  if (!recorder.Open(path, options)) {
+    return 1;
+  }
+
+  using clock = std::chrono::steady_clock;
+  auto time_beg = clock::now();
+  auto time_end = time_beg + std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(seconds));
+  std::uint64_t frame_n = 0, imu_n = 0;
+  std::uint64_t timestamp = 0;  // 1us
+  const std::size_t row_bytes = width * 2;
+  while (clock::now() < time_end) {
+    // left and right of one frame, then the imu samples until the next one
+    std::uint16_t frame_id = static_cast<std::uint16_t>(frame_n);
+    auto &&frame = frames[frame_n % frames.size()];
+    std::memcpy(frame.data(), &frame_id, sizeof(frame_id));
+    for (std::uint8_t stream = 0; stream < 2; stream++) {
+      record::RecordHeader header{};
+      header.stream = stream;
+      header.frame_id = frame_id;
+      header.timestamp = timestamp;
+      header.format = FORMAT_YUYV;
+      header.width = width;
+      header.height = height;
+      while (!recorder.WriteImage(
+                 header, frame.data(), row_bytes, height, row_bytes) &&
+             fps == 0) {
+        // as fast as possible, wait for the disk instead of dropping
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+    ++frame_n;
+
+    int imu_per_frame = IMU_RATE / (fps > 0 ? fps : 30);
+    for (int i = 0; i < imu_per_frame; i++) {
+      record::ImuRecord imu{};
+      imu.frame_id = static_cast<std::uint32_t>(imu_n++);
+      imu.flag = 0;
+      imu.accel[2] = 1;
+      imu.temperature = 40;
+      recorder.WriteImu(timestamp + i * 1000000 / IMU_RATE, imu);
+    }
+    timestamp += 1000000 / (fps > 0 ? fps : 30);
+
+    if (fps > 0) {
+      std::this_thread::sleep_until(time_beg + std::chrono::microseconds(
+          frame_n * 1000000 / fps));
+    }
+  }
+  double elapsed =
+      std::chrono::duration<double>(clock::now() - time_beg).count();
+  recorder.Close();  // flushes the backlog
+  double total =
+      std::chrono::duration<double>(clock::now() - time_beg).count();
+  std::uint64_t records = recorder.records();
+  std::uint64_t dropped = recorder.dropped();
+  std::uint64_t raw_bytes = recorder.raw_bytes();
+  std::uint64_t written = recorder.written_bytes();
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "resolution: 2x " << width << "x" << height << " yuyv"
+            << ", target fps: " << fps << (options.lz4 ? ", lz4" : "")
+            << (options.direct ? ", direct" : "") << std::endl
+            << "frames: " << frame_n << " (" << (frame_n / elapsed)
+            << " fps), records: " << records
+            << (fps > 0 ? ", dropped: " : ", waits for disk: ") << dropped
+            << std::endl
+            << "raw: " << (raw_bytes / elapsed / 1e6) << " MB/s"
+            << ", written: " << (written / 1e6) << " MB in " << total
+            << " s, " << (written / total / 1e6) << " MB/s"
+            << ", write busy: "
+            << (recorder.write_time() * 100 / total) << "%" << std::endl;
+
+  RecordReader reader;
+  if (!reader.Open(path)) {
+    return 1;
+  }
+  RecordReader::Record record;
+  std::uint64_t read_n = 0, bad_n = 0;
+  while (reader.Next(&record)) {
+    ++read_n;
+    if (record.header->type == record::RECORD_IMAGE) {
+      std::uint16_t frame_id;
+      std::memcpy(&frame_id, record.data, sizeof(frame_id));
+      if (frame_id != record.header->frame_id ||
+          record.header->size != row_bytes * height) {
+        ++bad_n;
+      }
+    }
+  }
+  std::cout << "read back: " << read_n << " records in "
+            << reader.index().size() << " chunks, bad: " << bad_n
+            << std::endl;
+  if (read_n != records || bad_n > 0) {
+    std::cerr << "Read back mismatch" << std::endl;
+    return 1;
+  }
+  return fps > 0 && dropped > 0 ? 2 : 0;
+}
@@ -0,0 +1,147 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "shm_ring.h"
+
+// Measures the latency from a writer process to a reader process through
+// the shared memory ring, from the start of Write() to the reader seeing it,
+// so the copy of the frame is included.
+//
+// Usage: shm_latency [width] [height] [frames] [fps]
+
+namespace {
+
+const char RING_NAME[] = "/mynteye_shm_latency";
+
+std::uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int run_reader(int frames) {
+  mynteye::shm::RingReader reader;
+  std::uint64_t deadline = now_ns() + 5000000000ull;
+  while (!reader.Open(RING_NAME)) {
+    if (now_ns() > deadline) {
+      std::cerr << "Open ring failed" << std::endl;
+      return 1;
+    }
+    usleep(1000);
+  }
+
+  std::vector<double> latencies;
+  latencies.reserve(frames);
+  std::uint64_t next = 0;
+  int invalid = 0;
+  while (static_cast<int>(latencies.size() + invalid) < frames) {
+    std::uint64_t write_seq = reader.WriteSeq();
+    if (write_seq <= next) {
+      if (reader.IsClosed()) break;
+      continue;  // busy poll, lowest latency
+    }
+    std::uint64_t seen = now_ns();
+    if (write_seq - next > 1) {
+      invalid += write_seq - next - 1;  // skipped
+      next = write_seq - 1;
+    }
+    mynteye::shm::RingReader::View view;
+    if (reader.Get(next, &view) && reader.IsValid(view)) {
+      // the writer stamps the time before the write
+      latencies.push_back((seen - view.meta.timestamp) * 1e-3);
+    } else {
+      ++invalid;
+    }
+    ++next;
+  }
+
+  if (latencies.empty()) {
+    std::cerr << "No frames received" << std::endl;
+    return 1;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto at = [&latencies](double p) {
+    return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+  };
+  std::cout << std::fixed << std::setprecision(2)
+            << "frames: " << latencies.size() << ", missed: " << invalid
+            << std::endl
+            << "latency us, p50: " << at(0.5) << ", p90: " << at(0.9)
+            << ", p99: " << at(0.99) << ", max: " << latencies.back()
+            << std::endl;
+  return 0;
+}
+
+int run_writer(int width, int height, int frames, int fps) {
+  std::size_t row_bytes = width * 3;
+  mynteye::shm::RingWriter writer;
+  if (!writer.Create(RING_NAME, 8, row_bytes * height)) {
+    std::cerr << "Create ring failed" << std::endl;
+    return 1;
+  }
+  usleep(100000);  // let the reader open it
+
+  std::vector<std::uint8_t> frame(row_bytes * height);
+  std::uint64_t period = 1000000000ull / fps;
+  std::uint64_t next = now_ns();
+  for (int i = 0; i < frames; i++) {
+    std::fill(frame.begin(), frame.end(), static_cast<std::uint8_t>(i));
+    mynteye::shm::SlotMeta meta{};
+    meta.type = mynteye::shm::SLOT_IMAGE;
+    meta.frame_id = static_cast<std::uint16_t>(i);
+    meta.width = width;
+    meta.height = height;
+    meta.cv_type = 16;  // CV_8UC3
+    meta.timestamp = now_ns();
+    writer.Write(meta, frame.data(), row_bytes, height, row_bytes);
+    next += period;
+    std::uint64_t now = now_ns();
+    if (next > now) usleep((next - now) / 1000);
+  }
+  usleep(100000);
+  writer.Close();
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int width = argc > 1 ? std::atoi(argv[1]) : 1280;
+  int height = argc > 2 ? std::atoi(argv[2]) : 400;
+  int frames = argc > 3 ? std::atoi(argv[3]) : 600;
+  int fps = argc > 4 ? std::atoi(argv[4]) : 60;
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    std::cerr << "Fork failed" << std::endl;
+    return 1;
+  }
+  if (pid == 0) {
+    return run_reader(frames);
+  }
+  int ret = run_writer(width, height, frames, fps);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (ret != 0) return ret;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
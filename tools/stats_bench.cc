@@ -0,0 +1,108 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "pipeline_stats.h"
+
+// Measures the cost of the per frame instrumentation of the wrapper, one
+// arrival, four stage records and the clock reads, alone and with threads
+// recording at once as the left, right and imu callbacks do. It is compared
+// to copying one frame, less than any conversion of the hot path.
+//
+// Usage: stats_bench [width] [height] [threads]
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+const int ITERATIONS = 1000000;
+const int COPIES = 200;
+
+double elapsed_ns(const clock::time_point &beg, int n) {
+  return std::chrono::duration<double, std::nano>(clock::now() - beg).count() /
+      n;
+}
+
+void instrument(StreamStats *stats, int n) {
+  for (int i = 0; i < n; i++) {
+    // as the callback, publishCamera() and the diagnostics in the nodelet
+    stats->Arrive(static_cast<std::uint16_t>(i));
+    auto now = std::chrono::system_clock::now();  // ros::Time::now()
+    stats->Record(StreamStats::STAGE_ARRIVAL, now.time_since_epoch().count() &
+        0xfff);
+    auto queue_beg = clock::now();
+    stats->Record(StreamStats::STAGE_QUEUE, queue_beg, clock::now());
+    auto convert_end = clock::now();
+    stats->Record(StreamStats::STAGE_CONVERT, stats->callback_time,
+        convert_end);
+    stats->Record(StreamStats::STAGE_PUBLISH, convert_end, clock::now());
+  }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int width = argc > 1 ? std::atoi(argv[1]) : 640;
+  int height = argc > 2 ? std::atoi(argv[2]) : 400;
+  int threads = argc > 3 ? std::atoi(argv[3]) : 3;
+
+  StreamStats stats;
+  auto time_beg = clock::now();
+  instrument(&stats, ITERATIONS);
+  double single_ns = elapsed_ns(time_beg, ITERATIONS);
+
+  // stats are per stream, as the callbacks
+  std::vector<StreamStats> thread_stats(threads);
+  std::vector<std::thread> workers;
+  time_beg = clock::now();
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back(instrument, &thread_stats[i], ITERATIONS);
+  }
+  for (auto &&worker : workers) {
+    worker.join();
+  }
+  // per frame of all threads, as much as single_ns times threads on one core
+  double shared_ns = elapsed_ns(time_beg, ITERATIONS);
+
+  std::vector<std::uint8_t> src(width * height * 3, 1), dst(src.size());
+  time_beg = clock::now();
+  for (int i = 0; i < COPIES; i++) {
+    std::memcpy(dst.data(), src.data(), src.size());
+    src[i % src.size()] = dst[(i * 7) % dst.size()];
+  }
+  double copy_ns = elapsed_ns(time_beg, COPIES);
+
+  auto summary = stats.latency(StreamStats::STAGE_QUEUE).TakeSummary();
+  std::cout << std::fixed << std::setprecision(1)
+            << "Instrumentation per frame: " << single_ns << " ns, with "
+            << threads << " threads: " << shared_ns << " ns" << std::endl
+            << "Copy of a " << width << "x" << height << " bgr frame: "
+            << copy_ns << " ns" << std::endl
+            << std::setprecision(3) << "Overhead: "
+            << (std::max(single_ns, shared_ns / threads) * 100 / copy_ns)
+            << " % of one frame copy"
+            << std::endl
+            << "Queue samples: " << summary.count << ", p99: "
+            << summary.p99 << " ms" << std::endl;
+  return 0;
+}
@@ -0,0 +1,561 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "mynteye/types.h"
+#include "recorder.h"
+
+#define CONFIGURU_IMPLEMENTATION 1
+#include "configuru.hpp"
+
+// Rectifies the stereo frames of a native recording, computes the disparity,
+// depth and point cloud, and writes them to the output directory. Frames are
+// processed in parallel, one frame per worker thread, then the throughput is
+// reported.
+//
+// The calibration files hold the values of the get_info service keys
+// IMG_INTRINSICS (10) and IMG_EXTRINSICS_RTOL (11), as json.
+//
+// Outputs, a comma separated subset of rect,disparity,depth,points:
+//   left/, right/  rectified frames, png
+//   disparity/     sgbm disparity times 16, 16 bit png
+//   depth/         depth in 1mm, 16 bit png
+//   points/        point cloud in 1mm, binary ply
+//   frames.csv     index, frame id and hardware timestamp of each frame
+//
+// Usage: stereo_batch <recording> <intrinsics.json> <extrinsics.json>
+//            [output_dir] [threads] [outputs]
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// as the sdk disparity processor
+const int SGBM_BLOCK_SIZE = 3;
+const int SGBM_DISPARITIES = 64;
+
+// set by reprojectImageTo3D for no disparity
+const float MISSING_Z = 10000.f;
+
+// frames waiting for a worker, per worker
+const std::size_t QUEUE_FRAMES = 2;
+// frames of one side waiting for the other side
+const std::size_t PENDING_FRAMES = 8;
+
+enum Output {
+  OUTPUT_RECT = 1,
+  OUTPUT_DISPARITY = 2,
+  OUTPUT_DEPTH = 4,
+  OUTPUT_POINTS = 8,
+};
+
+struct Calibration {
+  bool fisheye = false;
+  cv::Size size;
+  cv::Mat M1, D1, M2, D2, R, T;
+};
+
+struct Rectification {
+  cv::Mat map1[2], map2[2];
+  cv::Mat Q;
+};
+
+struct Image {
+  record::RecordHeader header;
+  std::vector<std::uint8_t> data;
+};
+
+struct Job {
+  std::size_t index;
+  Image left, right;
+};
+
+struct Timing {
+  double decode = 0;
+  double rectify = 0;
+  double disparity = 0;
+  double depth = 0;
+  double write = 0;
+  std::size_t frames = 0;
+};
+
+double elapsed(const std::chrono::steady_clock::time_point &beg) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - beg).count();
+}
+
+cv::Mat to_mat(const configuru::Config &values, int rows, int cols) {
+  cv::Mat mat(rows, cols, CV_64F);
+  auto &&array = values.as_array();
+  if (array.size() != static_cast<std::size_t>(rows * cols)) {
+    throw std::runtime_error("expected " + std::to_string(rows * cols) +
+        " values, got " + std::to_string(array.size()));
+  }
+  for (int i = 0; i < rows * cols; i++) {
+    mat.at<double>(i / cols, i % cols) = array[i].as_double();
+  }
+  return mat;
+}
+
+void load_camera(const configuru::Config &camera, bool fisheye,
+    cv::Mat *M, cv::Mat *D) {
+  if (fisheye) {
+    // k2, k3, k4, k5, mu, mv, u0, v0, the opencv fisheye model
+    cv::Mat coeffs = to_mat(camera["coeffs"], 1, 8);
+    *M = (cv::Mat_<double>(3, 3) << coeffs.at<double>(4), 0,
+        coeffs.at<double>(6), 0, coeffs.at<double>(5), coeffs.at<double>(7),
+        0, 0, 1);
+    *D = coeffs.colRange(0, 4).t();
+  } else {
+    *M = (cv::Mat_<double>(3, 3) << camera["fx"].as_double(), 0,
+        camera["cx"].as_double(), 0, camera["fy"].as_double(),
+        camera["cy"].as_double(), 0, 0, 1);
+    *D = to_mat(camera["coeffs"], 1, 5);
+  }
+}
+
+bool load_calibration(const std::string &intrinsics_path,
+    const std::string &extrinsics_path, Calibration *calib) {
+  try {
+    auto intrinsics = configuru::parse_file(intrinsics_path, configuru::JSON);
+    auto extrinsics = configuru::parse_file(extrinsics_path, configuru::JSON);
+    std::string model = intrinsics["calib_model"].as_string();
+    if (model != "pinhole" && model != "kannala_brandt") {
+      std::cerr << "Unknown calib_model " << model << std::endl;
+      return false;
+    }
+    calib->fisheye = model == "kannala_brandt";
+    auto &&left = intrinsics["left"];
+    calib->size = cv::Size(left["width"].as_integer<int>(),
+        left["height"].as_integer<int>());
+    load_camera(left, calib->fisheye, &calib->M1, &calib->D1);
+    load_camera(intrinsics["right"], calib->fisheye, &calib->M2, &calib->D2);
+    calib->R = to_mat(extrinsics["rotation"], 3, 3);
+    calib->T = to_mat(extrinsics["translation"], 3, 1);
+  } catch (const std::exception &e) {
+    std::cerr << "Load calibration failed: " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// as computeRectTransforms() of the wrapper
+void compute_rectification(const Calibration &calib, Rectification *rect) {
+  cv::Mat R1, R2, P1, P2;
+  if (calib.fisheye) {
+    cv::fisheye::stereoRectify(calib.M1, calib.D1, calib.M2, calib.D2,
+        calib.size, calib.R, calib.T, R1, R2, P1, P2, rect->Q,
+        cv::CALIB_ZERO_DISPARITY, calib.size);
+    cv::fisheye::initUndistortRectifyMap(calib.M1, calib.D1, R1, P1,
+        calib.size, CV_16SC2, rect->map1[0], rect->map2[0]);
+    cv::fisheye::initUndistortRectifyMap(calib.M2, calib.D2, R2, P2,
+        calib.size, CV_16SC2, rect->map1[1], rect->map2[1]);
+  } else {
+    cv::stereoRectify(calib.M1, calib.D1, calib.M2, calib.D2, calib.size,
+        calib.R, calib.T, R1, R2, P1, P2, rect->Q, cv::CALIB_ZERO_DISPARITY,
+        0, calib.size);
+    cv::initUndistortRectifyMap(calib.M1, calib.D1, R1, P1, calib.size,
+        CV_16SC2, rect->map1[0], rect->map2[0]);
+    cv::initUndistortRectifyMap(calib.M2, calib.D2, R2, P2, calib.size,
+        CV_16SC2, rect->map1[1], rect->map2[1]);
+  }
+}
+
+// as the playback device
+bool decode(const Image &image, cv::Mat *frame) {
+  auto &&header = image.header;
+  auto data = const_cast<std::uint8_t *>(image.data.data());
+  int width = header.width, height = header.height;
+  if (header.format == 0) {
+    *frame = cv::Mat(height, width, header.cv_type, data, header.step);
+    return image.data.size() >= header.step * height;
+  }
+  auto format = static_cast<Format>(header.format);
+  if (image.data.size() < width * height * bytes_per_pixel(format))
+    return false;
+  switch (format) {
+    case Format::GREY:
+      *frame = cv::Mat(height, width, CV_8UC1, data);
+      return true;
+    case Format::YUYV:
+      cv::cvtColor(cv::Mat(height, width, CV_8UC2, data), *frame,
+          cv::COLOR_YUV2BGR_YUYV);
+      return true;
+    case Format::BGR888:
+      *frame = cv::Mat(height, width, CV_8UC3, data);
+      return true;
+    case Format::RGB888:
+      cv::cvtColor(cv::Mat(height, width, CV_8UC3, data), *frame,
+          cv::COLOR_RGB2BGR);
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::string frame_path(const std::string &dir, const std::string &kind,
+    std::size_t index, const char *ext) {
+  std::ostringstream path;
+  path << dir << "/" << kind << "/" << std::setw(6) << std::setfill('0')
+       << index << ext;
+  return path.str();
+}
+
+bool write_ply(const std::string &path, const cv::Mat &points) {
+  std::vector<cv::Vec3f> valid;
+  valid.reserve(points.total());
+  for (int y = 0; y < points.rows; y++) {
+    auto row = points.ptr<cv::Vec3f>(y);
+    for (int x = 0; x < points.cols; x++) {
+      if (row[x][2] != MISSING_Z && std::isfinite(row[x][2])) {
+        valid.push_back(row[x]);
+      }
+    }
+  }
+  std::ofstream out(path, std::ios::binary);
+  out << "ply\nformat binary_little_endian 1.0\nelement vertex "
+      << valid.size()
+      << "\nproperty float x\nproperty float y\nproperty float z\n"
+         "end_header\n";
+  out.write(reinterpret_cast<const char *>(valid.data()),
+      valid.size() * sizeof(cv::Vec3f));
+  return out.good();
+}
+
+class Worker {
+ public:
+  Worker(const Rectification &rect, const std::string &dir, int outputs)
+      : rect_(rect), dir_(dir), outputs_(outputs) {
+    sgbm_ = cv::StereoSGBM::create(0, SGBM_DISPARITIES, SGBM_BLOCK_SIZE);
+    sgbm_->setPreFilterCap(63);
+    sgbm_->setP1(8 * SGBM_BLOCK_SIZE * SGBM_BLOCK_SIZE);
+    sgbm_->setP2(32 * SGBM_BLOCK_SIZE * SGBM_BLOCK_SIZE);
+    sgbm_->setUniquenessRatio(10);
+    sgbm_->setSpeckleWindowSize(100);
+    sgbm_->setSpeckleRange(32);
+    sgbm_->setDisp12MaxDiff(1);
+  }
+
+  bool Process(const Job &job) {
+    auto time_beg = std::chrono::steady_clock::now();
+    cv::Mat frame[2];
+    if (!decode(job.left, &frame[0]) || !decode(job.right, &frame[1]))
+      return false;
+    timing_.decode += elapsed(time_beg);
+
+    time_beg = std::chrono::steady_clock::now();
+    // buffers are reused, the size does not change
+    for (int i = 0; i < 2; i++) {
+      cv::remap(frame[i], rect_frame_[i], rect_.map1[i], rect_.map2[i],
+          cv::INTER_LINEAR);
+      if (rect_frame_[i].channels() == 1) {
+        grey_[i] = rect_frame_[i];
+      } else {
+        cv::cvtColor(rect_frame_[i], grey_[i], cv::COLOR_BGR2GRAY);
+      }
+    }
+    timing_.rectify += elapsed(time_beg);
+
+    bool need_points = (outputs_ & (OUTPUT_DEPTH | OUTPUT_POINTS)) != 0;
+    if ((outputs_ & OUTPUT_DISPARITY) || need_points) {
+      time_beg = std::chrono::steady_clock::now();
+      sgbm_->compute(grey_[0], grey_[1], disparity_);
+      timing_.disparity += elapsed(time_beg);
+    }
+    if (need_points) {
+      time_beg = std::chrono::steady_clock::now();
+      disparity_.convertTo(disparity_float_, CV_32F, 1.0 / 16);
+      cv::reprojectImageTo3D(disparity_float_, points_, rect_.Q, true);
+      if (outputs_ & OUTPUT_DEPTH) {
+        cv::extractChannel(points_, depth_float_, 2);
+        cv::compare(depth_float_, MISSING_Z, missing_, cv::CMP_EQ);
+        depth_float_.setTo(0, missing_);
+        depth_float_.convertTo(depth_, CV_16U);
+      }
+      timing_.depth += elapsed(time_beg);
+    }
+
+    time_beg = std::chrono::steady_clock::now();
+    bool ok = true;
+    std::size_t i = job.index;
+    if (outputs_ & OUTPUT_RECT) {
+      ok &= cv::imwrite(frame_path(dir_, "left", i, ".png"), rect_frame_[0]);
+      ok &= cv::imwrite(frame_path(dir_, "right", i, ".png"), rect_frame_[1]);
+    }
+    if (outputs_ & OUTPUT_DISPARITY) {
+      // negative is no disparity, saturates to 0
+      disparity_.convertTo(disparity_u16_, CV_16U);
+      ok &= cv::imwrite(frame_path(dir_, "disparity", i, ".png"),
+          disparity_u16_);
+    }
+    if (outputs_ & OUTPUT_DEPTH) {
+      ok &= cv::imwrite(frame_path(dir_, "depth", i, ".png"), depth_);
+    }
+    if (outputs_ & OUTPUT_POINTS) {
+      ok &= write_ply(frame_path(dir_, "points", i, ".ply"), points_);
+    }
+    timing_.write += elapsed(time_beg);
+    ++timing_.frames;
+    return ok;
+  }
+
+  const Timing &timing() const {
+    return timing_;
+  }
+
+ private:
+  const Rectification &rect_;
+  std::string dir_;
+  int outputs_;
+  cv::Ptr<cv::StereoSGBM> sgbm_;
+
+  cv::Mat rect_frame_[2], grey_[2];
+  cv::Mat disparity_, disparity_float_, disparity_u16_;
+  cv::Mat points_, depth_float_, depth_, missing_;
+  Timing timing_;
+};
+
+class JobQueue {
+ public:
+  explicit JobQueue(std::size_t capacity)
+      : capacity_(capacity), closed_(false) {}
+
+  void Push(Job &&job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return jobs_.size() < capacity_; });
+    jobs_.push_back(std::move(job));
+    cond_.notify_all();
+  }
+
+  bool Pop(Job *job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return !jobs_.empty() || closed_; });
+    if (jobs_.empty())
+      return false;
+    *job = std::move(jobs_.front());
+    jobs_.pop_front();
+    cond_.notify_all();
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> _(mutex_);
+    closed_ = true;
+    cond_.notify_all();
+  }
+
+ private:
+  std::size_t capacity_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Job> jobs_;
+  bool closed_;
+};
+
+int parse_outputs(const std::string &value) {
+  int outputs = 0;
+  std::istringstream names(value);
+  std::string name;
+  while (std::getline(names, name, ',')) {
+    if (name == "rect") {
+      outputs |= OUTPUT_RECT;
+    } else if (name == "disparity") {
+      outputs |= OUTPUT_DISPARITY;
+    } else if (name == "depth") {
+      outputs |= OUTPUT_DEPTH;
+    } else if (name == "points") {
+      outputs |= OUTPUT_POINTS;
+    } else {
+      std::cerr << "Unknown output " << name << std::endl;
+      return -1;
+    }
+  }
+  return outputs;
+}
+
+bool make_dir(const std::string &path) {
+  return ::mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " <recording> <intrinsics.json> "
+              << "<extrinsics.json> [output_dir] [threads] [outputs]"
+              << std::endl;
+    return 1;
+  }
+  std::string recording = argv[1];
+  std::string dir = argc > 4 ? argv[4] : "stereo_batch";
+  int threads = argc > 5 ? std::atoi(argv[5]) : 0;
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  int outputs = parse_outputs(argc > 6 ? argv[6] : "rect,disparity,depth");
+  if (outputs < 0)
+    return 1;
+
+  Calibration calib;
+  if (!load_calibration(argv[2], argv[3], &calib))
+    return 1;
+  Rectification rect;
+  compute_rectification(calib, &rect);
+
+  RecordReader reader;
+  if (!reader.Open(recording))
+    return 1;
+
+  bool dirs_ok = make_dir(dir);
+  if (outputs & OUTPUT_RECT) {
+    dirs_ok &= make_dir(dir + "/left") && make_dir(dir + "/right");
+  }
+  if (outputs & OUTPUT_DISPARITY) dirs_ok &= make_dir(dir + "/disparity");
+  if (outputs & OUTPUT_DEPTH) dirs_ok &= make_dir(dir + "/depth");
+  if (outputs & OUTPUT_POINTS) dirs_ok &= make_dir(dir + "/points");
+  if (!dirs_ok) {
+    std::cerr << "Create " << dir << " failed: " << strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  std::ofstream frames_csv(dir + "/frames.csv");
+  frames_csv << "index,frame_id,timestamp" << std::endl;
+
+  // frames are the unit of parallelism, not opencv functions
+  cv::setNumThreads(0);
+
+  JobQueue queue(threads * QUEUE_FRAMES);
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> worker_threads;
+  std::atomic<std::size_t> failed(0);
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back(new Worker(rect, dir, outputs));
+    Worker *worker = workers.back().get();
+    worker_threads.emplace_back([&queue, &failed, worker]() {
+      Job job;
+      while (queue.Pop(&job)) {
+        if (!worker->Process(job)) {
+          ++failed;
+        }
+      }
+    });
+  }
+
+  auto time_beg = std::chrono::steady_clock::now();
+  double read_time = 0;
+  std::size_t index = 0, unpaired = 0;
+  std::deque<Image> pending[2];
+  RecordReader::Record record;
+  while (true) {
+    auto read_beg = std::chrono::steady_clock::now();
+    if (!reader.Next(&record))
+      break;
+    auto &&header = *record.header;
+    Stream stream = static_cast<Stream>(header.stream);
+    if (header.type != record::RECORD_IMAGE ||
+        (stream != Stream::LEFT && stream != Stream::RIGHT)) {
+      continue;
+    }
+    if (header.width != calib.size.width ||
+        header.height != calib.size.height) {
+      ++unpaired;
+      continue;
+    }
+    // pair with the other side of the same frame id
+    int side = stream == Stream::LEFT ? 0 : 1;
+    auto &&others = pending[1 - side];
+    auto &&it = std::find_if(others.begin(), others.end(),
+        [&header](const Image &image) {
+          return image.header.frame_id == header.frame_id;
+        });
+    Image image;
+    image.header = header;
+    image.data.assign(record.data, record.data + header.size);
+    if (it == others.end()) {
+      pending[side].push_back(std::move(image));
+      if (pending[side].size() > PENDING_FRAMES) {
+        pending[side].pop_front();
+        ++unpaired;
+      }
+      read_time += elapsed(read_beg);
+      continue;
+    }
+    Job job;
+    job.index = index++;
+    job.left = side == 0 ? std::move(image) : std::move(*it);
+    job.right = side == 1 ? std::move(image) : std::move(*it);
+    others.erase(it);
+    frames_csv << job.index << "," << job.left.header.frame_id << ","
+               << job.left.header.timestamp << "\n";
+    read_time += elapsed(read_beg);
+    queue.Push(std::move(job));
+  }
+  queue.Close();
+  for (auto &&thread : worker_threads) {
+    thread.join();
+  }
+  double time = elapsed(time_beg);
+  unpaired += pending[0].size() + pending[1].size();
+
+  Timing total;
+  for (auto &&worker : workers) {
+    auto &&timing = worker->timing();
+    total.decode += timing.decode;
+    total.rectify += timing.rectify;
+    total.disparity += timing.disparity;
+    total.depth += timing.depth;
+    total.write += timing.write;
+    total.frames += timing.frames;
+  }
+  double fps = total.frames / time;
+  std::size_t frames = std::max<std::size_t>(total.frames, 1);
+  std::cout << std::fixed << std::setprecision(2)
+            << "Frames: " << total.frames << ", failed: " << failed
+            << ", unpaired: " << unpaired << ", threads: " << threads
+            << std::endl
+            << "Time: " << time << " s, fps: " << fps
+            << ", fps per core: " << (fps / threads) << std::endl
+            << "Ms per frame, read: " << (read_time * 1000 / frames)
+            << ", decode: " << (total.decode * 1000 / frames)
+            << ", rectify: " << (total.rectify * 1000 / frames)
+            << ", disparity: " << (total.disparity * 1000 / frames)
+            << ", depth: " << (total.depth * 1000 / frames)
+            << ", write: " << (total.write * 1000 / frames) << std::endl;
+  return failed > 0 ? 2 : 0;
+}
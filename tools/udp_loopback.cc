@@ -0,0 +1,128 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "udp_receiver.h"
+#include "udp_sink.h"
+
+// Sends images and imu samples from UdpSink to UdpReceiver on this host,
+// then checks each message arrives whole. The images span many fragments
+// and have padded rows, so the packing and the reassembly are both covered.
+// Exits with 1 on the first message lost or different.
+//
+// Usage: udp_loopback [group] [port] [frames]
+
+namespace {
+
+const int WIDTH = 752;
+const int HEIGHT = 480;
+const int PADDING = 16;
+
+std::uint8_t pixel(int frame, int x, int y) {
+  return static_cast<std::uint8_t>(frame * 7 + x * 3 + y);
+}
+
+bool check_image(const mynteye::UdpReceiver::Message &msg, int frame) {
+  const mynteye::udp::ImageHeader *header = msg.image();
+  if (header == nullptr) {
+    std::cerr << "Frame " << frame << " is not an image" << std::endl;
+    return false;
+  }
+  if (header->frame_id != frame || header->width != WIDTH ||
+      header->height != HEIGHT || header->step != WIDTH ||
+      header->timestamp != static_cast<std::uint64_t>(frame) * 16666) {
+    std::cerr << "Frame " << frame << " header differs" << std::endl;
+    return false;
+  }
+  const std::uint8_t *data = msg.image_data();
+  for (int y = 0; y < HEIGHT; y++) {
+    for (int x = 0; x < WIDTH; x++) {
+      if (data[y * WIDTH + x] != pixel(frame, x, y)) {
+        std::cerr << "Frame " << frame << " differs at " << x << "," << y
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool check_imu(const mynteye::UdpReceiver::Message &msg, int frame) {
+  const mynteye::udp::ImuPacket *imu = msg.imu();
+  if (imu == nullptr || imu->frame_id != static_cast<std::uint32_t>(frame) ||
+      imu->accel[0] != frame * 0.5 || imu->gyro[2] != -frame * 0.25) {
+    std::cerr << "Imu " << frame << " differs" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::string group = argc > 1 ? argv[1] : "239.255.0.7";
+  std::uint16_t port =
+      static_cast<std::uint16_t>(argc > 2 ? std::atoi(argv[2]) : 19007);
+  int frames = argc > 3 ? std::atoi(argv[3]) : 100;
+
+  mynteye::UdpReceiver receiver;
+  if (!receiver.Open(group, port)) {
+    std::cerr << "Open receiver failed, " << receiver.error() << std::endl;
+    return 1;
+  }
+  mynteye::UdpSink sink;
+  if (!sink.Open(group, port, "", 0)) {
+    std::cerr << "Open sink failed" << std::endl;
+    return 1;
+  }
+
+  std::size_t step = WIDTH + PADDING;
+  std::vector<std::uint8_t> image(step * HEIGHT);
+  mynteye::UdpReceiver::Message msg;
+  for (int i = 0; i < frames; i++) {
+    for (int y = 0; y < HEIGHT; y++) {
+      for (int x = 0; x < WIDTH; x++) {
+        image[y * step + x] = pixel(i, x, y);
+      }
+    }
+    sink.SendImage(
+        0, static_cast<std::uint64_t>(i) * 16666, static_cast<std::uint16_t>(i),
+        WIDTH, HEIGHT, 0 /* CV_8UC1 */, WIDTH, image.data(), step);
+    mynteye::udp::ImuPacket imu;
+    std::memset(&imu, 0, sizeof(imu));
+    imu.timestamp = static_cast<std::uint64_t>(i) * 16666;
+    imu.frame_id = i;
+    imu.accel[0] = i * 0.5;
+    imu.gyro[2] = -i * 0.25;
+    sink.SendImu(imu);
+
+    // the receive buffer holds both, so they are read after the sends
+    if (!receiver.Receive(&msg, 1000) || !check_image(msg, i) ||
+        !receiver.Receive(&msg, 1000) || !check_imu(msg, i)) {
+      std::cerr << "Message " << i << " lost or different"
+                << (receiver.error().empty() ? "" : ", ")
+                << receiver.error() << std::endl;
+      return 1;
+    }
+  }
+  std::cout << "messages: " << receiver.received()
+            << ", dropped: " << receiver.dropped()
+            << ", sent bytes: " << sink.sent_bytes()
+            << ", send drops: " << sink.send_drops() << std::endl;
+  return receiver.dropped() == 0 && sink.send_errors() == 0 &&
+      sink.send_drops() == 0 ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <benchmark/benchmark.h>
+
+#include <ros/time.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <opencv2/core/core.hpp>
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "acquisition.h"
+#include "conversions.h"
+#include "info_json.h"
+#include "time_sync.h"
+
+// Microbenchmarks of the per frame and per sample functions of the wrapper,
+// fed by synthetic data, without ROS master or device. The image ones run at
+// each supported resolution of one eye: 752x480 and 376x240 of S1030,
+// 640x400 and 1280x800 of S2.
+//
+// Usage: wrapper_bench [--benchmark_filter=<regex>] ...
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// wraps of the device counter, as unit_hard_time of the nodelet
+const std::uint64_t HARD_TIME_PERIOD =
+    static_cast<std::uint64_t>(std::numeric_limits<std::uint32_t>::max()) * 10;
+// frame and imu intervals in 1us
+const std::uint64_t FRAME_INTERVAL = 33333;
+const std::uint64_t IMU_INTERVAL = 5000;
+
+void Resolutions(benchmark::internal::Benchmark *b) {
+  b->Args({752, 480})->Args({376, 240})->Args({640, 400})->Args({1280, 800});
+}
+
+cv::Mat RandomFrame(const benchmark::State &state, int type, double low,
+    double high) {
+  cv::Mat frame(state.range(1), state.range(0), type);
+  cv::randu(frame, cv::Scalar::all(low), cv::Scalar::all(high));
+  return frame;
+}
+
+void SetFrames(benchmark::State &state, std::size_t bytes) {  // NOLINT
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+// publishMono()
+void BM_FillMono(benchmark::State &state) {  // NOLINT
+  cv::Mat frame = RandomFrame(state, CV_8UC3, 0, 256);
+  sensor_msgs::Image msg;
+  for (auto _ : state) {
+    FillMonoMsg(frame, &msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+  SetFrames(state, frame.total() * frame.elemSize());
+}
+BENCHMARK(BM_FillMono)->Apply(Resolutions);
+
+// publishCamera() of the disparity
+void BM_FillDisparity(benchmark::State &state) {  // NOLINT
+  cv::Mat frame = RandomFrame(state, CV_32FC1, 0, 64);
+  sensor_msgs::Image msg;
+  for (auto _ : state) {
+    FillDisparityMsg(frame, sensor_msgs::image_encodings::MONO8, &msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+  SetFrames(state, frame.total() * frame.elemSize());
+}
+BENCHMARK(BM_FillDisparity)->Apply(Resolutions);
+
+// publishPoints()
+void BM_FillPointCloud(benchmark::State &state) {  // NOLINT
+  cv::Mat frame = RandomFrame(state, CV_32FC3, -5000, 5000);
+  sensor_msgs::PointCloud2 msg;
+  for (auto _ : state) {
+    FillPointCloudMsg(frame, &msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+  SetFrames(state, frame.total() * frame.elemSize());
+}
+BENCHMARK(BM_FillPointCloud)->Apply(Resolutions);
+
+// checkUpTimeStamp(), a wrap every 2^16 frames
+void BM_CheckUpTimeStamp(benchmark::State &state) {  // NOLINT
+  TimestampUnwrapper unwrapper(HARD_TIME_PERIOD);
+  SoftTimeMapper mapper;
+  std::uint64_t hard_time = 0;
+  for (auto _ : state) {
+    hard_time = (hard_time + HARD_TIME_PERIOD / 65536) % HARD_TIME_PERIOD;
+    benchmark::DoNotOptimize(mapper.Map(unwrapper.Unwrap(hard_time)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CheckUpTimeStamp);
+
+// timestampAlign(), an accel and a gyro sample per call as the device sends
+void BM_TimestampAlign(benchmark::State &state) {  // NOLINT
+  ImuAligner aligner;
+  std::vector<ImuData> aligned;
+  ImuData accel, gyro;
+  accel.flag = 1;
+  gyro.flag = 2;
+  for (int i = 0; i < 3; i++) {
+    accel.accel[i] = 0.1 * (i + 1);
+    gyro.gyro[i] = 0.2 * (i + 1);
+  }
+  std::uint64_t timestamp = 0;
+  for (auto _ : state) {
+    timestamp += IMU_INTERVAL;
+    accel.timestamp = timestamp;
+    gyro.timestamp = timestamp + IMU_INTERVAL / 2;
+    aligner.PushAccel(accel);
+    aligner.Align(&aligned);
+    aligner.PushGyro(gyro);
+    aligner.Align(&aligned);
+    benchmark::DoNotOptimize(aligned.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimestampAlign);
+
+// imu samples of one pull, accel and gyro alternate as the device sends
+std::vector<api::MotionData> MotionDatas(std::size_t count) {
+  std::vector<api::MotionData> datas(count);
+  for (std::size_t i = 0; i < count; i++) {
+    auto imu = std::make_shared<ImuData>();
+    imu->flag = i % 2 ? 2 : 1;
+    imu->timestamp = i * IMU_INTERVAL / 2;
+    for (int j = 0; j < 3; j++) {
+      imu->accel[j] = 0.1 * (j + 1);
+      imu->gyro[j] = 0.2 * (j + 1);
+    }
+    datas[i].imu = imu;
+  }
+  return datas;
+}
+
+void PullSizes(benchmark::internal::Benchmark *b) {
+  b->Arg(1)->Arg(8)->Arg(64);
+}
+
+// motion callback of acquisition/mode callback, each sample on its own
+void BM_ImuPerSample(benchmark::State &state) {  // NOLINT
+  auto &&datas = MotionDatas(state.range(0));
+  TimestampUnwrapper unwrapper(HARD_TIME_PERIOD);
+  SoftTimeMapper mapper;
+  double accel[3], gyro[3];
+  for (auto _ : state) {
+    for (auto &&data : datas) {
+      benchmark::DoNotOptimize(
+          mapper.Map(unwrapper.Unwrap(data.imu->timestamp)));
+      for (int i = 0; i < 3; i++) {
+        accel[i] = data.imu->accel[i] * 9.8;
+        gyro[i] = data.imu->gyro[i] * M_PI / 180;
+      }
+      benchmark::DoNotOptimize(accel);
+      benchmark::DoNotOptimize(gyro);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * datas.size());
+}
+BENCHMARK(BM_ImuPerSample)->Apply(PullSizes);
+
+// publishMotionBatch() of acquisition/mode pull, the samples of one tick
+void BM_ImuBatch(benchmark::State &state) {  // NOLINT
+  auto &&datas = MotionDatas(state.range(0));
+  TimestampUnwrapper unwrapper(HARD_TIME_PERIOD);
+  SoftTimeMapper mapper;
+  MotionBatch batch;
+  for (auto _ : state) {
+    batch.Assign(datas);
+    batch.Unwrap(&unwrapper);
+    batch.Convert(9.8);
+    for (std::size_t i = 0; i < batch.size(); i++) {
+      benchmark::DoNotOptimize(mapper.Map(batch.time(i)));
+    }
+    benchmark::DoNotOptimize(batch.accel(0));
+  }
+  state.SetItemsProcessed(state.iterations() * datas.size());
+}
+BENCHMARK(BM_ImuBatch)->Apply(PullSizes);
+
+// stereo pair matching of the right callback, with one pair out of sync
+void BM_StereoMatch(benchmark::State &state) {  // NOLINT
+  const std::size_t count = 3;  // MATCH_CHECK_THRESHOLD
+  std::vector<std::int64_t> left, right;
+  std::int64_t timestamp = 0;
+  std::size_t matches = 0;
+  for (auto _ : state) {
+    timestamp += FRAME_INTERVAL;
+    PushRecentStamp(&left, timestamp, count);
+    PushRecentStamp(&right, timestamp + (timestamp % 7 == 0), count);
+    matches += HasCommonStamp(left, right);
+  }
+  benchmark::DoNotOptimize(matches);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StereoMatch);
+
+// getInfo() of the calibration keys, values as of a S2 device
+
+IntrinsicsPinhole PinholeIntrinsics() {
+  IntrinsicsPinhole intri;
+  intri.width = 640;
+  intri.height = 400;
+  intri.fx = 358.34;
+  intri.fy = 358.75;
+  intri.cx = 318.92;
+  intri.cy = 200.63;
+  intri.model = 0;
+  const double coeffs[5] = {-0.2859, 0.0756, 0.0002, -0.0001, 0};
+  for (int i = 0; i < 5; i++) {
+    intri.coeffs[i] = coeffs[i];
+  }
+  return intri;
+}
+
+IntrinsicsEquidistant EquidistantIntrinsics() {
+  IntrinsicsEquidistant intri;
+  intri.width = 640;
+  intri.height = 400;
+  const double coeffs[8] = {
+      0.0183, -0.0021, 0.0007, -0.0002, 358.34, 358.75, 318.92, 200.63};
+  for (int i = 0; i < 8; i++) {
+    intri.coeffs[i] = coeffs[i];
+  }
+  return intri;
+}
+
+Extrinsics RightToLeftExtrinsics() {
+  Extrinsics extri;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      extri.rotation[i][j] = i == j ? 0.9999 : 0.0012 * (i - j);
+    }
+    extri.translation[i] = i == 0 ? -120.03 : 0.21 * i;
+  }
+  return extri;
+}
+
+MotionIntrinsics ImuCalibration() {
+  MotionIntrinsics intri;
+  for (auto &&imu : {&intri.accel, &intri.gyro}) {
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        imu->scale[i][j] = i == j ? 1.0012 : 0.0003;
+      }
+      imu->drift[i] = 0.0001 * i;
+      imu->noise[i] = 0.016;
+      imu->bias[i] = 0.0002;
+    }
+  }
+  return intri;
+}
+
+void BM_InfoJsonPinhole(benchmark::State &state) {  // NOLINT
+  auto &&intri = PinholeIntrinsics();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ToJson(intri, intri));
+  }
+}
+BENCHMARK(BM_InfoJsonPinhole);
+
+void BM_InfoJsonEquidistant(benchmark::State &state) {  // NOLINT
+  auto &&intri = EquidistantIntrinsics();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ToJson(intri, intri));
+  }
+}
+BENCHMARK(BM_InfoJsonEquidistant);
+
+void BM_InfoJsonExtrinsics(benchmark::State &state) {  // NOLINT
+  auto &&extri = RightToLeftExtrinsics();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ToJson(extri));
+  }
+}
+BENCHMARK(BM_InfoJsonExtrinsics);
+
+void BM_InfoJsonImuIntrinsics(benchmark::State &state) {  // NOLINT
+  auto &&intri = ImuCalibration();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ToJson(intri));
+  }
+}
+BENCHMARK(BM_InfoJsonImuIntrinsics);
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  // wall time without master, for SoftTimeMapper
+  ros::Time::init();
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}